@@ -6,11 +6,51 @@
 #include <assimp/postprocess.h>
 #include <glm/glm.hpp>
 #include <stdexcept>
+#include <algorithm>
 #include "Renderer.h"
+#include "MeshCache.h"
+#include "TextureRegistry.h"
+#include "MeshOptimizer.h"
+#include "JobSystem.h"
 
-static std::string directory;
-static std::vector<Mesh> models;
-static std::vector<Texture> textures_loaded;
+//post processing baked into the mesh cache, changing it invalidates existing caches
+static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+//cpu side result of converting one aiMesh, filled by the workers
+//one drawable piece of an imported mesh
+struct ImportedPart {
+	std::vector<vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshLod> lods;
+};
+
+struct ImportedMesh {
+	//a single part unless the mesh was split to keep 16 bit indices
+	std::vector<ImportedPart> parts;
+	//relative to the model directory, empty if the material has no diffuse map
+	std::string diffusePath;
+	MeshOptimizationStats optimization;
+	size_t triangleCount = 0;
+	//workers only record these, the importing thread reports them once
+	bool hasUVs = true;
+	bool hasTangents = true;
+};
+
+//per import state, keeps loadOBJ reentrant
+struct ImportContext {
+	std::string directory;
+	//gpu vertex layout, decides whether splitting beats 32 bit indices
+	VertexFormat vertexFormat = VertexFormat::Full;
+	const aiScene* scene = nullptr;
+	//scene mesh index per output slot, in depth first node order. the slot is the stable mesh id
+	std::vector<unsigned int> meshOrder;
+	//scene node per output slot, indexes nodes
+	std::vector<uint32_t> meshNodes;
+	//flattened node hierarchy, parents before children
+	std::vector<SceneNode> nodes;
+	std::vector<ImportedMesh> meshes;
+};
 
 void VK_CHECK_RESULT(VkResult ret, std::string msg)
 {
@@ -20,147 +60,258 @@ void VK_CHECK_RESULT(VkResult ret, std::string msg)
 	}
 }
 
-std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName, Vulkan_Backend& in_backend)
+static Material resolveMaterial(const std::string& directory, const std::string& diffusePath, Vulkan_Backend& in_backend)
 {
-	std::vector<Texture> textures;
-	for (int i = 0; i < mat->GetTextureCount(type); i++)
+	Material mat;
+	if (!diffusePath.empty())
 	{
-		aiString str;
-		mat->GetTexture(type, i, &str);
-		bool skip = false;
-		for (int j = 0; j < textures_loaded.size(); j++)
-		{
-			if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-			{
-				textures.push_back(textures_loaded[j]);
-				skip = true; break;
-			}
-		}
-		if (!skip)
-		{
-			Texture texture;
-			texture.type = typeName;
-			texture.path = directory + "/" + std::string(str.C_Str());//str.C_Str();
-			texture.setupTexture((in_backend));
-			textures.push_back(texture);
-			textures_loaded.push_back(texture);
-		}
+		mat.diffuse = in_backend.m_textureRegistry->acquire(directory + "/" + diffusePath, "texture_diffuse");
 	}
+	return mat;
+}
 
-	return textures;
+static std::string firstTexturePath(const aiMaterial* mat, aiTextureType type)
+{
+	if (mat->GetTextureCount(type) == 0)
+		return std::string();
+
+	aiString str;
+	mat->GetTexture(type, 0, &str);
+	return str.C_Str();
 }
 
-static Mesh processModel(aiMesh* mesh, const aiScene* scene, Vulkan_Backend& in_backend)
+//cpu only, only reads the scene so it is safe to run for different meshes in parallel
+//meshes over the 16 bit range either keep one 32 bit index buffer or get cut into parts that stay 16 bit
+//whichever needs fewer gpu bytes, splitting pays for the vertices duplicated along the cuts
+static void chooseIndexLayout(ImportedMesh& out, uint32_t gpuVertexSize)
 {
-	std::vector<vertex> vertices;
-	std::vector<uint16_t> indices;
-	std::vector<Texture> textures;
+	ImportedPart& whole = out.parts[0];
+	if (whole.vertices.size() <= MAX_UINT16_INDEXED_VERTICES)
+		return;
+
+	std::vector<MeshSplit> splits;
+	size_t splitVertices = utils::splitMesh(whole.indices.data(), whole.indices.size(), whole.vertices.size(), MAX_UINT16_INDEXED_VERTICES, splits);
 
-	for (int i = 0; i < mesh->mNumVertices; i++)
+	uint64_t wideBytes = whole.indices.size() * sizeof(uint32_t) + uint64_t(whole.vertices.size()) * gpuVertexSize;
+	uint64_t splitBytes = whole.indices.size() * sizeof(uint16_t) + uint64_t(splitVertices) * gpuVertexSize;
+	if (splitBytes >= wideBytes)
+		return;
+
+	std::vector<ImportedPart> parts(splits.size());
+	for (size_t p = 0; p < splits.size(); ++p)
 	{
-		vertex vert;
-		glm::vec3 vec;
-		vec.x = mesh->mVertices[i].x;
-		vec.y = mesh->mVertices[i].y;
-		vec.z = mesh->mVertices[i].z;
-		vert.pos = vec;
-
-		vec.x = mesh->mNormals[i].x;
-		vec.y = mesh->mNormals[i].y;
-		vec.z = mesh->mNormals[i].z;
-		vert.normal = vec;
-
-		if (mesh->mTextureCoords[0])
-		{
-			glm::vec2 vec;
-			vec.x = mesh->mTextureCoords[0][i].x;
-			vec.y = mesh->mTextureCoords[0][i].y;
-			vert.uv = vec;
-		}
-		else {
-			vert.uv = glm::vec2(0.0f, 0.0f);
-			std::cout << "no uvs detected" << std::endl;
-		}
+		parts[p].vertices.resize(splits[p].vertexRemap.size());
+		for (size_t v = 0; v < splits[p].vertexRemap.size(); ++v)
+			parts[p].vertices[v] = whole.vertices[splits[p].vertexRemap[v]];
+		parts[p].indices.assign(splits[p].indices.begin(), splits[p].indices.end());
+	}
+	out.parts = std::move(parts);
+}
+
+static void processModel(const aiMesh* mesh, const aiScene* scene, uint32_t gpuVertexSize, ImportedMesh& out)
+{
+	out.parts.resize(1);
+	ImportedPart& part = out.parts[0];
 
-		if (mesh->HasTangentsAndBitangents())
+	const bool hasUVs = mesh->mTextureCoords[0] != nullptr;
+	const bool hasTangents = mesh->HasTangentsAndBitangents();
+	out.hasUVs = hasUVs;
+	out.hasTangents = hasTangents;
+
+	part.vertices.resize(mesh->mNumVertices);
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		vertex& vert = part.vertices[i];
+		vert.pos = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		vert.normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+		vert.uv = hasUVs ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f, 0.0f);
+
+		if (hasTangents)
 		{
-			/*tangents and bitangents*/
-			glm::vec3 t;
-			t.x = mesh->mTangents[i].x;
-			t.y = mesh->mTangents[i].y;
-			t.z = mesh->mTangents[i].z;
-			vert.tangent = t;
-			glm::vec3 bt;
-			bt.x = mesh->mBitangents[i].x;
-			bt.y = mesh->mBitangents[i].y;
-			bt.z = mesh->mBitangents[i].z;
-			vert.bitangent = bt;
-			vertices.push_back(vert);
+			vert.tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+			vert.bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
 		}
 		else
 		{
-			std::cout << "Model doesnt have tangents" << std::endl;
+			vert.tangent = glm::vec3(0.0f);
+			vert.bitangent = glm::vec3(0.0f);
 		}
 	}
 
-	for (int i = 0; i < mesh->mNumFaces; i++)
+	size_t indexCount = 0;
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+		indexCount += mesh->mFaces[i].mNumIndices;
+
+	part.indices.resize(indexCount);
+	uint32_t* dst = part.indices.data();
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+			*dst++ = face.mIndices[j];
+	}
+
+	//vertex cache, overdraw and fetch order, baked into the mesh cache so it only runs on import
+	size_t vertexCount = part.vertices.size();
+	out.optimization = utils::optimizeMesh(part.vertices.data(), vertexCount, sizeof(vertex), part.indices.data(), part.indices.size());
+	part.vertices.resize(vertexCount);
+	out.triangleCount = part.indices.size() / 3;
+
+	chooseIndexLayout(out, gpuVertexSize);
+
+	//clusters follow the final triangle order of each part, the lod chain is appended behind lod 0 afterwards
+	for (auto& p : out.parts)
 	{
-		aiFace face = mesh->mFaces[i];
-		for (int j = 0; j < face.mNumIndices; j++)
-			indices.push_back(face.mIndices[j]);
+		const float* positions = reinterpret_cast<const float*>(p.vertices.data());
+		utils::buildMeshlets(positions, p.vertices.size(), sizeof(vertex), p.indices.data(), p.indices.size(), p.meshlets);
+		utils::generateLods(positions, p.vertices.size(), sizeof(vertex), p.indices, LOD_MAX_ERROR, p.lods);
 	}
 
-	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-	std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", in_backend);
-	//textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-	//std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-	//textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-	//
-	//std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-	//textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-	//
-	//std::vector<Texture> transparencyMaps = loadMaterialTextures(material, aiTextureType_OPACITY, "texture_alphamask");
-	//textures.insert(textures.end(), transparencyMaps.begin(), transparencyMaps.end());
-	//
-	//std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-	//textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-		
-	Material diffMat;
-	diffMat.diffuse = &diffuseMaps.front();	
-	return Mesh(vertices, indices, diffMat);
+	const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+	out.diffusePath = firstTexturePath(material, aiTextureType_DIFFUSE);
 }
 
-static void processNode(aiNode* node, const aiScene* scene, Vulkan_Backend& in_backend)
+//depth first, meshes of a node before its children, same order the old recursive walk produced
+//every node is appended before its children, so the parent index is always smaller than the node's own
+static void flattenNodes(ImportContext& ctx)
 {
-	for (int i = 0; i < node->mNumMeshes; i++)
+	std::vector<std::pair<const aiNode*, int32_t>> stack{ { ctx.scene->mRootNode, TransformHierarchy::NO_PARENT } };
+	while (!stack.empty())
 	{
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		models.push_back(processModel(mesh, scene, in_backend));
-	}
+		const aiNode* node = stack.back().first;
+		int32_t parent = stack.back().second;
+		stack.pop_back();
 
-	for (int i = 0; i < node->mNumChildren; i++)
-	{
-		processNode(node->mChildren[i], scene, in_backend);
+		//assimp matrices are row major, glm is column major
+		SceneNode sceneNode;
+		sceneNode.parent = parent;
+		const float* rows = &node->mTransformation.a1;
+		for (int c = 0; c < 4; ++c)
+		{
+			for (int r = 0; r < 4; ++r)
+				sceneNode.local[c][r] = rows[r * 4 + c];
+		}
+		uint32_t nodeIndex = static_cast<uint32_t>(ctx.nodes.size());
+		ctx.nodes.push_back(sceneNode);
+
+		for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		{
+			ctx.meshOrder.push_back(node->mMeshes[i]);
+			ctx.meshNodes.push_back(nodeIndex);
+		}
+
+		for (unsigned int i = node->mNumChildren; i > 0; i--)
+			stack.push_back({ node->mChildren[i - 1], static_cast<int32_t>(nodeIndex) });
 	}
 }
 
-std::vector<Mesh> utils::loadOBJ(std::string path, Vulkan_Backend& in_backend)
+std::vector<Mesh> utils::loadOBJ(std::string path, Vulkan_Backend& in_backend, TransformHierarchy& transforms, VertexFormat vertexFormat)
 {
-	
+	ImportContext ctx;
+	ctx.directory = path.substr(0, path.find_last_of('/'));
+	ctx.vertexFormat = vertexFormat;
+
+	std::string cachePath = path + ".meshcache";
+	uint64_t sourceHash = hashMeshSource(path);
+
+	std::vector<Mesh> models;
+
+	//warm path, vertex and index data is stored in the gpu layout and goes from the mapping straight into the staging ring
+	MappedFile cacheFile;
+	std::vector<CachedMesh> cachedMeshes;
+	std::vector<SceneNode> cachedNodes;
+	if (sourceHash != 0 && cacheFile.open(cachePath) && readMeshCache(cacheFile, sourceHash, importFlags, vertexFormat, cachedMeshes, cachedNodes))
+	{
+		uint32_t nodeBase = transforms.addNodes(cachedNodes.data(), cachedNodes.size());
+		models.reserve(cachedMeshes.size());
+		for (auto& cached : cachedMeshes)
+		{
+			models.emplace_back(std::vector<vertex>(), std::vector<uint32_t>(), resolveMaterial(ctx.directory, cached.diffusePath, in_backend));
+			models.back().vertexFormat = vertexFormat;
+			models.back().SetupMesh(in_backend, cached.vertices, cached.vertexCount, cached.boundsMin, cached.boundsExtent,
+				cached.indices, cached.indexCount, cached.indexType);
+			models.back().meshlets.assign(cached.meshlets, cached.meshlets + cached.meshletCount);
+			models.back().lods.assign(cached.lods, cached.lods + cached.lodCount);
+			models.back().transformNode = nodeBase + cached.transformNode;
+		}
+		return models;
+	}
+	cacheFile.close();
+
 	Assimp::Importer importer;
 
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-	scene = importer.ApplyPostProcessing(aiProcess_CalcTangentSpace);
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	//CalcTangentSpace is part of the import flags, running it again as a separate pass only cost time
+	ctx.scene = importer.ReadFile(path, importFlags);
+	if (!ctx.scene || ctx.scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !ctx.scene->mRootNode)
 	{
 		std::cout << "[ERROR:ASSIMP]: " << importer.GetErrorString() << std::endl;
 		throw std::runtime_error("Assimp failed to load scene OBJ");
 	}
 
-	directory = path.substr(0, path.find_last_of('/'));
-	processNode(scene->mRootNode, scene, in_backend);
+	flattenNodes(ctx);
+
+	//every worker writes only its own preallocated slot, so no locking is needed
+	ctx.meshes.resize(ctx.meshOrder.size());
+	const uint32_t gpuVertexSize = vertexSizeOf(vertexFormat);
+	in_backend.m_jobs->parallelFor(ctx.meshOrder.size(), [&ctx, gpuVertexSize](size_t slot) {
+		processModel(ctx.scene->mMeshes[ctx.meshOrder[slot]], ctx.scene, gpuVertexSize, ctx.meshes[slot]);
+	});
+
+	size_t missingUVs = 0, missingTangents = 0;
+	for (auto& imported : ctx.meshes)
+	{
+		missingUVs += !imported.hasUVs;
+		missingTangents += !imported.hasTangents;
+	}
+	if (missingUVs > 0)
+		std::cout << "[ASSIMP]: " << path << ", no uvs detected in " << missingUVs << " of " << ctx.meshes.size() << " meshes" << std::endl;
+	if (missingTangents > 0)
+		std::cout << "[ASSIMP]: " << path << ", no tangents in " << missingTangents << " of " << ctx.meshes.size() << " meshes" << std::endl;
+
+	uint32_t nodeBase = transforms.addNodes(ctx.nodes.data(), ctx.nodes.size());
+
+	//uploads are recorded in mesh order, textures only get queued for decode here
+	std::vector<std::string> diffusePaths;
+	std::vector<uint32_t> meshNodes;
+	diffusePaths.reserve(ctx.meshes.size());
+	meshNodes.reserve(ctx.meshes.size());
+	models.reserve(ctx.meshes.size());
+	for (size_t slot = 0; slot < ctx.meshes.size(); ++slot)
+	{
+		ImportedMesh& imported = ctx.meshes[slot];
+		const MeshOptimizationStats& opt = imported.optimization;
+		std::cout << "[MESHOPT]: mesh " << slot << ", " << imported.triangleCount << " triangles, "
+			<< opt.clusterCount << " clusters, ACMR " << opt.before.acmr << " -> " << opt.after.acmr
+			<< ", ATVR " << opt.before.atvr << " -> " << opt.after.atvr << std::endl;
+
+		Material mat = resolveMaterial(ctx.directory, imported.diffusePath, in_backend);
+		for (auto& part : imported.parts)
+		{
+			models.emplace_back(std::move(part.vertices), std::move(part.indices), mat);
+			models.back().meshlets = std::move(part.meshlets);
+			models.back().lods = std::move(part.lods);
+			models.back().transformNode = nodeBase + ctx.meshNodes[slot];
+			models.back().vertexFormat = vertexFormat;
+			models.back().SetupMesh(in_backend);
+			diffusePaths.push_back(imported.diffusePath);
+			meshNodes.push_back(ctx.meshNodes[slot]);
+		}
+
+		if (imported.parts.size() > 1)
+		{
+			std::cout << "[MESHOPT]: mesh " << slot << " split into " << imported.parts.size() << " parts with 16 bit indices" << std::endl;
+		}
+		else if (models.back().indexType == VK_INDEX_TYPE_UINT32)
+		{
+			std::cout << "[MESHOPT]: mesh " << slot << " uses 32 bit indices" << std::endl;
+		}
+	}
+
+
+	if (sourceHash != 0 && !writeMeshCache(cachePath, sourceHash, importFlags, vertexFormat, models, diffusePaths, ctx.nodes, meshNodes))
+	{
+		std::cout << "[MESHCACHE]: failed to write " << cachePath << std::endl;
+	}
 
 	return models;
 }
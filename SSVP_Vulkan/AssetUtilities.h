@@ -5,15 +5,17 @@
 #include <string>
 #include <vector>
 #include "Primitives.h"
+#include "TransformHierarchy.h"
 
 
 void VK_CHECK_RESULT(VkResult ret, std::string msg);
-extern std::vector<Texture> textures_loaded;
 
 
 namespace utils {	
 
-	std::vector<Mesh> loadOBJ(std::string path, Vulkan_Backend& in_backend);
+	//vertexFormat picks the gpu vertex layout, cpu side vertices stay in the full layout
+	//the node hierarchy is appended to transforms, every mesh's transformNode points into it
+	std::vector<Mesh> loadOBJ(std::string path, Vulkan_Backend& in_backend, TransformHierarchy& transforms, VertexFormat vertexFormat = VertexFormat::Full);
 
 	std::vector<char> readFile(const std::string& filename);
 
@@ -15,63 +15,19 @@ ClearScreenPass::ClearScreenPass(Vulkan_Renderer& renderer) :
 {
 	m_clearValue.color = m_clearColor;
 
-	VkSemaphoreCreateInfo semaphoreInfo{};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	VkResult res1 = vkCreateSemaphore(m_renderer.m_backend.m_device, &semaphoreInfo, nullptr, &m_renderWaitSemaphore);
-	VkResult res2 = vkCreateSemaphore(m_renderer.m_backend.m_device, &semaphoreInfo, nullptr, &m_imageAvailSemaphore);
-
-	if (res1 != VK_SUCCESS && res2 != VK_SUCCESS) {
-		throw std::runtime_error("could not create semaphore");
-	}
-
 	createCommandBuffer();
 	recordCommandBuffers();
 }
 
 ClearScreenPass::~ClearScreenPass()
 {
-	vkDestroySemaphore(m_renderer.m_backend.m_device, m_renderWaitSemaphore, nullptr);
+	vkDestroyCommandPool(m_renderer.m_backend.m_device, m_commandPool, nullptr);
 }
 
-void ClearScreenPass::RenderFrame()
+VkCommandBuffer ClearScreenPass::RenderFrame(uint32_t imageIndex)
 {
-	uint32_t ImageIndex = 0;
-
-	VkResult res = vkAcquireNextImageKHR(m_renderer.m_backend.m_device, m_renderer.m_backend.m_swapChain, UINT64_MAX, m_imageAvailSemaphore, nullptr, &ImageIndex);
-	if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
-		throw std::runtime_error("failed to acquire next image");
-	}
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_cmdBufs[ImageIndex];
-
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &m_imageAvailSemaphore;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &m_renderWaitSemaphore;
-
-	VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	submitInfo.pWaitDstStageMask = &waitDstStageMask;
-
-	res = vkQueueSubmit(m_renderer.m_backend.m_presentQueue, 1, &submitInfo, nullptr);
-	if (res != VK_SUCCESS) {
-		throw std::runtime_error("failed to submit queue");
-	}
-
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &m_renderer.m_backend.m_swapChain;
-	presentInfo.pImageIndices = &ImageIndex;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &m_renderWaitSemaphore;
-
-	res = vkQueuePresentKHR(m_renderer.m_backend.m_presentQueue, &presentInfo);
-	if (res != VK_SUCCESS) {
-		throw std::runtime_error("failed to present queue");
-	}
+	//prerecorded per swap chain image, nothing to record
+	return m_cmdBufs[imageIndex];
 }
 
 void ClearScreenPass::createCommandBuffer()
@@ -80,7 +36,8 @@ void ClearScreenPass::createCommandBuffer()
 
 	VkCommandPoolCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	createInfo.queueFamilyIndex = m_renderer.m_backend.m_queueFamily.presentFamily.value();
+	//the FrameScheduler submits to the graphics queue
+	createInfo.queueFamilyIndex = m_renderer.m_backend.m_queueFamily.graphicsFamily.value();
 
 	VkResult res = vkCreateCommandPool(m_renderer.m_backend.m_device, &createInfo, nullptr, &m_commandPool);
 	if (res != VK_SUCCESS) {
@@ -115,12 +72,12 @@ void ClearScreenPass::recordCommandBuffers()
 	{
 		VkImageMemoryBarrier presentToClearBarrier = {};
 		presentToClearBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		presentToClearBarrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		presentToClearBarrier.srcAccessMask = 0;
 		presentToClearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		presentToClearBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		presentToClearBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		presentToClearBarrier.srcQueueFamilyIndex = m_renderer.m_backend.m_queueFamily.presentFamily.value();
-		presentToClearBarrier.dstQueueFamilyIndex = m_renderer.m_backend.m_queueFamily.presentFamily.value();
+		presentToClearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		presentToClearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		presentToClearBarrier.image = m_renderer.m_backend.m_swapChainParams.swapChainImages[i];
 		presentToClearBarrier.subresourceRange = imageRange;
 
@@ -131,8 +88,8 @@ void ClearScreenPass::recordCommandBuffers()
 		clearToPresentBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 		clearToPresentBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 		clearToPresentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		clearToPresentBarrier.srcQueueFamilyIndex = m_renderer.m_backend.m_queueFamily.presentFamily.value();
-		clearToPresentBarrier.dstQueueFamilyIndex = m_renderer.m_backend.m_queueFamily.presentFamily.value();
+		clearToPresentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		clearToPresentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		clearToPresentBarrier.image = m_renderer.m_backend.m_swapChainParams.swapChainImages[i];
 		clearToPresentBarrier.subresourceRange = imageRange;
 
@@ -142,7 +99,8 @@ void ClearScreenPass::recordCommandBuffers()
 			throw std::runtime_error("failed to begin command buffer");
 		}
 
-		vkCmdPipelineBarrier(m_cmdBufs[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &presentToClearBarrier);
+		//chains onto the acquire semaphore, which the FrameScheduler waits on at color attachment output
+		vkCmdPipelineBarrier(m_cmdBufs[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &presentToClearBarrier);
 
 		vkCmdClearColorImage(m_cmdBufs[i], m_renderer.m_backend.m_swapChainParams.swapChainImages[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &m_clearColor, 1, &imageRange);
 
@@ -10,7 +10,7 @@ public:
 	ClearScreenPass(Vulkan_Renderer& renderer);
 	~ClearScreenPass();
 	Vulkan_Renderer& m_renderer;
-	virtual void RenderFrame() override;
+	virtual VkCommandBuffer RenderFrame(uint32_t imageIndex) override;
 
 	void createCommandBuffer();
 	void recordCommandBuffers();
@@ -19,6 +19,4 @@ public:
 	VkClearValue m_clearValue;
 	VkCommandPool m_commandPool;
 	std::vector<VkCommandBuffer> m_cmdBufs;
-	VkSemaphore m_renderWaitSemaphore;
-	VkSemaphore m_imageAvailSemaphore;
 };
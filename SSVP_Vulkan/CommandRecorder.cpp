@@ -0,0 +1,140 @@
+#include "CommandRecorder.h"
+#include "Renderer.h"
+#include "JobSystem.h"
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+CommandRecorder::CommandRecorder(Vulkan_Backend& backend, JobSystem& jobs)
+	: m_backend{ backend }, m_jobs{ jobs }, m_threadCount{ jobs.workerCount() + 1 }
+{
+	m_pools.resize(static_cast<size_t>(m_backend.m_framesInFlight) * m_threadCount);
+	for (ThreadPool& pool : m_pools)
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = m_backend.m_queueFamily.graphicsFamily.value();
+		//buffers only live for one frame and are never reset one by one
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(m_backend.m_device, &poolInfo, nullptr, &pool.pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create frame command pool");
+	}
+}
+
+CommandRecorder::~CommandRecorder()
+{
+	printStats();
+
+	//destroying a pool frees its buffers
+	for (ThreadPool& pool : m_pools)
+		vkDestroyCommandPool(m_backend.m_device, pool.pool, nullptr);
+}
+
+void CommandRecorder::beginFrame(uint32_t frame)
+{
+	m_frame = frame % m_backend.m_framesInFlight;
+	m_frames++;
+
+	for (uint32_t thread = 0; thread < m_threadCount; ++thread)
+	{
+		ThreadPool& pool = m_pools[static_cast<size_t>(m_frame) * m_threadCount + thread];
+		if (pool.usedPrimaries + pool.usedSecondaries == 0)
+			continue;
+
+		if (vkResetCommandPool(m_backend.m_device, pool.pool, 0) != VK_SUCCESS)
+			throw std::runtime_error("failed to reset frame command pool");
+		pool.usedPrimaries = 0;
+		pool.usedSecondaries = 0;
+	}
+}
+
+CommandRecorder::ThreadPool& CommandRecorder::threadPool()
+{
+	//non worker threads share the last slot, only the thread driving the frame records from outside the job system
+	int32_t worker = m_jobs.currentWorker();
+	uint32_t thread = worker >= 0 ? static_cast<uint32_t>(worker) : m_threadCount - 1;
+	return m_pools[static_cast<size_t>(m_frame) * m_threadCount + thread];
+}
+
+VkCommandBuffer CommandRecorder::acquire(ThreadPool& pool, VkCommandBufferLevel level)
+{
+	const bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	std::vector<VkCommandBuffer>& buffers = primary ? pool.primaries : pool.secondaries;
+	size_t& used = primary ? pool.usedPrimaries : pool.usedSecondaries;
+
+	if (used == buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool.pool;
+		allocInfo.level = level;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(m_backend.m_device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate frame command buffer");
+		buffers.push_back(commandBuffer);
+	}
+	return buffers[used++];
+}
+
+VkCommandBuffer CommandRecorder::allocatePrimary()
+{
+	return acquire(threadPool(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+}
+
+void CommandRecorder::recordSecondaries(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer,
+	size_t drawCount, size_t minBatch, const RecordDrawsFn& record, std::vector<VkCommandBuffer>& outSecondaries)
+{
+	if (drawCount == 0)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+
+	//two batches per thread, fewer when the batches would get smaller than minBatch
+	size_t batchSize = std::max<size_t>(std::max<size_t>(minBatch, 1), (drawCount + m_threadCount * 2 - 1) / (m_threadCount * 2));
+	size_t batchCount = (drawCount + batchSize - 1) / batchSize;
+
+	size_t first = outSecondaries.size();
+	outSecondaries.resize(first + batchCount);
+
+	m_jobs.parallelFor(batchCount, [&](size_t batch) {
+		VkCommandBuffer commandBuffer = acquire(threadPool(), VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+		VkCommandBufferInheritanceInfo inheritance{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = renderPass;
+		inheritance.subpass = subpass;
+		inheritance.framebuffer = framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritance;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("failed to begin recording secondary command buffer");
+
+		size_t begin = batch * batchSize;
+		record(commandBuffer, begin, std::min(drawCount, begin + batchSize));
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to end recording secondary command buffer");
+		outSecondaries[first + batch] = commandBuffer;
+	});
+
+	m_draws += drawCount;
+	m_secondaries += batchCount;
+	m_recordNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CommandRecorder::printStats() const
+{
+	if (m_frames == 0)
+		return;
+
+	std::cout << "[COMMANDS]: " << m_frames << " frames on " << m_threadCount << " recording threads, "
+		<< m_draws.load() / m_frames << " draws and " << m_secondaries.load() / m_frames << " secondaries per frame, "
+		<< m_recordNanoseconds.load() / 1.0e6 / m_frames << " ms recording per frame" << std::endl;
+}
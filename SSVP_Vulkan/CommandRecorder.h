@@ -0,0 +1,64 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <functional>
+#include <atomic>
+
+class Vulkan_Backend;
+class JobSystem;
+
+//records draws of [begin, end) into a secondary command buffer inside a render pass
+typedef std::function<void(VkCommandBuffer commandBuffer, size_t begin, size_t end)> RecordDrawsFn;
+
+//one command pool per frame in flight and per recording thread (every job worker plus the thread
+//that drives the frame). a thread only ever allocates from its own pool, so no locking is needed,
+//and a finished frame releases everything it recorded with one vkResetCommandPool per pool.
+//buffers stay allocated across resets and are handed out again the next time the slot is used
+class CommandRecorder {
+public:
+	CommandRecorder(Vulkan_Backend& backend, JobSystem& jobs);
+	CommandRecorder(const CommandRecorder&) = delete;
+	CommandRecorder& operator=(const CommandRecorder&) = delete;
+	~CommandRecorder();
+
+	//resets every pool of the frame slot, the slot's previous submission has to be complete
+	void beginFrame(uint32_t frame);
+
+	//from the calling thread's pool of the current frame, not begun yet
+	VkCommandBuffer allocatePrimary();
+
+	//splits [0, drawCount) into batches of at least minBatch draws and records every batch as a secondary
+	//buffer continuing subpass of renderPass on the job system. outSecondaries gets them in draw order,
+	//ready for vkCmdExecuteCommands inside a VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS subpass
+	void recordSecondaries(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer,
+		size_t drawCount, size_t minBatch, const RecordDrawsFn& record, std::vector<VkCommandBuffer>& outSecondaries);
+
+	void printStats() const;
+
+private:
+	struct ThreadPool {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> primaries;
+		std::vector<VkCommandBuffer> secondaries;
+		//handed out since the last reset
+		size_t usedPrimaries = 0;
+		size_t usedSecondaries = 0;
+	};
+
+	ThreadPool& threadPool();
+	VkCommandBuffer acquire(ThreadPool& pool, VkCommandBufferLevel level);
+
+	Vulkan_Backend& m_backend;
+	JobSystem& m_jobs;
+	uint32_t m_threadCount;
+	uint32_t m_frame = 0;
+	//frames in flight * m_threadCount, frame major
+	std::vector<ThreadPool> m_pools;
+
+	uint64_t m_frames = 0;
+	std::atomic<uint64_t> m_draws{ 0 };
+	std::atomic<uint64_t> m_secondaries{ 0 };
+	std::atomic<uint64_t> m_recordNanoseconds{ 0 };
+};
@@ -5,379 +5,254 @@
 #include <array>
 #include "AssetUtilities.h"
 #include "Primitives.h"
+#include "PipelineStateCache.h"
+#include "DescriptorAllocator.h"
+#include "GeometryArena.h"
+#include "FrameScheduler.h"
 
-void DeferredRenderPass::createAttachment(VkFormat format, VkImageUsageFlagBits usage, framebufferAttachment* attachment)
+DeferredRenderPass::DeferredRenderPass(Vulkan_Renderer& renderer) : m_renderer{ renderer }
 {
-	VkImageAspectFlags aspectMask = 0;
-	VkImageLayout imageLayout;
+	createRenderGraph();
+	createSampler();
+	createDescriptorLayout();
+	createPipeline();
 
-	attachment->format = format;
-
-	if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
-	{
-		aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	}
-	if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
-	{
-		aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-		imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	}
-
-	if (aspectMask <= 0)
-	{
-		throw std::runtime_error("Aspect mask was equal to or less than zero in createAttachment inside DEFERRED RENDER PASS");
-	}
-
-	VkImageCreateInfo image{};
-	image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	image.format = format;
-	image.extent.width = m_offScreenFramebuffer.width;
-	image.extent.height = m_offScreenFramebuffer.height;
-	image.extent.depth = 1;
-	image.mipLevels = 1;
-	image.arrayLayers = 1;
-	image.samples = VK_SAMPLE_COUNT_1_BIT;
-	image.tiling = VK_IMAGE_TILING_OPTIMAL;
-	image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	VkMemoryRequirements memReqs;
-
-	if (
-		vkCreateImage(m_renderer.m_backend.m_device, &image, nullptr, &attachment->image) != VK_SUCCESS
-		)
-	{
-		throw std::runtime_error("cant create Image");
-	}
-
-	vkGetImageMemoryRequirements(m_renderer.m_backend.m_device, attachment->image, &memReqs);
-	memAlloc.allocationSize = memReqs.size;
-	memAlloc.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_renderer.m_backend);
-
-	VK_CHECK_RESULT(vkAllocateMemory(m_renderer.m_backend.m_device, &memAlloc, nullptr, &attachment->mem), "failed to allocate memory");
-	VK_CHECK_RESULT(vkBindImageMemory(m_renderer.m_backend.m_device, attachment->image, attachment->mem, 0), "failed to bind image memory");
-
-	VkImageViewCreateInfo imageView{};
-	imageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	imageView.format = format;
-	imageView.subresourceRange = {};
-	imageView.subresourceRange.aspectMask = aspectMask;
-	imageView.subresourceRange.baseMipLevel = 0;
-	imageView.subresourceRange.levelCount = 1;
-	imageView.subresourceRange.baseArrayLayer = 0;
-	imageView.subresourceRange.layerCount = 1;
-	imageView.image = attachment->image;
-
-	VK_CHECK_RESULT(vkCreateImageView(m_renderer.m_backend.m_device, &imageView, nullptr, &attachment->view), "failed to create image view");
+	//the pools don't depend on the swap chain, a resize keeps them
+	m_commandRecorder = std::make_unique<CommandRecorder>(m_renderer.m_backend, *m_renderer.m_backend.m_jobs);
 }
 
-void DeferredRenderPass::createPipeline()
+DeferredRenderPass::~DeferredRenderPass()
 {
-	auto vertShaderCode = readFile("shaders/fsQuadvs.spv");
-	auto fragShaderCode = readFile("shaders/fsQuadfs.spv");
-
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, m_renderer.m_backend.m_device);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, m_renderer.m_backend.m_device);
+	m_commandRecorder.reset();
+	m_renderGraph.reset();
 
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule;
-	vertShaderStageInfo.pName = "main";
+	vkDestroySampler(m_renderer.m_backend.m_device, m_texSampler, nullptr);
+	vkDestroyDescriptorSetLayout(m_renderer.m_backend.m_device, m_gbufferSetLayout, nullptr);
 
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
-	fragShaderStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo , fragShaderStageInfo };
+	//the pipelines belong to the backend's PipelineStateCache
+	vkDestroyPipelineLayout(m_renderer.m_backend.m_device, m_compositionLayout, nullptr);
+	vkDestroyPipelineLayout(m_renderer.m_backend.m_device, m_pipelineLayout, nullptr);
+}
 
-	auto bindingDescription = getBindingDescription();
-	auto attributeDescriptions = getAttributeDescriptions();
+VkCommandBuffer DeferredRenderPass::RenderFrame(uint32_t imageIndex)
+{
+	return recordFrame(imageIndex);
+}
 
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+void DeferredRenderPass::freeResources()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_renderer.m_backend.m_queueMutex);
+		vkDeviceWaitIdle(m_renderer.m_backend.m_device);
+	}
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
+	//g-buffer targets, render passes and framebuffers belong to the graph, it compiles again against the new swap chain
+	m_renderGraph->destroyCompiled();
+}
 
-	m_renderer.m_viewport.x = 0.0f;
-	m_renderer.m_viewport.y = 0.0f;
-	m_renderer.m_viewport.width = (float)m_renderer.m_backend.m_swapChainParams.swapChainExtent.width;
-	m_renderer.m_viewport.height = (float)m_renderer.m_backend.m_swapChainParams.swapChainExtent.height;
-	m_renderer.m_viewport.minDepth = 0.0f;
-	m_renderer.m_viewport.maxDepth = 1.0f;
+void DeferredRenderPass::recreateResources()
+{
+	createRenderGraph();
+	//the recompiled render passes are compatible with the old ones, so this is a cache hit
+	createPipeline();
+}
 
-	VkRect2D scissor{};
-	scissor.offset = { 0,0 };
-	scissor.extent = { m_renderer.m_backend.m_swapChainParams.swapChainExtent };
-
-	VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &m_renderer.m_viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-	rasterizer.depthBiasConstantFactor = 0.0f;
-	rasterizer.depthBiasClamp = 0.0f;
-	rasterizer.depthBiasSlopeFactor = 0.0f;
-
-	VkPipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisampling.minSampleShading = 1.0f;
-	multisampling.pSampleMask = nullptr;
-	multisampling.alphaToCoverageEnable = VK_FALSE;
-	multisampling.alphaToOneEnable = VK_FALSE;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending{};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f; // Optional
-	colorBlending.blendConstants[1] = 0.0f; // Optional
-	colorBlending.blendConstants[2] = 0.0f; // Optional
-	colorBlending.blendConstants[3] = 0.0f; // Optional
-
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil{};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.minDepthBounds = 0.0f;
-	depthStencil.maxDepthBounds = 1.0f;
-	depthStencil.stencilTestEnable = VK_FALSE;
-	depthStencil.front = {};
-	depthStencil.back = {};
-
-	VkDynamicState dynamicStates[] = {
-		VK_DYNAMIC_STATE_VIEWPORT,		
-		VK_DYNAMIC_STATE_SCISSOR
+void DeferredRenderPass::createRenderGraph()
+{
+	if (!m_renderGraph)
+	{
+		Vulkan_Backend& backend = m_renderer.m_backend;
+		m_renderGraph = std::make_unique<RenderGraph>(backend.m_device, backend.m_allocator, backend.m_swapChainParams.swapChainExtent,
+			[&backend](std::function<void()> destroy) { backend.m_frames->defer(std::move(destroy)); });
+	}
+	m_renderGraph->clear();
+
+	SwapChain_ParamsAndData& swapChain = m_renderer.m_backend.m_swapChainParams;
+	m_backbuffer = m_renderGraph->importImages("backbuffer", swapChain.swapChainImageFormat, swapChain.swapChainImages,
+		swapChain.swapChainImageViews, swapChain.swapChainExtent, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+	//swap chain sized, the graph resizes them with it
+	m_position = m_renderGraph->createImage("gbuffer position", { VK_FORMAT_R32G32B32A32_SFLOAT });
+	m_normal = m_renderGraph->createImage("gbuffer normal", { VK_FORMAT_R16G16B16A16_SFLOAT });
+	m_albedo = m_renderGraph->createImage("gbuffer albedo", { VK_FORMAT_R8G8B8A8_UNORM });
+	m_depth = m_renderGraph->createImage("gbuffer depth", { VK_FORMAT_D32_SFLOAT });
+
+	auto target = [](RenderGraphResource resource, RenderGraphUsage usage) {
+		RenderGraphAccess access{};
+		access.resource = resource;
+		access.usage = usage;
+		access.clear = true;
+		if (usage == RenderGraphUsage::DepthAttachment)
+			access.clearValue.depthStencil = { 1.0f, 0 };
+		return access;
 	};
 
-	VkPipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = 2;
-	dynamicState.pDynamicStates = dynamicStates;
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 0;
-	pipelineLayoutInfo.pSetLayouts = nullptr;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+	m_gbufferPass = m_renderGraph->addPass("gbuffer", {
+		target(m_position, RenderGraphUsage::ColorAttachment),
+		target(m_normal, RenderGraphUsage::ColorAttachment),
+		target(m_albedo, RenderGraphUsage::ColorAttachment),
+		target(m_depth, RenderGraphUsage::DepthAttachment) }, [this](const RenderGraphPassContext& context) {
+		vkCmdBindPipeline(context.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_deferredPipeline);
+
+		VkViewport viewport = m_renderer.m_viewport;
+		viewport.width = static_cast<float>(context.extent.width);
+		viewport.height = static_cast<float>(context.extent.height);
+		vkCmdSetViewport(context.commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor{ { 0, 0 }, context.extent };
+		vkCmdSetScissor(context.commandBuffer, 0, 1, &scissor);
+
+		for (const Mesh& mesh : m_meshList)
+		{
+			if (!mesh.geometry || !m_renderer.m_backend.m_uploader.isComplete(mesh.uploadToken))
+				continue;
+			m_renderer.m_backend.m_geometryArena->bind(context.commandBuffer, mesh.vertexFormat, mesh.indexType);
+			mesh.recordDraw(context.commandBuffer);
+		}
+	});
 
-	if (vkCreatePipelineLayout(m_renderer.m_backend.m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to create pipeline layout!");
-	}
+	auto sampled = [](RenderGraphResource resource) {
+		RenderGraphAccess access{};
+		access.resource = resource;
+		access.usage = RenderGraphUsage::Sampled;
+		return access;
+	};
 
-	VkGraphicsPipelineCreateInfo pipelineInfo{};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = m_pipelineLayout;
-	pipelineInfo.renderPass = m_renderPass;
-	pipelineInfo.subpass = 0;
-
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-	pipelineInfo.basePipelineIndex = -1;
-
-	if (
-		vkCreateGraphicsPipelines(m_renderer.m_backend.m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_presentPipeline) != VK_SUCCESS
-		)
-	{
-		throw std::runtime_error("failed to create full screen quad pipeline!");
-	}
+	RenderGraphAccess output{};
+	output.resource = m_backbuffer;
+	output.usage = RenderGraphUsage::ColorAttachment;
+	output.clear = true;
+
+	m_compositionPass = m_renderGraph->addPass("composition", { sampled(m_position), sampled(m_normal), sampled(m_albedo), output },
+		[this](const RenderGraphPassContext& context) {
+		//the views are the graph's, recreated with every compile, so the set is written for the frame that uses it
+		VkDescriptorSet descriptorSet = m_renderer.m_backend.m_descriptors->allocateFrame(m_gbufferSetLayout);
+		std::array<VkDescriptorImageInfo, 3> images;
+		std::array<VkWriteDescriptorSet, 3> writes{};
+		const RenderGraphResource targets[3] = { m_position, m_normal, m_albedo };
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			images[i].sampler = m_texSampler;
+			images[i].imageView = m_renderGraph->view(targets[i]);
+			images[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[i].pImageInfo = &images[i];
+		}
+		vkUpdateDescriptorSets(m_renderer.m_backend.m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 
-	vertShaderCode = readFile("shaders/deferredVS.spv");
-	fragShaderCode = readFile("shaders/deferredFS.spv");
-	vertShaderModule = createShaderModule(vertShaderCode, m_renderer.m_backend.m_device);
-	fragShaderModule = createShaderModule(fragShaderCode, m_renderer.m_backend.m_device);
+		vkCmdBindPipeline(context.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_presentPipeline);
+		vkCmdBindDescriptorSets(context.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_compositionLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-	pipelineInfo.renderPass = m_offScreenFramebuffer.renderPass;
+		VkViewport viewport = m_renderer.m_viewport;
+		viewport.width = static_cast<float>(context.extent.width);
+		viewport.height = static_cast<float>(context.extent.height);
+		vkCmdSetViewport(context.commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor{ { 0, 0 }, context.extent };
+		vkCmdSetScissor(context.commandBuffer, 0, 1, &scissor);
 
-	VkPipelineColorBlendAttachmentState attachmentState{};
-	attachmentState.colorWriteMask = 0xf;
-	attachmentState.blendEnable = VK_FALSE;
+		vkCmdDraw(context.commandBuffer, 4, 1, 0, 0);
+	});
 
-	std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentState = {
-		attachmentState,
-		attachmentState,
-		attachmentState
-	};
-	colorBlending.attachmentCount = static_cast<uint32_t>(blendAttachmentState.size());
-	colorBlending.pAttachments = blendAttachmentState.data();
+	m_renderGraph->compile();
+}
 
-	if (
-		vkCreateGraphicsPipelines(m_renderer.m_backend.m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_deferredPipeline) != VK_SUCCESS
-		)
+void DeferredRenderPass::createDescriptorLayout()
+{
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	for (uint32_t i = 0; i < 3; ++i)
 	{
-		throw std::runtime_error("failed to create full screen quad pipeline!");
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	}
 
-	vkDestroyShaderModule(m_renderer.m_backend.m_device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(m_renderer.m_backend.m_device, vertShaderModule, nullptr);
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_renderer.m_backend.m_device, &layoutInfo, nullptr, &m_gbufferSetLayout),
+		"failed to create descriptor set layout");
 }
 
-void DeferredRenderPass::createFramebuffer()
+void DeferredRenderPass::createPipeline()
 {
-	m_offScreenFramebuffer.width = m_renderer.m_backend.m_width;
-	m_offScreenFramebuffer.height = m_renderer.m_backend.m_height;
-
-	createAttachment(
-		VK_FORMAT_R32G32B32A32_SFLOAT,
-		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		&m_offScreenFramebuffer.pos
-	);
-
-	createAttachment(
-		VK_FORMAT_R16G16B16A16_SFLOAT,
-		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		&m_offScreenFramebuffer.norm
-	);
-
-	createAttachment(
-		VK_FORMAT_R8G8B8A8_UNORM,
-		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		&m_offScreenFramebuffer.col
-	);
-
-	createAttachment(
-		VK_FORMAT_D32_SFLOAT,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		&m_offScreenFramebuffer.depth
-	);
-
-	std::array<VkAttachmentDescription, 4> attachmentDescs = {};
-	
-	for (uint32_t i = 0; i < 4; ++i)
-	{
-		attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	m_renderer.m_viewport.x = 0.0f;
+	m_renderer.m_viewport.y = 0.0f;
+	m_renderer.m_viewport.width = (float)m_renderer.m_backend.m_swapChainParams.swapChainExtent.width;
+	m_renderer.m_viewport.height = (float)m_renderer.m_backend.m_swapChainParams.swapChainExtent.height;
+	m_renderer.m_viewport.minDepth = 0.0f;
+	m_renderer.m_viewport.maxDepth = 1.0f;
 
-		if (i == 3)
+	//layouts don't depend on the swap chain, a resize keeps them
+	if (m_pipelineLayout == VK_NULL_HANDLE)
+	{
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 0;
+		pipelineLayoutInfo.pSetLayouts = nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(m_renderer.m_backend.m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
 		{
-			attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			throw std::runtime_error("failed to create pipeline layout!");
 		}
-		else {
-			attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &m_gbufferSetLayout;
+		if (vkCreatePipelineLayout(m_renderer.m_backend.m_device, &pipelineLayoutInfo, nullptr, &m_compositionLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
 		}
 	}
 
-	attachmentDescs[0].format = m_offScreenFramebuffer.pos.format;
-	attachmentDescs[1].format = m_offScreenFramebuffer.norm.format;
-	attachmentDescs[2].format = m_offScreenFramebuffer.col.format;
-	attachmentDescs[3].format = m_offScreenFramebuffer.depth.format;
-
-	std::vector<VkAttachmentReference> colorReferences;
-	colorReferences.push_back({ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
-	colorReferences.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-	colorReferences.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-
-	VkAttachmentReference depthReference{};
-	depthReference.attachment = 3;
-	depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass{};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.pColorAttachments = colorReferences.data();
-	subpass.colorAttachmentCount = static_cast < uint32_t>(colorReferences.size());
-	subpass.pDepthStencilAttachment = &depthReference;
-
-	std::array<VkSubpassDependency, 2> dependencies;
-
-	dependencies[0].srcSubpass= VK_SUBPASS_EXTERNAL;
-	dependencies[0].dstSubpass = 0;
-	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-	dependencies[1].srcSubpass = 0;
-	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-	VkRenderPassCreateInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.pAttachments = attachmentDescs.data();
-	renderPassInfo.attachmentCount = static_cast<uint32_t> (attachmentDescs.size());
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 2;
-	renderPassInfo.pDependencies = dependencies.data();
-
-	VK_CHECK_RESULT(vkCreateRenderPass(m_renderer.m_backend.m_device, &renderPassInfo, nullptr, &m_offScreenFramebuffer.renderPass), "failed to create render pass");
-
-	std::array<VkImageView, 4> attachments;
-	attachments[0] = m_offScreenFramebuffer.pos.view;
-	attachments[1] = m_offScreenFramebuffer.norm.view;
-	attachments[2] = m_offScreenFramebuffer.col.view;
-	attachments[3] = m_offScreenFramebuffer.depth.view;
-
-	VkFramebufferCreateInfo fbCreateInfo = {};
-	fbCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	fbCreateInfo.pNext = NULL;
-	fbCreateInfo.renderPass = m_offScreenFramebuffer.renderPass;
-	fbCreateInfo.pAttachments = attachments.data();
-	fbCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-	fbCreateInfo.width = m_offScreenFramebuffer.width;
-	fbCreateInfo.height = m_offScreenFramebuffer.height;
-	fbCreateInfo.layers = 1;
-	VK_CHECK_RESULT(vkCreateFramebuffer(m_renderer.m_backend.m_device, &fbCreateInfo, nullptr, &m_offScreenFramebuffer.framebuffer), "failed to create framebuffer");
+	auto attributeDescriptions = getAttributeDescriptions();
+
+	//fullscreen quad from the vertex index, no depth
+	GraphicsPipelineDesc present;
+	present.name = "deferred present";
+	present.vertexShader = "shaders/fsQuadvs.spv";
+	present.fragmentShader = "shaders/fsQuadfs.spv";
+	present.bindings = { getBindingDescription() };
+	present.attributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+	present.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+	present.blendAttachments = { opaqueBlendAttachment() };
+	//viewport and scissor are set while recording, a resize keeps the pipelines
+	present.dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	present.layout = m_compositionLayout;
+	present.renderPass = m_renderGraph->renderPass(m_compositionPass);
+	present.renderPassKey = m_renderGraph->renderPassKey(m_compositionPass);
+
+	//g-buffer shaders, depth and one blend attachment per g-buffer target
+	GraphicsPipelineDesc deferred = present;
+	deferred.name = "deferred g-buffer";
+	deferred.vertexShader = "shaders/deferredVS.spv";
+	deferred.fragmentShader = "shaders/deferredFS.spv";
+	deferred.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	deferred.depthTest = true;
+	deferred.depthWrite = true;
+	deferred.depthCompare = VK_COMPARE_OP_LESS;
+	deferred.blendAttachments.assign(3, opaqueBlendAttachment());
+	deferred.layout = m_pipelineLayout;
+	deferred.renderPass = m_renderGraph->renderPass(m_gbufferPass);
+	deferred.renderPassKey = m_renderGraph->renderPassKey(m_gbufferPass);
+
+	//both compile at once, the cache owns them
+	PipelineStateCache& pipelines = *m_renderer.m_backend.m_pipelineStates;
+	PipelineStateId presentState = pipelines.request(present);
+	PipelineStateId deferredState = pipelines.request(deferred);
+	m_presentPipeline = pipelines.get(presentState);
+	m_deferredPipeline = pipelines.get(deferredState);
+}
 
+void DeferredRenderPass::createSampler()
+{
 	VkSamplerCreateInfo sampler{};
 	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	sampler.magFilter = VK_FILTER_NEAREST;
@@ -393,6 +268,24 @@ void DeferredRenderPass::createFramebuffer()
 	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
 	VK_CHECK_RESULT(vkCreateSampler(m_renderer.m_backend.m_device, &sampler, nullptr, &m_texSampler), "Could not create Sampler");
-
 }
 
+VkCommandBuffer DeferredRenderPass::recordFrame(uint32_t imageIndex)
+{
+	//the FrameScheduler waited for this frame slot, nothing recorded into its pools is in use anymore
+	m_commandRecorder->beginFrame(m_renderer.m_backend.m_frames->frameIndex());
+
+	VkCommandBuffer commandBuffer = m_commandRecorder->allocatePrimary();
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) throw std::runtime_error("failed to begin recording command buffer");
+
+	//the g-buffer is cleared and written, then sampled by the composition, the graph puts the barriers in between
+	m_renderGraph->setImportedIndex(m_backbuffer, imageIndex);
+	m_renderGraph->execute(commandBuffer);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) throw std::runtime_error("failed to end recording command buffer");
+	return commandBuffer;
+}
@@ -3,52 +3,58 @@
 #include "RenderPass.h"
 #include "Renderer.h"
 #include <glm/glm.hpp>
+#include <memory>
 
 #include "VertexBuffer.h"
+#include "RenderGraph.h"
+#include "CommandRecorder.h"
 
 class Vulkan_Renderer;
 
+//g-buffer pass into position, normal and albedo targets plus depth, then a composition pass that samples
+//them into the backbuffer. the targets, render passes, framebuffers and barriers all come from the graph
 class DeferredRenderPass : public RenderPass
 {
 public:
 	DeferredRenderPass(Vulkan_Renderer& renderer);
 	~DeferredRenderPass();
 
-	virtual void RenderFrame() override;
+	virtual VkCommandBuffer RenderFrame(uint32_t imageIndex) override;
 	virtual void freeResources() override;
 	virtual void recreateResources() override;
-	
+
 public:
 	Vulkan_Renderer& m_renderer;
-		
-
-	struct framebufferAttachment{
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
-		VkFormat format;
-	};
-
-	struct framebuffer {
-		int32_t width, height;
-		VkFramebuffer framebuffer;
-		framebufferAttachment pos, norm, col;
-		framebufferAttachment depth;
-		VkRenderPass renderPass;
-	} m_offScreenFramebuffer;
 
-	VkSampler m_texSampler;
+	//recompiled when the swap chain changes, the g-buffer targets are its transients
+	std::unique_ptr<RenderGraph> m_renderGraph;
+	RenderGraphResource m_backbuffer;
+	RenderGraphResource m_position, m_normal, m_albedo, m_depth;
+	uint32_t m_gbufferPass;
+	uint32_t m_compositionPass;
 
-	VkRenderPass m_renderPass;
+	VkSampler m_texSampler;
 
-	VkCommandBuffer m_cmdBuffer = VK_NULL_HANDLE;
-	VkSemaphore m_deferredSemaphore = VK_NULL_HANDLE;
-	VkPipelineLayout m_pipelineLayout;
+	//g-buffer pass, no descriptors
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	//the g-buffer targets at bindings 0-2, written every frame since a recompile replaces their views
+	VkDescriptorSetLayout m_gbufferSetLayout;
+	VkPipelineLayout m_compositionLayout = VK_NULL_HANDLE;
+	//borrowed from the PipelineStateCache
 	VkPipeline m_deferredPipeline;
 	VkPipeline m_presentPipeline;
 
-public: 
-	void createAttachment(VkFormat format, VkImageUsageFlagBits usage, framebufferAttachment* attachment);
+	//per frame pools, the frame is recorded again every time
+	std::unique_ptr<CommandRecorder> m_commandRecorder;
+
+	//drawn into the g-buffer, filled by whoever owns the scene
+	std::vector<Mesh> m_meshList;
+
+public:
+	//declares the passes and compiles, the pipelines are built against the compiled render passes
+	void createRenderGraph();
 	void createPipeline();
-	void createFramebuffer();
-};
\ No newline at end of file
+	void createDescriptorLayout();
+	void createSampler();
+	VkCommandBuffer recordFrame(uint32_t imageIndex);
+};
@@ -0,0 +1,180 @@
+#include "DescriptorAllocator.h"
+#include "Renderer.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+//descriptors of each type per set in a pool, a pool holds DESCRIPTOR_POOL_SETS sets
+static const std::pair<VkDescriptorType, float> s_poolRatios[] = {
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1.0f },
+};
+
+DescriptorAllocator::DescriptorAllocator(Vulkan_Backend& backend) : m_backend{ backend }
+{
+	m_frames.resize(backend.m_framesInFlight);
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	printStats();
+
+	for (Pool& pool : m_persistent.pools)
+		vkDestroyDescriptorPool(m_backend.m_device, pool.pool, nullptr);
+	for (Chain& chain : m_frames)
+	{
+		for (Pool& pool : chain.pools)
+			vkDestroyDescriptorPool(m_backend.m_device, pool.pool, nullptr);
+	}
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(bool freeable)
+{
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (const auto& ratio : s_poolRatios)
+		poolSizes.push_back({ ratio.first, static_cast<uint32_t>(ratio.second * DESCRIPTOR_POOL_SETS) });
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	//transient pools are only ever reset as a whole
+	poolInfo.flags = freeable ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
+	poolInfo.maxSets = DESCRIPTOR_POOL_SETS;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_backend.m_device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create descriptor pool");
+	return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrom(Chain& chain, VkDescriptorSetLayout layout, bool freeable, VkDescriptorPool& outPool)
+{
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	while (true)
+	{
+		if (chain.current == chain.pools.size())
+		{
+			Pool pool;
+			pool.pool = createPool(freeable);
+			chain.pools.push_back(pool);
+		}
+
+		Pool& pool = chain.pools[chain.current];
+		allocInfo.descriptorPool = pool.pool;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(m_backend.m_device, &allocInfo, &set);
+		if (result == VK_SUCCESS)
+		{
+			pool.sets++;
+			outPool = pool.pool;
+			return set;
+		}
+
+		if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+			throw std::runtime_error("failed to allocate descriptor set");
+		//an empty pool failing means the layout needs more than s_poolRatios gives a pool
+		if (pool.sets == 0)
+			throw std::runtime_error("descriptor set layout doesn't fit a descriptor pool");
+
+		m_poolOverflows++;
+		chain.current++;
+	}
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	VkDescriptorPool pool;
+	VkDescriptorSet set = allocateFrom(m_persistent, layout, true, pool);
+	m_owners[set] = pool;
+	m_peakPersistentSets = std::max<uint64_t>(m_peakPersistentSets, m_owners.size());
+	return set;
+}
+
+void DescriptorAllocator::free(VkDescriptorSet set)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto owner = m_owners.find(set);
+	if (owner == m_owners.end())
+		throw std::runtime_error("descriptor set wasn't allocated by this allocator");
+
+	vkFreeDescriptorSets(m_backend.m_device, owner->second, 1, &set);
+	for (size_t i = 0; i < m_persistent.pools.size(); ++i)
+	{
+		Pool& pool = m_persistent.pools[i];
+		if (pool.pool == owner->second)
+		{
+			pool.sets--;
+			//the pool has room again, later allocations start there
+			m_persistent.current = std::min(m_persistent.current, i);
+			break;
+		}
+	}
+	m_owners.erase(owner);
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrame(VkDescriptorSetLayout layout)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	VkDescriptorPool pool;
+	VkDescriptorSet set = allocateFrom(m_frames[m_frame], layout, false, pool);
+	m_frameSets++;
+	m_totalFrameSets++;
+	return set;
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_peakFrameSets = std::max(m_peakFrameSets, m_frameSets);
+	m_frameSets = 0;
+	m_frame = frame;
+
+	Chain& chain = m_frames[frame];
+	for (Pool& pool : chain.pools)
+	{
+		if (pool.sets == 0)
+			continue;
+		vkResetDescriptorPool(m_backend.m_device, pool.pool, 0);
+		pool.sets = 0;
+	}
+	chain.current = 0;
+}
+
+DescriptorAllocatorStats DescriptorAllocator::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	DescriptorAllocatorStats stats;
+	stats.persistentPools = static_cast<uint32_t>(m_persistent.pools.size());
+	for (const Chain& chain : m_frames)
+		stats.framePools += static_cast<uint32_t>(chain.pools.size());
+	stats.persistentSets = m_owners.size();
+	stats.peakPersistentSets = m_peakPersistentSets;
+	stats.peakFrameSets = std::max(m_peakFrameSets, m_frameSets);
+	stats.frameSets = m_totalFrameSets;
+	stats.poolOverflows = m_poolOverflows;
+	return stats;
+}
+
+void DescriptorAllocator::printStats()
+{
+	DescriptorAllocatorStats stats = getStats();
+	std::cout << "[DESCRIPTORS]: " << stats.persistentPools << " persistent pools (" << stats.persistentSets << " sets, "
+		<< stats.peakPersistentSets << " peak), " << stats.framePools << " frame pools (" << stats.peakFrameSets << " sets peak per frame, "
+		<< stats.frameSets << " total), " << stats.poolOverflows << " pool overflows, " << DESCRIPTOR_POOL_SETS << " sets per pool" << std::endl;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+class Vulkan_Backend;
+
+struct DescriptorAllocatorStats {
+	uint32_t persistentPools = 0;
+	uint32_t framePools = 0;
+	//persistent sets alive now and at most
+	uint64_t persistentSets = 0;
+	uint64_t peakPersistentSets = 0;
+	//transient sets handed out by the busiest frame
+	uint64_t peakFrameSets = 0;
+	uint64_t frameSets = 0;
+	//allocations that found their pool full and moved on to the next one
+	uint64_t poolOverflows = 0;
+};
+
+//hands out every descriptor set of the passes, pools chain instead of being sized up front.
+//persistent sets come from pools of their own and live until free. transient sets live for one frame:
+//every frame slot has its own chain, reset with one vkResetDescriptorPool per pool in beginFrame,
+//the pools themselves are kept and handed out again
+class DescriptorAllocator {
+public:
+	explicit DescriptorAllocator(Vulkan_Backend& backend);
+	DescriptorAllocator(const DescriptorAllocator&) = delete;
+	DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+	~DescriptorAllocator();
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+	//no frame in flight may still use the set
+	void free(VkDescriptorSet set);
+
+	//valid until the frame slot comes around again, any thread
+	VkDescriptorSet allocateFrame(VkDescriptorSetLayout layout);
+	//resets the frame slot's pools, the slot's previous submission has to be complete
+	void beginFrame(uint32_t frame);
+
+	DescriptorAllocatorStats getStats();
+	void printStats();
+
+private:
+	struct Pool {
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		uint32_t sets = 0;
+	};
+
+	struct Chain {
+		std::vector<Pool> pools;
+		//pools before this one were full
+		size_t current = 0;
+	};
+
+	VkDescriptorPool createPool(bool freeable);
+	//tries the chain's current pool and moves on (creating pools as needed) while they are full
+	VkDescriptorSet allocateFrom(Chain& chain, VkDescriptorSetLayout layout, bool freeable, VkDescriptorPool& outPool);
+
+	Vulkan_Backend& m_backend;
+	std::mutex m_mutex;
+
+	Chain m_persistent;
+	//which pool a persistent set came from, for free
+	std::unordered_map<VkDescriptorSet, VkDescriptorPool> m_owners;
+	//one chain per frame in flight
+	std::vector<Chain> m_frames;
+	uint32_t m_frame = 0;
+
+	uint64_t m_frameSets = 0;
+	uint64_t m_peakFrameSets = 0;
+	uint64_t m_totalFrameSets = 0;
+	uint64_t m_peakPersistentSets = 0;
+	uint64_t m_poolOverflows = 0;
+};
@@ -0,0 +1,275 @@
+#include "FrameScheduler.h"
+#include "Renderer.h"
+#include "AssetUtilities.h"
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+FrameScheduler::FrameScheduler(Vulkan_Backend& backend, uint32_t framesInFlight)
+	: m_backend{ backend }, m_framesInFlight{ framesInFlight }, m_timeline{ backend.m_timelineSemaphores }
+{
+	m_slotFrames.resize(m_framesInFlight, 0);
+	m_imageAvailable.resize(m_framesInFlight, VK_NULL_HANDLE);
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	for (VkSemaphore& semaphore : m_imageAvailable)
+		VK_CHECK_RESULT(vkCreateSemaphore(m_backend.m_device, &semaphoreInfo, nullptr, &semaphore), "failed to create frame semaphore");
+
+	if (m_timeline)
+	{
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		timelineInfo.pNext = &typeInfo;
+		VK_CHECK_RESULT(vkCreateSemaphore(m_backend.m_device, &timelineInfo, nullptr, &m_timelineSemaphore), "failed to create timeline semaphore");
+	}
+	else
+	{
+		m_fences.resize(m_framesInFlight, VK_NULL_HANDLE);
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		for (VkFence& fence : m_fences)
+			VK_CHECK_RESULT(vkCreateFence(m_backend.m_device, &fenceInfo, nullptr, &fence), "failed to create frame fence");
+	}
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	waitIdle();
+	printStats();
+
+	for (VkSemaphore semaphore : m_imageAvailable)
+		vkDestroySemaphore(m_backend.m_device, semaphore, nullptr);
+	for (VkSemaphore semaphore : m_renderFinished)
+		vkDestroySemaphore(m_backend.m_device, semaphore, nullptr);
+	for (VkFence fence : m_fences)
+		vkDestroyFence(m_backend.m_device, fence, nullptr);
+	if (m_timelineSemaphore != VK_NULL_HANDLE)
+		vkDestroySemaphore(m_backend.m_device, m_timelineSemaphore, nullptr);
+}
+
+void FrameScheduler::createImageSemaphores()
+{
+	size_t imageCount = m_backend.m_swapChainParams.swapChainImages.size();
+	//a recreated swap chain with fewer images keeps the extra semaphores around
+	if (m_imageFrames.size() < imageCount)
+		m_imageFrames.resize(imageCount, 0);
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	while (m_renderFinished.size() < imageCount)
+	{
+		VkSemaphore semaphore;
+		VK_CHECK_RESULT(vkCreateSemaphore(m_backend.m_device, &semaphoreInfo, nullptr, &semaphore), "failed to create frame semaphore");
+		m_renderFinished.push_back(semaphore);
+	}
+}
+
+bool FrameScheduler::beginFrame()
+{
+	uint64_t frame = m_frame.load(std::memory_order_relaxed) + 1;
+	uint32_t slot = static_cast<uint32_t>(frame % m_framesInFlight);
+
+	//the slot's semaphore, command pools and per frame buffers were last used by this frame
+	if (frame > m_framesInFlight)
+		waitForFrame(frame - m_framesInFlight);
+	runDeferred();
+
+	uint32_t imageIndex;
+	VkResult result = vkAcquireNextImageKHR(m_backend.m_device, m_backend.m_swapChain, UINT64_MAX, m_imageAvailable[slot], VK_NULL_HANDLE, &imageIndex);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		m_backend.m_surfParams.resized = true;
+		m_skippedFrames++;
+		return false;
+	}
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		throw std::runtime_error("failed to acquire swap chain image");
+
+	createImageSemaphores();
+	waitForFrame(m_imageFrames[imageIndex]);
+	m_imageFrames[imageIndex] = frame;
+
+	m_frameIndex = slot;
+	m_imageIndex = imageIndex;
+	m_frame.store(frame, std::memory_order_release);
+	return true;
+}
+
+void FrameScheduler::submit(VkCommandBuffer commandBuffer)
+{
+	uint64_t frame = m_frame.load(std::memory_order_relaxed);
+
+	VkSemaphore waitSemaphores[] = { m_imageAvailable[m_frameIndex] };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkSemaphore signalSemaphores[] = { m_renderFinished[m_imageIndex], m_timelineSemaphore };
+	//binary semaphores ignore their value
+	uint64_t waitValues[] = { 0 };
+	uint64_t signalValues[] = { 0, frame };
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = 1;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = m_timeline ? &timelineInfo : nullptr;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = m_timeline ? 2 : 1;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	VkFence fence = VK_NULL_HANDLE;
+	if (!m_timeline)
+	{
+		fence = m_fences[m_frameIndex];
+		vkResetFences(m_backend.m_device, 1, &fence);
+	}
+
+	//the upload context submits to the same queue from job threads
+	std::lock_guard<std::mutex> lock(m_backend.m_queueMutex);
+	VK_CHECK_RESULT(vkQueueSubmit(m_backend.m_graphicsQueue, 1, &submitInfo, fence), "failed to submit draw command buffer");
+	m_slotFrames[m_frameIndex] = frame;
+	m_submitted = frame;
+
+	VkPresentInfoKHR presentInfo{};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &m_renderFinished[m_imageIndex];
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = &m_backend.m_swapChain;
+	presentInfo.pImageIndices = &m_imageIndex;
+
+	VkResult result = vkQueuePresentKHR(m_backend.m_presentQueue, &presentInfo);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		m_backend.m_surfParams.resized = true;
+	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		throw std::runtime_error("failed to present swap chain image");
+}
+
+uint64_t FrameScheduler::completedFrame()
+{
+	uint64_t completed = m_completed.load(std::memory_order_acquire);
+	if (completed >= m_submitted)
+		return completed;
+
+	if (m_timeline)
+	{
+		uint64_t value;
+		VK_CHECK_RESULT(vkGetSemaphoreCounterValue(m_backend.m_device, m_timelineSemaphore, &value), "failed to read timeline semaphore");
+		completed = std::max(completed, value);
+	}
+	else
+	{
+		//a signaled fence means every earlier submission to the queue completed as well
+		for (uint32_t slot = 0; slot < m_framesInFlight; ++slot)
+		{
+			if (m_slotFrames[slot] > completed && vkGetFenceStatus(m_backend.m_device, m_fences[slot]) == VK_SUCCESS)
+				completed = m_slotFrames[slot];
+		}
+	}
+
+	m_completed.store(completed, std::memory_order_release);
+	return completed;
+}
+
+void FrameScheduler::waitForFrame(uint64_t frame)
+{
+	if (frame <= m_completed.load(std::memory_order_acquire))
+		return;
+	if (frame > m_submitted)
+		throw std::runtime_error("waiting for a frame that wasn't submitted");
+
+	auto start = std::chrono::steady_clock::now();
+
+	uint64_t completed = frame;
+	if (m_timeline)
+	{
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_timelineSemaphore;
+		waitInfo.pValues = &frame;
+		VK_CHECK_RESULT(vkWaitSemaphores(m_backend.m_device, &waitInfo, UINT64_MAX), "failed to wait for frame");
+	}
+	else
+	{
+		//the slot was only reused after waiting for this frame, so its fence belongs to this frame or a later one
+		uint32_t slot = static_cast<uint32_t>(frame % m_framesInFlight);
+		VK_CHECK_RESULT(vkWaitForFences(m_backend.m_device, 1, &m_fences[slot], VK_TRUE, UINT64_MAX), "failed to wait for frame");
+		completed = m_slotFrames[slot];
+	}
+
+	m_completed.store(std::max(m_completed.load(std::memory_order_relaxed), completed), std::memory_order_release);
+	m_waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameScheduler::defer(std::function<void()> destroy)
+{
+	std::lock_guard<std::mutex> lock(m_deferredMutex);
+	m_deferred.push_back({ std::move(destroy), m_frame.load(std::memory_order_acquire) });
+}
+
+void FrameScheduler::runDeferred()
+{
+	uint64_t completed = completedFrame();
+
+	//run outside the lock, a destruction may defer more work
+	std::vector<std::function<void()>> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_deferredMutex);
+		while (!m_deferred.empty() && m_deferred.front().frame <= completed)
+		{
+			ready.push_back(std::move(m_deferred.front().destroy));
+			m_deferred.pop_front();
+		}
+	}
+
+	for (auto& destroy : ready)
+		destroy();
+	m_deferredRuns += ready.size();
+}
+
+void FrameScheduler::waitIdle()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_backend.m_queueMutex);
+		vkDeviceWaitIdle(m_backend.m_device);
+	}
+	//a frame begun but never submitted can't be using anything either
+	m_completed.store(m_frame.load(std::memory_order_relaxed), std::memory_order_release);
+
+	//deferred destructions can defer again
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_deferredMutex);
+			if (m_deferred.empty())
+				break;
+		}
+		runDeferred();
+	}
+}
+
+void FrameScheduler::printStats() const
+{
+	uint64_t frames = m_frame.load(std::memory_order_relaxed);
+	if (frames == 0)
+		return;
+
+	std::cout << "[FRAMES]: " << frames << " frames, " << m_framesInFlight << " in flight on " << (m_timeline ? "a timeline semaphore" : "fences")
+		<< ", " << m_waitMilliseconds / frames << " ms average wait for the gpu, " << m_deferredRuns << " deferred destructions, "
+		<< m_skippedFrames << " frames skipped for an out of date swap chain" << std::endl;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+class Vulkan_Backend;
+
+//paces the cpu against the gpu. frames are numbered from 1, frame n records into slot n % framesInFlight
+//and signals n on a timeline semaphore when it completes, so "is frame n done" is one counter compare.
+//devices without timeline semaphores signal a fence per slot instead. owns acquire and present, the
+//frame's semaphores and a queue of destructions that wait until every frame recorded so far completed
+class FrameScheduler {
+public:
+	FrameScheduler(Vulkan_Backend& backend, uint32_t framesInFlight);
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+	~FrameScheduler();
+
+	uint32_t framesInFlight() const { return m_framesInFlight; }
+	bool usesTimelineSemaphore() const { return m_timeline; }
+
+	//waits until the slot's previous frame completed, runs the destructions that became safe and acquires
+	//the next swap chain image. false if the swap chain is out of date, it is flagged for recreation
+	bool beginFrame();
+	//submits the frame's commands to the graphics queue once the image is acquired and presents it
+	void submit(VkCommandBuffer commandBuffer);
+
+	//slot of the frame being recorded, indexes per frame resources
+	uint32_t frameIndex() const { return m_frameIndex; }
+	uint32_t imageIndex() const { return m_imageIndex; }
+	//number of the frame being recorded, 0 before the first one. any thread
+	uint64_t currentFrame() const { return m_frame.load(std::memory_order_acquire); }
+	//every frame up to this number finished on the gpu, polls without blocking. thread driving the frames
+	uint64_t completedFrame();
+	void waitForFrame(uint64_t frame);
+
+	//runs destroy once every frame recorded so far completed, any thread
+	void defer(std::function<void()> destroy);
+	//waits for the device and runs every deferred destruction
+	void waitIdle();
+
+	void printStats() const;
+
+private:
+	struct Deferred {
+		std::function<void()> destroy;
+		uint64_t frame;
+	};
+
+	void createImageSemaphores();
+	void runDeferred();
+
+	Vulkan_Backend& m_backend;
+	uint32_t m_framesInFlight;
+	bool m_timeline;
+
+	//signaled with the frame number, timeline path only
+	VkSemaphore m_timelineSemaphore = VK_NULL_HANDLE;
+	//fence path only, signaled by the last submission of each slot
+	std::vector<VkFence> m_fences;
+	//frame each slot submitted last
+	std::vector<uint64_t> m_slotFrames;
+	//binary, waited on by the slot's submission
+	std::vector<VkSemaphore> m_imageAvailable;
+	//binary, one per swap chain image: it is only signaled again after the image was acquired again,
+	//which means the present waiting on it went through
+	std::vector<VkSemaphore> m_renderFinished;
+	//frame that last rendered to each swap chain image, more frames in flight than images have to wait for it
+	std::vector<uint64_t> m_imageFrames;
+
+	std::atomic<uint64_t> m_frame{ 0 };
+	std::atomic<uint64_t> m_completed{ 0 };
+	uint64_t m_submitted = 0;
+	uint32_t m_frameIndex = 0;
+	uint32_t m_imageIndex = 0;
+
+	std::mutex m_deferredMutex;
+	//in frame order
+	std::deque<Deferred> m_deferred;
+
+	double m_waitMilliseconds = 0.0;
+	uint64_t m_deferredRuns = 0;
+	uint64_t m_skippedFrames = 0;
+};
@@ -0,0 +1,324 @@
+#include "GeometryArena.h"
+#include "Renderer.h"
+#include "Primitives.h"
+#include "FrameScheduler.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+RangeAllocator::RangeAllocator(VkDeviceSize capacity) : m_capacity{ capacity }
+{
+	if (capacity > 0)
+		m_freeRanges[0] = capacity;
+}
+
+bool RangeAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset)
+{
+	for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+	{
+		VkDeviceSize rangeStart = it->first;
+		VkDeviceSize rangeEnd = it->first + it->second;
+		VkDeviceSize offset = alignUp(rangeStart, alignment);
+		if (offset + size > rangeEnd)
+			continue;
+
+		m_freeRanges.erase(it);
+		//the alignment gap in front and the tail stay free
+		if (offset > rangeStart)
+			m_freeRanges[rangeStart] = offset - rangeStart;
+		if (offset + size < rangeEnd)
+			m_freeRanges[offset + size] = rangeEnd - (offset + size);
+
+		m_used += size;
+		outOffset = offset;
+		return true;
+	}
+	return false;
+}
+
+void RangeAllocator::free(VkDeviceSize offset, VkDeviceSize size)
+{
+	m_used -= size;
+
+	auto next = m_freeRanges.lower_bound(offset);
+	if (next != m_freeRanges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = m_freeRanges.erase(next);
+	}
+	if (next != m_freeRanges.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+	m_freeRanges[offset] = size;
+}
+
+VkDeviceSize RangeAllocator::largestFreeRange() const
+{
+	VkDeviceSize largest = 0;
+	for (auto& range : m_freeRanges)
+		largest = std::max(largest, range.second);
+	return largest;
+}
+
+GeometryArena::GeometryArena(Vulkan_Backend& backend) : m_backend{ backend }
+{
+	for (Pool& pool : m_vertexPools)
+	{
+		pool.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		pool.initialCapacity = GEOMETRY_VERTEX_CAPACITY;
+	}
+	m_indexPool.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	m_indexPool.initialCapacity = GEOMETRY_INDEX_CAPACITY;
+}
+
+GeometryArena::~GeometryArena()
+{
+	printStats();
+
+	//relocation copies may still be reading from retired buffers
+	m_backend.m_uploader.waitAll();
+
+	if (!m_live.empty())
+	{
+		std::cout << "[GEOMETRY]: " << m_live.size() << " meshes still alive at shutdown" << std::endl;
+	}
+
+	for (auto& retired : m_retired)
+		destroyBuffer(m_backend, retired.buffer, retired.memory);
+	for (Pool& pool : m_vertexPools)
+	{
+		if (pool.buffer != VK_NULL_HANDLE)
+			destroyBuffer(m_backend, pool.buffer, pool.memory);
+	}
+	if (m_indexPool.buffer != VK_NULL_HANDLE)
+		destroyBuffer(m_backend, m_indexPool.buffer, m_indexPool.memory);
+}
+
+GeometryArena::Pool& GeometryArena::vertexPool(VertexFormat format)
+{
+	return m_vertexPools[format == VertexFormat::Packed ? 1 : 0];
+}
+
+void GeometryArena::updateDrawOffsets(GeometryRange& range)
+{
+	range.vertexOffset = static_cast<int32_t>(range.vertexByteOffset / vertexSizeOf(range.vertexFormat));
+	range.firstIndex = static_cast<uint32_t>(range.indexByteOffset / indexSizeOf(range.indexType));
+}
+
+void GeometryArena::relocate(Pool& pool, VkDeviceSize capacity)
+{
+	const bool isIndexPool = &pool == &m_indexPool;
+	UploadContext& uploader = m_backend.m_uploader;
+
+	VkBuffer buffer;
+	MemoryAllocation memory;
+	createBuffer(m_backend, capacity, pool.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+	//lowest offset first, so packing never reorders neighbours
+	std::vector<GeometryRange*> moving;
+	for (auto& range : m_live)
+	{
+		if (isIndexPool || &vertexPool(range->vertexFormat) == &pool)
+			moving.push_back(range.get());
+	}
+	std::sort(moving.begin(), moving.end(), [isIndexPool](const GeometryRange* a, const GeometryRange* b) {
+		return isIndexPool ? a->indexByteOffset < b->indexByteOffset : a->vertexByteOffset < b->vertexByteOffset;
+	});
+
+	//uploads recorded earlier may still be writing the ranges about to be copied
+	if (!moving.empty())
+		uploader.barrier();
+
+	RangeAllocator ranges(capacity);
+	for (GeometryRange* range : moving)
+	{
+		VkDeviceSize& byteOffset = isIndexPool ? range->indexByteOffset : range->vertexByteOffset;
+		VkDeviceSize bytes = isIndexPool ? range->indexBytes : range->vertexBytes;
+		VkDeviceSize alignment = isIndexPool ? indexSizeOf(range->indexType) : vertexSizeOf(range->vertexFormat);
+
+		VkDeviceSize newOffset;
+		if (!ranges.allocate(bytes, alignment, newOffset))
+		{
+			throw std::runtime_error("geometry arena relocation target too small");
+		}
+		uploader.copyBuffer(pool.buffer, buffer, bytes, byteOffset, newOffset);
+		byteOffset = newOffset;
+		updateDrawOffsets(*range);
+	}
+
+	//ranges freed but not recycled yet only exist in the old buffer, frames still reading them use that one
+	m_pendingFrees.erase(std::remove_if(m_pendingFrees.begin(), m_pendingFrees.end(),
+		[&pool](const PendingFree& pending) { return pending.pool == &pool; }), m_pendingFrees.end());
+
+	if (pool.buffer != VK_NULL_HANDLE)
+	{
+		m_retired.push_back({ pool.buffer, pool.memory, m_backend.m_frames->currentFrame(), uploader.currentToken() });
+		m_relocations++;
+	}
+
+	pool.buffer = buffer;
+	pool.memory = memory;
+	pool.ranges = std::move(ranges);
+	m_generation++;
+}
+
+VkDeviceSize GeometryArena::allocateIn(Pool& pool, VkDeviceSize size, VkDeviceSize alignment)
+{
+	if (pool.buffer == VK_NULL_HANDLE)
+		relocate(pool, std::max(pool.initialCapacity, alignUp(size, alignment)));
+
+	VkDeviceSize offset;
+	if (pool.ranges.allocate(size, alignment, offset))
+		return offset;
+
+	//compacting alone is enough if the live data leaves room, otherwise grow while at it
+	VkDeviceSize pendingBytes = 0;
+	for (auto& pending : m_pendingFrees)
+	{
+		if (pending.pool == &pool) pendingBytes += pending.size;
+	}
+	VkDeviceSize liveBytes = pool.ranges.usedSize() - pendingBytes;
+	//every packed range can lose up to one alignment to padding
+	VkDeviceSize needed = liveBytes + size + alignment * (m_live.size() + 1);
+
+	VkDeviceSize capacity = pool.ranges.capacity();
+	while (capacity < needed)
+		capacity *= 2;
+
+	relocate(pool, capacity);
+	if (!pool.ranges.allocate(size, alignment, offset))
+	{
+		throw std::runtime_error("failed to allocate from the geometry arena");
+	}
+	return offset;
+}
+
+GeometryRange* GeometryArena::allocate(VertexFormat format, const void* vertexData, uint32_t vertexCount,
+	VkIndexType indexType, const void* indexData, uint32_t indexCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto range = std::make_unique<GeometryRange>();
+	range->vertexFormat = format;
+	range->indexType = indexType;
+	range->vertexCount = vertexCount;
+	range->indexCount = indexCount;
+
+	const uint32_t vertexSize = vertexSizeOf(format);
+	const uint32_t indexSize = indexSizeOf(indexType);
+	range->vertexBytes = static_cast<VkDeviceSize>(vertexSize) * vertexCount;
+	range->indexBytes = static_cast<VkDeviceSize>(indexSize) * indexCount;
+	range->vertexByteOffset = allocateIn(vertexPool(format), range->vertexBytes, vertexSize);
+	range->indexByteOffset = allocateIn(m_indexPool, range->indexBytes, indexSize);
+	updateDrawOffsets(*range);
+
+	m_backend.m_uploader.uploadBuffer(vertexPool(format).buffer, range->vertexByteOffset, vertexData, range->vertexBytes);
+	m_backend.m_uploader.uploadBuffer(m_indexPool.buffer, range->indexByteOffset, indexData, range->indexBytes);
+
+	range->slot = m_live.size();
+	m_live.push_back(std::move(range));
+	return m_live.back().get();
+}
+
+void GeometryArena::free(GeometryRange* range)
+{
+	if (range == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_pendingFrees.push_back({ &vertexPool(range->vertexFormat), range->vertexByteOffset, range->vertexBytes, m_backend.m_frames->currentFrame() });
+	m_pendingFrees.push_back({ &m_indexPool, range->indexByteOffset, range->indexBytes, m_backend.m_frames->currentFrame() });
+
+	size_t slot = range->slot;
+	std::swap(m_live[slot], m_live.back());
+	m_live[slot]->slot = slot;
+	m_live.pop_back();
+}
+
+void GeometryArena::bind(VkCommandBuffer commandBuffer, VertexFormat format, VkIndexType indexType) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Pool& pool = m_vertexPools[format == VertexFormat::Packed ? 1 : 0];
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &pool.buffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, m_indexPool.buffer, 0, indexType);
+}
+
+void GeometryArena::compact()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (Pool& pool : m_vertexPools)
+	{
+		if (pool.buffer != VK_NULL_HANDLE)
+			relocate(pool, pool.ranges.capacity());
+	}
+	if (m_indexPool.buffer != VK_NULL_HANDLE)
+		relocate(m_indexPool, m_indexPool.ranges.capacity());
+}
+
+void GeometryArena::endFrame()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint64_t completed = m_backend.m_frames->completedFrame();
+	auto expired = [completed](uint64_t frame) { return frame <= completed; };
+
+	for (auto it = m_pendingFrees.begin(); it != m_pendingFrees.end();)
+	{
+		if (expired(it->frame))
+		{
+			it->pool->ranges.free(it->offset, it->size);
+			it = m_pendingFrees.erase(it);
+		}
+		else ++it;
+	}
+
+	for (auto it = m_retired.begin(); it != m_retired.end();)
+	{
+		if (expired(it->frame) && m_backend.m_uploader.isComplete(it->token))
+		{
+			destroyBuffer(m_backend, it->buffer, it->memory);
+			it = m_retired.erase(it);
+		}
+		else ++it;
+	}
+}
+
+uint32_t GeometryArena::generation() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_generation;
+}
+
+void GeometryArena::printStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto printPool = [](const char* name, const Pool& pool) {
+		if (pool.buffer == VK_NULL_HANDLE)
+			return;
+		std::cout << "\t" << name << ": used " << pool.ranges.usedSize() / 1024 << " KB of " << pool.ranges.capacity() / 1024
+			<< " KB, largest free range " << pool.ranges.largestFreeRange() / 1024 << " KB" << std::endl;
+	};
+
+	std::cout << "[GEOMETRY]: " << m_live.size() << " meshes, " << m_relocations << " relocations" << std::endl;
+	printPool("vertices", m_vertexPools[0]);
+	printPool("packed vertices", m_vertexPools[1]);
+	printPool("indices", m_indexPool);
+}
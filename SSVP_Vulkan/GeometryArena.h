@@ -0,0 +1,123 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "MemoryAllocator.h"
+#include "UploadContext.h"
+
+class Vulkan_Backend;
+enum class VertexFormat;
+
+//first fit over [0, capacity), neighbouring free ranges are merged on free. no vulkan calls in here
+class RangeAllocator {
+public:
+	explicit RangeAllocator(VkDeviceSize capacity = 0);
+
+	//alignment does not need to be a power of two, vertex ranges align to the vertex stride
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset);
+	void free(VkDeviceSize offset, VkDeviceSize size);
+
+	VkDeviceSize capacity() const { return m_capacity; }
+	VkDeviceSize usedSize() const { return m_used; }
+	VkDeviceSize largestFreeRange() const;
+
+private:
+	VkDeviceSize m_capacity;
+	VkDeviceSize m_used = 0;
+	//offset -> size
+	std::map<VkDeviceSize, VkDeviceSize> m_freeRanges;
+};
+
+//where one mesh lives in the arena. owned by the arena, offsets are rewritten in place when it relocates
+struct GeometryRange {
+	VertexFormat vertexFormat;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+
+	//what vkCmdDrawIndexed takes
+	int32_t vertexOffset = 0;
+	uint32_t firstIndex = 0;
+
+	VkDeviceSize vertexByteOffset = 0;
+	VkDeviceSize vertexBytes = 0;
+	VkDeviceSize indexByteOffset = 0;
+	VkDeviceSize indexBytes = 0;
+
+	//index in the arena's live list
+	size_t slot = 0;
+};
+
+//all mesh geometry in a few large buffers: one vertex buffer per vertex format and one index buffer
+//shared by 16 and 32 bit meshes. a whole scene draws with one vertex and one index bind per format
+//buffers grow by relocating into a bigger buffer, fragmentation is fixed the same way
+class GeometryArena {
+public:
+	GeometryArena(Vulkan_Backend& backend);
+	~GeometryArena();
+
+	//reserves space and records the uploads, drawable once the uploader's current token completed
+	GeometryRange* allocate(VertexFormat format, const void* vertexData, uint32_t vertexCount,
+		VkIndexType indexType, const void* indexData, uint32_t indexCount);
+	//the space is reused once no frame in flight can still read it
+	void free(GeometryRange* range);
+
+	void bind(VkCommandBuffer commandBuffer, VertexFormat format, VkIndexType indexType) const;
+
+	//packs the live ranges of every buffer, offsets in the GeometryRanges change
+	void compact();
+	//recycles frees and replaced buffers the frames in flight are done with, call once per frame
+	void endFrame();
+
+	//bumped whenever buffers are replaced or ranges move, prerecorded draws have to be rerecorded
+	uint32_t generation() const;
+	void printStats();
+
+private:
+	struct Pool {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation memory;
+		RangeAllocator ranges;
+		VkBufferUsageFlags usage = 0;
+		VkDeviceSize initialCapacity = 0;
+	};
+
+	struct PendingFree {
+		Pool* pool;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		//FrameScheduler frame number, reused once it completed
+		uint64_t frame;
+	};
+
+	struct RetiredBuffer {
+		VkBuffer buffer;
+		MemoryAllocation memory;
+		uint64_t frame;
+		//the relocation copies read from the old buffer until this completed
+		UploadToken token;
+	};
+
+	Pool& vertexPool(VertexFormat format);
+	VkDeviceSize allocateIn(Pool& pool, VkDeviceSize size, VkDeviceSize alignment);
+	//moves every live range of the pool, packed, into a new buffer of the given capacity
+	void relocate(Pool& pool, VkDeviceSize capacity);
+	void updateDrawOffsets(GeometryRange& range);
+
+	Vulkan_Backend& m_backend;
+	mutable std::mutex m_mutex;
+
+	Pool m_vertexPools[2];
+	Pool m_indexPool;
+
+	std::vector<std::unique_ptr<GeometryRange>> m_live;
+	std::vector<PendingFree> m_pendingFrees;
+	std::vector<RetiredBuffer> m_retired;
+
+	uint32_t m_generation = 0;
+	uint32_t m_relocations = 0;
+};
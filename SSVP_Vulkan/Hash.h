@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+//64 bit FNV-1a, used for cache keys (mesh cache, texture registry)
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+inline uint64_t hashFNV1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+inline uint64_t hashFNV1a(const std::string& str, uint64_t hash = FNV_OFFSET_BASIS)
+{
+	return hashFNV1a(str.data(), str.size(), hash);
+}
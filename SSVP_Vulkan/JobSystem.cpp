@@ -0,0 +1,337 @@
+#include "JobSystem.h"
+#include <stdexcept>
+#include <iostream>
+#include <iterator>
+
+//set on worker threads and on the thread draining the destructor, lets submit and wait find the caller's own deque
+static thread_local const JobSystem* t_jobSystem = nullptr;
+static thread_local uint32_t t_workerIndex = 0;
+
+//empty polls of a waiting thread before it goes to sleep, short jobs on other threads finish within them
+static const uint32_t WAIT_SPIN_COUNT = 64;
+
+JobSystem::JobSystem(uint32_t workerCount) : m_startTime{ std::chrono::steady_clock::now() }
+{
+	if (workerCount == 0)
+	{
+		//leave one core to the thread that submits and waits, but always have one worker so
+		//jobs nobody waits on still make progress
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 2 ? cores - 1 : 1;
+	}
+
+	m_workerCount = workerCount;
+	for (uint32_t i = 0; i < workerCount + 1; ++i)
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+
+	m_workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; ++i)
+		m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_workAvailable.notify_all();
+
+	//the destroying thread drains alongside the workers and counts as the shared slot's worker meanwhile, so the
+	//continuations it releases and the jobs those submit don't hit the shutdown check in submit
+	const JobSystem* previousSystem = t_jobSystem;
+	uint32_t previousIndex = t_workerIndex;
+	t_jobSystem = this;
+	t_workerIndex = m_workerCount;
+
+	Job job;
+	while (findJob(m_workerCount, job))
+		execute(m_workerCount, job);
+
+	//workers only leave once every deque is empty, so all submitted work runs before this returns
+	for (auto& worker : m_workers)
+		worker.join();
+
+	//nothing else runs jobs anymore, whatever is left was pushed by this thread or a worker's last job
+	while (m_queued.load() > 0)
+	{
+		if (findJob(m_workerCount, job))
+			execute(m_workerCount, job);
+	}
+
+	t_jobSystem = previousSystem;
+	t_workerIndex = previousIndex;
+
+	printStats();
+}
+
+int32_t JobSystem::currentWorker() const
+{
+	return t_jobSystem == this ? static_cast<int32_t>(t_workerIndex) : -1;
+}
+
+void JobSystem::submit(std::function<void()> fn, JobCounter* counter, JobCounter* after)
+{
+	if (m_stopping && currentWorker() < 0)
+	{
+		throw std::runtime_error("job submitted to a job system that is shutting down");
+	}
+
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	if (after)
+	{
+		//the last job of after decrements it under the same lock, so the continuation can't be missed
+		std::lock_guard<std::mutex> lock(after->m_mutex);
+		if (after->m_pending.load(std::memory_order_acquire) > 0)
+		{
+			after->m_continuations.push_back({ std::move(fn), counter });
+			return;
+		}
+	}
+
+	push({ std::move(fn), counter });
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	int32_t worker = currentWorker();
+	uint32_t queue = worker >= 0 ? static_cast<uint32_t>(worker) : m_workerCount;
+
+	Job job;
+	uint32_t spins = 0;
+	while (!counter.done())
+	{
+		//a render thread waiting on its recording jobs must not pick up a texture decode, so only workers take anything
+		bool found = worker >= 0 ? findJob(queue, job) : tryPopCounter(queue, &counter, job);
+		if (found)
+		{
+			execute(queue, job);
+			spins = 0;
+			continue;
+		}
+
+		if (++spins < WAIT_SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		spins = 0;
+
+		//finish takes m_sleepMutex after the counter reached zero, so checking under it can't miss the wakeup
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		if (worker >= 0)
+		{
+			m_waitingWorkers++;
+			m_workAvailable.wait(lock, [this, &counter] { return counter.done() || m_queued.load() > 0; });
+			m_waitingWorkers--;
+		}
+		else
+		{
+			//jobs of this counter that show up meanwhile are run by the workers
+			m_counterDone.wait(lock, [&counter] { return counter.done(); });
+		}
+	}
+
+	//the job that reached zero still holds the lock until it's done touching the counter
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_mutex);
+		std::swap(error, counter.m_error);
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void JobSystem::push(Job job)
+{
+	int32_t worker = currentWorker();
+	WorkerQueue& queue = *m_queues[worker >= 0 ? static_cast<uint32_t>(worker) : m_workerCount];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	m_queued.fetch_add(1);
+
+	//taking the lock orders the increment against a worker that is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_workAvailable.notify_one();
+}
+
+bool JobSystem::tryPop(uint32_t queue, Job& out)
+{
+	WorkerQueue& q = *m_queues[queue];
+	std::lock_guard<std::mutex> lock(q.mutex);
+	if (q.jobs.empty())
+		return false;
+
+	//the owner works lifo on its freshest (cache warm) jobs, everyone else takes the oldest
+	if (t_jobSystem == this && t_workerIndex == queue)
+	{
+		out = std::move(q.jobs.back());
+		q.jobs.pop_back();
+	}
+	else
+	{
+		out = std::move(q.jobs.front());
+		q.jobs.pop_front();
+	}
+	m_queued.fetch_sub(1);
+	return true;
+}
+
+bool JobSystem::tryPopCounter(uint32_t queue, const JobCounter* counter, Job& out)
+{
+	WorkerQueue& q = *m_queues[queue];
+	std::lock_guard<std::mutex> lock(q.mutex);
+
+	//the waiter submitted its jobs last, they sit at the back
+	for (auto it = q.jobs.rbegin(); it != q.jobs.rend(); ++it)
+	{
+		if (it->counter != counter)
+			continue;
+		out = std::move(*it);
+		q.jobs.erase(std::next(it).base());
+		m_queued.fetch_sub(1);
+		return true;
+	}
+	return false;
+}
+
+bool JobSystem::findJob(uint32_t queue, Job& out)
+{
+	const uint32_t shared = m_workerCount;
+	if (tryPop(queue, out))
+		return true;
+	if (queue != shared && tryPop(shared, out))
+		return true;
+
+	for (uint32_t i = 1; i < shared + 1; ++i)
+	{
+		uint32_t victim = (queue + i) % (shared + 1);
+		if (victim == shared)
+			continue;
+		if (tryPop(victim, out))
+		{
+			m_queues[queue]->steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(uint32_t queue, Job& job)
+{
+	auto start = std::chrono::steady_clock::now();
+	try {
+		job.fn();
+	}
+	catch (...) {
+		if (job.counter)
+		{
+			std::lock_guard<std::mutex> lock(job.counter->m_mutex);
+			if (!job.counter->m_error) job.counter->m_error = std::current_exception();
+		}
+		else
+		{
+			//nobody waits for this job, so nobody could rethrow it
+			try { throw; }
+			catch (const std::exception& e) { std::cout << "[JOBS]: unhandled exception in job: " << e.what() << std::endl; }
+			catch (...) { std::cout << "[JOBS]: unhandled exception in job" << std::endl; }
+		}
+	}
+	job.fn = nullptr;
+
+	WorkerQueue& stats = *m_queues[queue];
+	stats.busyNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+	stats.executed.fetch_add(1, std::memory_order_relaxed);
+
+	finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter* counter)
+{
+	if (!counter)
+		return;
+
+	std::vector<JobCounter::Continuation> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+		continuations.swap(counter->m_continuations);
+	}
+
+	//the counter may be gone from here on, a waiter can return as soon as the lock is released
+	for (auto& continuation : continuations)
+		push({ std::move(continuation.fn), continuation.counter });
+
+	bool wakeWorkers;
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		wakeWorkers = m_waitingWorkers > 0;
+	}
+	m_counterDone.notify_all();
+	//idle workers would go straight back to sleep, only wake them when a waiting one is among them
+	if (wakeWorkers)
+		m_workAvailable.notify_all();
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+	t_jobSystem = this;
+	t_workerIndex = index;
+
+	Job job;
+	for (;;)
+	{
+		if (findJob(index, job))
+		{
+			execute(index, job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_workAvailable.wait(lock, [this] { return m_queued.load() > 0 || m_stopping; });
+		if (m_stopping && m_queued.load() == 0)
+			return;
+	}
+}
+
+std::vector<JobWorkerStats> JobSystem::getStats() const
+{
+	double lifetime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_startTime).count();
+
+	std::vector<JobWorkerStats> stats;
+	stats.reserve(m_queues.size());
+	for (auto& queue : m_queues)
+	{
+		JobWorkerStats worker;
+		worker.jobs = queue->executed.load(std::memory_order_relaxed);
+		worker.steals = queue->steals.load(std::memory_order_relaxed);
+		worker.utilization = lifetime > 0.0 ? queue->busyNanoseconds.load(std::memory_order_relaxed) / lifetime : 0.0;
+		stats.push_back(worker);
+	}
+	return stats;
+}
+
+void JobSystem::printStats() const
+{
+	std::vector<JobWorkerStats> stats = getStats();
+	uint64_t jobs = 0, steals = 0;
+	for (auto& worker : stats)
+	{
+		jobs += worker.jobs;
+		steals += worker.steals;
+	}
+
+	std::cout << "[JOBS]: " << m_workerCount << " workers, " << jobs << " jobs, " << steals << " steals" << std::endl;
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		std::cout << "\t" << (i < m_workerCount ? "worker " + std::to_string(i) : std::string("waiting threads"))
+			<< ": " << stats[i].jobs << " jobs, " << stats[i].steals << " steals, " << stats[i].utilization * 100.0 << "% busy" << std::endl;
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <chrono>
+
+class JobSystem;
+
+//counts unfinished jobs, jobs can be submitted to start only once a counter reached zero
+//a counter has to outlive every job that signals it or waits on it
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Continuation {
+		std::function<void()> fn;
+		JobCounter* counter;
+	};
+
+	std::atomic<uint32_t> m_pending{ 0 };
+	std::mutex m_mutex;
+	//jobs waiting for this counter to reach zero
+	std::vector<Continuation> m_continuations;
+	//first exception thrown by a job signalling this counter, rethrown by JobSystem::wait
+	std::exception_ptr m_error;
+};
+
+struct JobWorkerStats {
+	uint64_t jobs;
+	//jobs taken from another worker's deque
+	uint64_t steals;
+	//fraction of the worker's lifetime spent running jobs
+	double utilization;
+};
+
+//work stealing scheduler, one deque per worker plus one shared by every thread that isn't a worker
+//workers push and pop their own deque from the back and steal from the front of the others
+//a worker that waits on a counter runs any job meanwhile, so waiting inside a job never deadlocks. any other
+//thread only runs the jobs of the counter it waits on, the workers take care of the rest
+//shutdown is deterministic: the destructor runs every job submitted so far, including continuations
+//and jobs those submit, before joining the workers
+class JobSystem {
+public:
+	//0 picks hardware_concurrency - 1, the thread that waits helps out
+	explicit JobSystem(uint32_t workerCount = 0);
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem();
+
+	//counter is incremented now and decremented once the job finished
+	//with after set the job only starts once after reached zero
+	void submit(std::function<void()> fn, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+
+	//runs jobs until counter reached zero, then rethrows the first exception of its jobs.
+	//spins for a while once there is nothing to run, then sleeps until the counter is done or new work arrives
+	void wait(JobCounter& counter);
+
+	//fn(i) for i in [0, count), in batches of at least minBatch. blocks until all ran, rethrows the first exception
+	template<typename F>
+	void parallelFor(size_t count, F&& fn, size_t minBatch = 1);
+
+	uint32_t workerCount() const { return m_workerCount; }
+	//worker index of the calling thread, workerCount() for the thread draining the destructor, -1 for any other thread
+	int32_t currentWorker() const;
+
+	//one entry per worker, then one for the jobs run by waiting threads
+	std::vector<JobWorkerStats> getStats() const;
+	void printStats() const;
+
+private:
+	struct Job {
+		std::function<void()> fn;
+		JobCounter* counter;
+	};
+
+	struct alignas(64) WorkerQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+
+		std::atomic<uint64_t> executed{ 0 };
+		std::atomic<uint64_t> steals{ 0 };
+		std::atomic<uint64_t> busyNanoseconds{ 0 };
+	};
+
+	void push(Job job);
+	bool tryPop(uint32_t queue, Job& out);
+	//newest job of queue that signals counter
+	bool tryPopCounter(uint32_t queue, const JobCounter* counter, Job& out);
+	//own deque, then the shared one, then the others. queue is the caller's own deque
+	bool findJob(uint32_t queue, Job& out);
+	void execute(uint32_t queue, Job& job);
+	void finish(JobCounter* counter);
+	void workerLoop(uint32_t index);
+
+	//fixed before the first worker starts, m_workers itself is still growing while they run
+	uint32_t m_workerCount = 0;
+	std::vector<std::thread> m_workers;
+	//m_workerCount + 1 entries, the last one is shared by non worker threads
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+
+	//jobs sitting in any deque, workers sleep while it is zero
+	std::atomic<uint64_t> m_queued{ 0 };
+	std::mutex m_sleepMutex;
+	std::condition_variable m_workAvailable;
+	//signalled whenever a counter reaches zero, non worker threads sleep on it in wait
+	std::condition_variable m_counterDone;
+	//workers sleeping in wait, they sleep on m_workAvailable and need waking when a counter reaches zero too.
+	//guarded by m_sleepMutex
+	uint32_t m_waitingWorkers = 0;
+	std::atomic<bool> m_stopping{ false };
+
+	std::chrono::steady_clock::time_point m_startTime;
+};
+
+template<typename F>
+void JobSystem::parallelFor(size_t count, F&& fn, size_t minBatch)
+{
+	if (count == 0)
+		return;
+
+	//a few batches per thread leaves room for stealing when the items differ in cost
+	size_t threads = m_workerCount + 1;
+	size_t batch = std::max<size_t>(std::max<size_t>(minBatch, 1), (count + threads * 4 - 1) / (threads * 4));
+	if (batch >= count)
+	{
+		for (size_t i = 0; i < count; ++i) fn(i);
+		return;
+	}
+
+	JobCounter counter;
+	for (size_t begin = 0; begin < count; begin += batch)
+	{
+		size_t end = std::min(count, begin + batch);
+		submit([&fn, begin, end]() {
+			for (size_t i = begin; i < end; ++i) fn(i);
+		}, &counter);
+	}
+	wait(counter);
+}
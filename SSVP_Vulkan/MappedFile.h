@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+//read only memory mapping of a whole file, unmapped on close or destruction
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool open(const std::string& path);
+	void close();
+
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool isOpen() const { return m_data != nullptr; }
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
@@ -0,0 +1,418 @@
+#include "MaterialTable.h"
+#include "TextureRegistry.h"
+#include "AssetUtilities.h"
+#include "FrameScheduler.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+MaterialTable::MaterialTable(Vulkan_Backend& backend) : m_backend{ backend }
+{
+	m_bindless = backend.m_descriptorIndexing;
+
+	if (m_bindless)
+	{
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(backend.m_physicalDevice, &properties);
+
+		//a combined image sampler counts against the sampler and the sampled image limits
+		m_textureCapacity = std::min({ BINDLESS_TEXTURE_CAPACITY,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+	}
+	else
+	{
+		//the shaders declare the fallback array with a fixed size, it can't shrink to fit the device
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(backend.m_physicalDevice, &properties);
+		if (properties.limits.maxPerStageDescriptorSamplers < BINDLESS_FALLBACK_TEXTURE_CAPACITY ||
+			properties.limits.maxPerStageDescriptorSampledImages < BINDLESS_FALLBACK_TEXTURE_CAPACITY)
+		{
+			throw std::runtime_error("device can't bind the material texture array");
+		}
+		m_textureCapacity = BINDLESS_FALLBACK_TEXTURE_CAPACITY;
+	}
+
+	//1x1 white, stands in for every texture that isn't resident yet
+	Vulkan_Backend* owner = &backend;
+	m_placeholder = TextureHandle(new Texture(), [owner](Texture* texture) {
+		texture->destroyTexture(*owner);
+		delete texture;
+	});
+	m_placeholder->type = "placeholder";
+	m_placeholder->createFromPixels(backend, nullptr, 0, 0);
+	backend.m_uploader.wait(m_placeholder->uploadToken);
+
+	TextureSlot placeholderSlot;
+	placeholderSlot.texture = m_placeholder;
+	placeholderSlot.users = 1;
+	placeholderSlot.written = true;
+	m_slots.push_back(placeholderSlot);
+	m_slotOf[m_placeholder.get()] = PLACEHOLDER_SLOT;
+
+	createLayout();
+	createSets();
+}
+
+MaterialTable::~MaterialTable()
+{
+	printStats();
+
+	for (size_t i = 0; i < m_recordBuffers.size(); ++i)
+		destroyBuffer(m_backend, m_recordBuffers[i], m_recordMemory[i]);
+
+	vkDestroyDescriptorPool(m_backend.m_device, m_pool, nullptr);
+	vkDestroyDescriptorSetLayout(m_backend.m_device, m_layout, nullptr);
+
+	//last references to the textures, the registry destroys them
+	m_retiredTextures.clear();
+	m_slots.clear();
+	m_placeholder.reset();
+}
+
+void MaterialTable::createLayout()
+{
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = m_textureCapacity;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+	//the records are written once per set, only the texture array changes after binding
+	std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags{};
+	bindingFlags[0] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo{};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	flagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+	if (m_bindless)
+	{
+		layoutInfo.pNext = &flagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	}
+
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_backend.m_device, &layoutInfo, nullptr, &m_layout),
+		"failed to create material descriptor set layout");
+}
+
+void MaterialTable::createSets()
+{
+	uint32_t frames = m_backend.m_framesInFlight;
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = m_textureCapacity * frames;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = frames;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = m_bindless ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = frames;
+
+	VK_CHECK_RESULT(vkCreateDescriptorPool(m_backend.m_device, &poolInfo, nullptr, &m_pool), "failed to create material descriptor pool");
+
+	std::vector<VkDescriptorSetLayout> layouts(frames, m_layout);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_pool;
+	allocInfo.descriptorSetCount = frames;
+	allocInfo.pSetLayouts = layouts.data();
+
+	m_sets.resize(frames);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(m_backend.m_device, &allocInfo, m_sets.data()), "failed to allocate material descriptor sets");
+
+	m_recordBuffers.resize(frames);
+	m_recordMemory.resize(frames);
+	m_recordsDirty.assign(frames, true);
+	m_writeCursor.assign(frames, 0);
+
+	//a partially bound array only needs the placeholder, a fully bound one needs every element valid
+	uint32_t initialSlots = m_bindless ? 1 : m_textureCapacity;
+	std::vector<PendingWrite> placeholderWrites(initialSlots);
+	for (uint32_t slot = 0; slot < initialSlots; ++slot)
+		placeholderWrites[slot] = { slot, m_placeholder->imgDescriptor };
+
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		createBuffer(m_backend, MATERIAL_CAPACITY * sizeof(MaterialRecord), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_recordBuffers[frame], m_recordMemory[frame]);
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = m_recordBuffers[frame];
+		bufferInfo.offset = 0;
+		bufferInfo.range = MATERIAL_CAPACITY * sizeof(MaterialRecord);
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = m_sets[frame];
+		write.dstBinding = 1;
+		write.dstArrayElement = 0;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(m_backend.m_device, 1, &write, 0, nullptr);
+
+		writeTextures(m_sets[frame], placeholderWrites.data(), placeholderWrites.size());
+	}
+}
+
+MaterialId MaterialTable::add(const Material& material)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	MaterialId id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		if (m_entries.size() >= MATERIAL_CAPACITY)
+			throw std::runtime_error("material table is full");
+		id = static_cast<MaterialId>(m_entries.size());
+		m_entries.emplace_back();
+	}
+
+	Entry& entry = m_entries[id];
+	entry = Entry{};
+	entry.live = true;
+	entry.diffuseSlot = material.diffuse ? acquireSlot(material.diffuse) : PLACEHOLDER_SLOT;
+	entry.record.diffuseTexture = m_slots[entry.diffuseSlot].written ? entry.diffuseSlot : PLACEHOLDER_SLOT;
+
+	std::fill(m_recordsDirty.begin(), m_recordsDirty.end(), true);
+	return id;
+}
+
+void MaterialTable::release(MaterialId id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pendingReleases.push_back({ id, m_backend.m_frames->currentFrame() });
+}
+
+uint32_t MaterialTable::acquireSlot(const TextureHandle& texture)
+{
+	auto known = m_slotOf.find(texture.get());
+	if (known != m_slotOf.end())
+	{
+		m_slots[known->second].users++;
+		return known->second;
+	}
+
+	uint32_t slot;
+	if (!m_freeSlots.empty())
+	{
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else if (m_slots.size() < m_textureCapacity)
+	{
+		slot = static_cast<uint32_t>(m_slots.size());
+		m_slots.emplace_back();
+	}
+	else
+	{
+		if (!m_capacityWarned)
+		{
+			std::cout << "[MATERIALS]: texture array full (" << m_textureCapacity << " slots), further textures show the placeholder" << std::endl;
+			m_capacityWarned = true;
+		}
+		m_slots[PLACEHOLDER_SLOT].users++;
+		return PLACEHOLDER_SLOT;
+	}
+
+	TextureSlot& textureSlot = m_slots[slot];
+	textureSlot.texture = texture;
+	textureSlot.users = 1;
+	textureSlot.written = false;
+	m_slotOf[texture.get()] = slot;
+	m_loading.push_back(slot);
+	return slot;
+}
+
+void MaterialTable::releaseSlot(uint32_t slot)
+{
+	TextureSlot& textureSlot = m_slots[slot];
+	if (--textureSlot.users > 0 || slot == PLACEHOLDER_SLOT)
+		return;
+
+	m_slotOf.erase(textureSlot.texture.get());
+	if (textureSlot.written)
+	{
+		//a fully bound array must not keep pointing at a destroyed view
+		if (!m_bindless)
+			m_writes.push_back({ slot, m_placeholder->imgDescriptor });
+	}
+	else
+	{
+		m_loading.erase(std::remove(m_loading.begin(), m_loading.end(), slot), m_loading.end());
+	}
+
+	m_retiredTextures.push_back({ std::move(textureSlot.texture), m_backend.m_frames->currentFrame() });
+	textureSlot = TextureSlot{};
+	m_freeSlots.push_back(slot);
+}
+
+void MaterialTable::beginFrame(uint32_t frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint64_t completed = m_backend.m_frames->completedFrame();
+	auto expired = [completed](uint64_t released) { return released <= completed; };
+
+	for (auto it = m_pendingReleases.begin(); it != m_pendingReleases.end();)
+	{
+		if (expired(it->frame))
+		{
+			Entry& entry = m_entries[it->id];
+			entry.live = false;
+			releaseSlot(entry.diffuseSlot);
+			m_freeIds.push_back(it->id);
+			it = m_pendingReleases.erase(it);
+		}
+		else ++it;
+	}
+
+	//every set was rewritten (or is partially bound) and no frame reading the old one is in flight anymore
+	m_retiredTextures.erase(std::remove_if(m_retiredTextures.begin(), m_retiredTextures.end(),
+		[&expired](const RetiredTexture& retired) { return expired(retired.frame); }), m_retiredTextures.end());
+
+	std::vector<PendingWrite> resident;
+	for (auto it = m_loading.begin(); it != m_loading.end();)
+	{
+		TextureSlot& textureSlot = m_slots[*it];
+		if (m_backend.m_textureRegistry->isResident(textureSlot.texture))
+		{
+			textureSlot.written = true;
+			resident.push_back({ *it, textureSlot.texture->imgDescriptor });
+			it = m_loading.erase(it);
+		}
+		else ++it;
+	}
+
+	if (!resident.empty())
+	{
+		//the slots are new to every set, so frames in flight never read them
+		if (m_bindless)
+		{
+			for (VkDescriptorSet set : m_sets)
+				writeTextures(set, resident.data(), resident.size());
+		}
+		else
+		{
+			m_writes.insert(m_writes.end(), resident.begin(), resident.end());
+		}
+
+		//records switch from the placeholder to the texture, each frame's copy as that frame begins
+		for (Entry& entry : m_entries)
+		{
+			if (entry.live && m_slots[entry.diffuseSlot].written)
+				entry.record.diffuseTexture = entry.diffuseSlot;
+		}
+		std::fill(m_recordsDirty.begin(), m_recordsDirty.end(), true);
+	}
+
+	if (!m_bindless && m_writeCursor[frame] < m_writes.size())
+	{
+		writeTextures(m_sets[frame], m_writes.data() + m_writeCursor[frame], m_writes.size() - m_writeCursor[frame]);
+		m_writeCursor[frame] = m_writes.size();
+
+		if (std::all_of(m_writeCursor.begin(), m_writeCursor.end(), [this](size_t cursor) { return cursor == m_writes.size(); }))
+		{
+			m_writes.clear();
+			std::fill(m_writeCursor.begin(), m_writeCursor.end(), 0);
+		}
+	}
+
+	if (m_recordsDirty[frame])
+	{
+		//record memory is host coherent and stays mapped
+		MaterialRecord* records = static_cast<MaterialRecord*>(m_recordMemory[frame].mapped);
+		for (size_t id = 0; id < m_entries.size(); ++id)
+			records[id] = m_entries[id].record;
+		m_recordsDirty[frame] = false;
+	}
+}
+
+void MaterialTable::writeTextures(VkDescriptorSet set, const PendingWrite* writes, size_t count)
+{
+	if (count == 0)
+		return;
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		VkWriteDescriptorSet& write = descriptorWrites[i];
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = 0;
+		write.dstArrayElement = writes[i].slot;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &writes[i].image;
+	}
+	vkUpdateDescriptorSets(m_backend.m_device, static_cast<uint32_t>(count), descriptorWrites.data(), 0, nullptr);
+	m_descriptorWrites += count;
+}
+
+void MaterialTable::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frame) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &m_sets[frame], 0, nullptr);
+}
+
+void MaterialTable::pushMaterial(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, MaterialId id)
+{
+	VkPushConstantRange range = pushConstantRange();
+	vkCmdPushConstants(commandBuffer, pipelineLayout, range.stageFlags, range.offset, range.size, &id);
+}
+
+VkPushConstantRange MaterialTable::pushConstantRange()
+{
+	VkPushConstantRange range{};
+	range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	range.offset = 0;
+	range.size = sizeof(MaterialId);
+	return range;
+}
+
+MaterialTableStats MaterialTable::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	MaterialTableStats stats;
+	stats.materials = static_cast<uint32_t>(std::count_if(m_entries.begin(), m_entries.end(), [](const Entry& entry) { return entry.live; }));
+	stats.textures = static_cast<uint32_t>(m_slots.size() - m_freeSlots.size());
+	stats.textureCapacity = m_textureCapacity;
+	stats.descriptorWrites = m_descriptorWrites;
+	return stats;
+}
+
+void MaterialTable::printStats()
+{
+	MaterialTableStats stats = getStats();
+	std::cout << "[MATERIALS]: " << (m_bindless ? "descriptor indexing" : "fixed texture array") << ", " << stats.materials << " materials, "
+		<< stats.textures << "/" << stats.textureCapacity << " texture slots, " << stats.descriptorWrites << " descriptor writes" << std::endl;
+}
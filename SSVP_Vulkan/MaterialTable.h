@@ -0,0 +1,129 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "Primitives.h"
+
+//gpu side of a material, std430 layout of MaterialRecord in shaders/bindless.glsl
+struct MaterialRecord {
+	//index into the texture array, the white placeholder until the texture is resident
+	uint32_t diffuseTexture = 0;
+	uint32_t padding[3] = {};
+};
+
+struct MaterialTableStats {
+	uint32_t materials = 0;
+	//placeholder included
+	uint32_t textures = 0;
+	uint32_t textureCapacity = 0;
+	uint64_t descriptorWrites = 0;
+};
+
+//every material of the backend behind one descriptor set layout: binding 0 is an array of combined image
+//samplers with all material textures, binding 1 a storage buffer of MaterialRecords indexed by material id.
+//a pass binds the set once per command buffer, draws only push their material id (pushMaterial).
+//with VK_EXT_descriptor_indexing the array is large and partially bound, a texture is written to every
+//frame's set as soon as it is resident, update after bind makes that legal for slots no frame in flight uses.
+//without it the array is small and fully bound (unused slots show the placeholder), and a frame's set is
+//only written once the FrameScheduler waited for that frame slot
+class MaterialTable {
+public:
+	explicit MaterialTable(Vulkan_Backend& backend);
+	~MaterialTable();
+	MaterialTable(const MaterialTable&) = delete;
+	MaterialTable& operator=(const MaterialTable&) = delete;
+
+	//never blocks, textures still loading show the placeholder until they are resident
+	MaterialId add(const Material& material);
+	//the id and texture slots nobody else uses are recycled once no frame in flight can read them
+	void release(MaterialId id);
+
+	//picks up textures that became resident and brings the frame's set and records up to date.
+	//call once per frame, after the FrameScheduler began the frame
+	void beginFrame(uint32_t frame);
+
+	void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frame) const;
+	//material id as a push constant, pipeline layouts add pushConstantRange
+	static void pushMaterial(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, MaterialId id);
+	static VkPushConstantRange pushConstantRange();
+
+	VkDescriptorSetLayout layout() const { return m_layout; }
+	bool bindless() const { return m_bindless; }
+
+	MaterialTableStats getStats();
+	void printStats();
+
+	//slot of the white placeholder texture
+	static const uint32_t PLACEHOLDER_SLOT = 0;
+
+private:
+	struct TextureSlot {
+		TextureHandle texture;
+		uint32_t users = 0;
+		//the array points at the texture, otherwise records using it still show the placeholder
+		bool written = false;
+	};
+
+	struct Entry {
+		MaterialRecord record;
+		uint32_t diffuseSlot = PLACEHOLDER_SLOT;
+		bool live = false;
+	};
+
+	struct PendingWrite {
+		uint32_t slot;
+		VkDescriptorImageInfo image;
+	};
+
+	struct PendingRelease {
+		MaterialId id;
+		//FrameScheduler frame number, recycled once it completed
+		uint64_t frame;
+	};
+
+	//a released slot's texture, sets of frames in flight may still point at it
+	struct RetiredTexture {
+		TextureHandle texture;
+		uint64_t frame;
+	};
+
+	void createLayout();
+	void createSets();
+	uint32_t acquireSlot(const TextureHandle& texture);
+	void releaseSlot(uint32_t slot);
+	void writeTextures(VkDescriptorSet set, const PendingWrite* writes, size_t count);
+
+	Vulkan_Backend& m_backend;
+	bool m_bindless = false;
+	uint32_t m_textureCapacity = 0;
+
+	VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+	VkDescriptorPool m_pool = VK_NULL_HANDLE;
+	//one per frame in flight, each with its own record buffer
+	std::vector<VkDescriptorSet> m_sets;
+	std::vector<VkBuffer> m_recordBuffers;
+	std::vector<MemoryAllocation> m_recordMemory;
+	std::vector<bool> m_recordsDirty;
+
+	TextureHandle m_placeholder;
+
+	std::mutex m_mutex;
+	std::vector<Entry> m_entries;
+	std::vector<MaterialId> m_freeIds;
+	std::vector<TextureSlot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+	std::unordered_map<const Texture*, uint32_t> m_slotOf;
+	//slots whose texture isn't resident yet
+	std::vector<uint32_t> m_loading;
+	//fallback only: written to a frame's set when that frame begins, m_writeCursor is how far each set got
+	std::vector<PendingWrite> m_writes;
+	std::vector<size_t> m_writeCursor;
+	std::vector<PendingRelease> m_pendingReleases;
+	std::vector<RetiredTexture> m_retiredTextures;
+
+	uint64_t m_descriptorWrites = 0;
+	bool m_capacityWarned = false;
+};
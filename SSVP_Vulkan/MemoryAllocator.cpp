@@ -0,0 +1,351 @@
+#include "MemoryAllocator.h"
+#include "Renderer.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+static VkDeviceSize roundUpPow2(VkDeviceSize v)
+{
+	VkDeviceSize p = 1;
+	while (p < v) p <<= 1;
+	return p;
+}
+
+static VkDeviceSize roundDownPow2(VkDeviceSize v)
+{
+	VkDeviceSize p = 1;
+	while ((p << 1) <= v) p <<= 1;
+	return p;
+}
+
+BuddyAllocator::BuddyAllocator(VkDeviceSize size, VkDeviceSize minNodeSize)
+	: m_size{ roundUpPow2(size) }, m_minNodeSize{ roundUpPow2(minNodeSize) }
+{
+	m_levelCount = 1;
+	while ((m_size >> m_levelCount) >= m_minNodeSize) m_levelCount++;
+
+	m_freeLists.resize(m_levelCount);
+	m_freeLists[0].insert(0);
+}
+
+uint32_t BuddyAllocator::levelForSize(VkDeviceSize size) const
+{
+	uint32_t level = m_levelCount - 1;
+	while (level > 0 && nodeSizeAt(level) < size) level--;
+	return level;
+}
+
+bool BuddyAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset, VkDeviceSize& outNodeSize)
+{
+	VkDeviceSize needed = std::max(std::max(size, alignment), m_minNodeSize);
+	if (needed > m_size)
+		return false;
+
+	uint32_t level = levelForSize(needed);
+
+	//find the smallest free node that fits, walking towards the root
+	int32_t found = static_cast<int32_t>(level);
+	while (found >= 0 && m_freeLists[found].empty()) found--;
+	if (found < 0)
+		return false;
+
+	//lowest offset first keeps the upper part of the block free for big requests
+	VkDeviceSize offset = *m_freeLists[found].begin();
+	m_freeLists[found].erase(m_freeLists[found].begin());
+
+	//split down to the requested level, right halves go to the free lists
+	for (uint32_t l = static_cast<uint32_t>(found) + 1; l <= level; ++l)
+	{
+		m_freeLists[l].insert(offset + nodeSizeAt(l));
+	}
+
+	outOffset = offset;
+	outNodeSize = nodeSizeAt(level);
+	m_used += outNodeSize;
+	return true;
+}
+
+void BuddyAllocator::free(VkDeviceSize offset, VkDeviceSize nodeSize)
+{
+	uint32_t level = levelForSize(nodeSize);
+	m_used -= nodeSize;
+
+	//merge with the buddy as long as it is free
+	while (level > 0)
+	{
+		VkDeviceSize buddy = offset ^ nodeSizeAt(level);
+		auto it = m_freeLists[level].find(buddy);
+		if (it == m_freeLists[level].end())
+			break;
+
+		m_freeLists[level].erase(it);
+		offset = std::min(offset, buddy);
+		level--;
+	}
+
+	m_freeLists[level].insert(offset);
+}
+
+VkDeviceSize BuddyAllocator::largestFreeNode() const
+{
+	for (uint32_t l = 0; l < m_levelCount; ++l)
+	{
+		if (!m_freeLists[l].empty())
+			return nodeSizeAt(l);
+	}
+	return 0;
+}
+
+void DeviceMemoryAllocator::init(Vulkan_Backend& backend)
+{
+	init(backend.m_device, backend.m_physicalDevice);
+}
+
+void DeviceMemoryAllocator::init(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+	m_device = device;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memProperties);
+
+	m_pools.resize(m_memProperties.memoryTypeCount * 2);
+}
+
+void DeviceMemoryAllocator::cleanUp()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_allocationCount > 0)
+	{
+		std::cout << "[ALLOCATOR]: " << m_allocationCount << " allocations still alive at shutdown" << std::endl;
+	}
+
+	for (auto& pool : m_pools)
+	{
+		for (auto& block : pool)
+		{
+			vkFreeMemory(m_device, block->memory, nullptr);
+		}
+		pool.clear();
+	}
+}
+
+VkDeviceSize DeviceMemoryAllocator::blockSizeFor(uint32_t memoryType) const
+{
+	VkDeviceSize heapSize = m_memProperties.memoryHeaps[m_memProperties.memoryTypes[memoryType].heapIndex].size;
+	return std::min(MAX_BLOCK_SIZE, roundDownPow2(std::max<VkDeviceSize>(heapSize / 8, MIN_NODE_SIZE)));
+}
+
+VkDeviceMemory DeviceMemoryAllocator::allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** outMapped)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+
+	*outMapped = nullptr;
+	//non coherent memory would need vkFlushMappedMemoryRanges after every write, it is never mapped.
+	//it can still be picked for device local requests on unified memory, the host just doesn't touch it
+	VkMemoryPropertyFlags mappable = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if ((m_memProperties.memoryTypes[memoryType].propertyFlags & mappable) == mappable)
+	{
+		//sub-allocations can't map individually, so the whole block is mapped once
+		if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, outMapped) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+
+	return memory;
+}
+
+MemoryBlock* DeviceMemoryAllocator::createBlock(uint32_t memoryType, bool linear, VkDeviceSize size)
+{
+	auto block = std::make_unique<MemoryBlock>();
+	block->memoryType = memoryType;
+	block->linear = linear;
+	block->memory = allocateDeviceMemory(memoryType, size, &block->mapped);
+	block->buddy = std::make_unique<BuddyAllocator>(size, MIN_NODE_SIZE);
+
+	auto& pool = m_pools[memoryType * 2 + (linear ? 0 : 1)];
+	pool.push_back(std::move(block));
+	return pool.back().get();
+}
+
+void DeviceMemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+	auto& pool = m_pools[block->memoryType * 2 + (block->linear ? 0 : 1)];
+	for (auto it = pool.begin(); it != pool.end(); ++it)
+	{
+		if (it->get() == block)
+		{
+			vkFreeMemory(m_device, block->memory, nullptr);
+			pool.erase(it);
+			return;
+		}
+	}
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, bool linear)
+{
+	if ((properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		throw std::runtime_error("host visible allocations have to be host coherent, mapped memory is never flushed");
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint32_t memoryType = UINT32_MAX;
+	for (uint32_t i = 0; i < m_memProperties.memoryTypeCount; ++i)
+	{
+		if (memRequirements.memoryTypeBits & (1 << i) &&
+			(m_memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			memoryType = i;
+			break;
+		}
+	}
+
+	if (memoryType == UINT32_MAX)
+	{
+		throw std::runtime_error("failed to find suitable memory type");
+	}
+
+	MemoryAllocation allocation{};
+	allocation.memoryType = memoryType;
+	allocation.size = memRequirements.size;
+
+	VkDeviceSize blockSize = blockSizeFor(memoryType);
+
+	//big resources (render targets, large textures) are not worth sub-allocating
+	if (memRequirements.size > blockSize / 2)
+	{
+		allocation.memory = allocateDeviceMemory(memoryType, memRequirements.size, &allocation.mapped);
+		allocation.offset = 0;
+		m_dedicatedCount++;
+		m_dedicatedBytes += memRequirements.size;
+		m_allocationCount++;
+		return allocation;
+	}
+
+	auto& pool = m_pools[memoryType * 2 + (linear ? 0 : 1)];
+
+	MemoryBlock* target = nullptr;
+	VkDeviceSize offset = 0;
+	VkDeviceSize nodeSize = 0;
+	for (auto& block : pool)
+	{
+		if (block->buddy->allocate(memRequirements.size, memRequirements.alignment, offset, nodeSize))
+		{
+			target = block.get();
+			break;
+		}
+	}
+
+	if (target == nullptr)
+	{
+		target = createBlock(memoryType, linear, blockSize);
+		if (!target->buddy->allocate(memRequirements.size, memRequirements.alignment, offset, nodeSize))
+		{
+			throw std::runtime_error("failed to sub-allocate from a fresh memory block");
+		}
+	}
+
+	target->requestedBytes += memRequirements.size;
+
+	allocation.memory = target->memory;
+	allocation.offset = offset;
+	allocation.block = target;
+	allocation.nodeSize = nodeSize;
+	allocation.mapped = target->mapped ? static_cast<char*>(target->mapped) + offset : nullptr;
+	m_allocationCount++;
+	return allocation;
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (allocation.block == nullptr)
+	{
+		vkFreeMemory(m_device, allocation.memory, nullptr);
+		m_dedicatedCount--;
+		m_dedicatedBytes -= allocation.size;
+	}
+	else
+	{
+		MemoryBlock* block = allocation.block;
+		block->buddy->free(allocation.offset, allocation.nodeSize);
+		block->requestedBytes -= allocation.size;
+
+		//keep one empty block around per pool so load/unload cycles don't thrash the driver
+		if (block->buddy->empty())
+		{
+			auto& pool = m_pools[block->memoryType * 2 + (block->linear ? 0 : 1)];
+			size_t emptyBlocks = 0;
+			for (auto& b : pool)
+			{
+				if (b->buddy->empty()) emptyBlocks++;
+			}
+			if (emptyBlocks > 1)
+			{
+				destroyBlock(block);
+			}
+		}
+	}
+
+	m_allocationCount--;
+	allocation = MemoryAllocation{};
+}
+
+MemoryStats DeviceMemoryAllocator::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	MemoryStats stats{};
+	stats.dedicatedCount = m_dedicatedCount;
+	stats.allocationCount = m_allocationCount;
+	stats.reservedBytes = m_dedicatedBytes;
+	stats.usedBytes = m_dedicatedBytes;
+	stats.requestedBytes = m_dedicatedBytes;
+
+	float fragmentationSum = 0.0f;
+	for (auto& pool : m_pools)
+	{
+		for (auto& block : pool)
+		{
+			BuddyAllocator& buddy = *block->buddy;
+			stats.blockCount++;
+			stats.reservedBytes += buddy.totalSize();
+			stats.usedBytes += buddy.usedSize();
+			stats.requestedBytes += block->requestedBytes;
+
+			VkDeviceSize freeBytes = buddy.totalSize() - buddy.usedSize();
+			if (freeBytes > 0)
+			{
+				fragmentationSum += 1.0f - static_cast<float>(buddy.largestFreeNode()) / static_cast<float>(freeBytes);
+			}
+		}
+	}
+
+	stats.wastedBytes = stats.usedBytes - stats.requestedBytes;
+	stats.fragmentation = stats.blockCount > 0 ? fragmentationSum / stats.blockCount : 0.0f;
+	return stats;
+}
+
+void DeviceMemoryAllocator::printStats()
+{
+	MemoryStats stats = getStats();
+	std::cout << "[ALLOCATOR]: blocks " << stats.blockCount
+		<< ", dedicated " << stats.dedicatedCount
+		<< ", allocations " << stats.allocationCount << '\n'
+		<< "\treserved " << stats.reservedBytes / 1024 << " KB"
+		<< ", used " << stats.usedBytes / 1024 << " KB"
+		<< ", wasted " << stats.wastedBytes / 1024 << " KB"
+		<< ", fragmentation " << stats.fragmentation << std::endl;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+
+class Vulkan_Backend;
+
+//sub-allocation handed out by the DeviceMemoryAllocator
+//memory + offset is what goes into vkBind*Memory
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	//non null for HOST_VISIBLE memory, blocks stay mapped for their whole lifetime. mapped memory is
+	//always HOST_COHERENT, nothing flushes it
+	void* mapped = nullptr;
+	uint32_t memoryType = 0;
+
+	//bookkeeping, owner block is null for dedicated allocations
+	struct MemoryBlock* block = nullptr;
+	VkDeviceSize nodeSize = 0;
+};
+
+//buddy sub-allocator over a power of two range, no Vulkan calls in here
+//offsets returned are always multiples of the node size, so any power of two
+//alignment up to the node size comes for free
+class BuddyAllocator {
+public:
+	BuddyAllocator(VkDeviceSize size, VkDeviceSize minNodeSize);
+
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset, VkDeviceSize& outNodeSize);
+	void free(VkDeviceSize offset, VkDeviceSize nodeSize);
+
+	VkDeviceSize totalSize() const { return m_size; }
+	VkDeviceSize usedSize() const { return m_used; }
+	VkDeviceSize largestFreeNode() const;
+	bool empty() const { return m_used == 0; }
+
+private:
+	uint32_t levelForSize(VkDeviceSize size) const;
+	VkDeviceSize nodeSizeAt(uint32_t level) const { return m_size >> level; }
+
+	VkDeviceSize m_size;
+	VkDeviceSize m_minNodeSize;
+	VkDeviceSize m_used = 0;
+	uint32_t m_levelCount;
+	//free node offsets per level, level 0 is the whole range
+	std::vector<std::set<VkDeviceSize>> m_freeLists;
+};
+
+struct MemoryBlock {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mapped = nullptr;
+	uint32_t memoryType = 0;
+	bool linear = true;
+	VkDeviceSize requestedBytes = 0;
+	std::unique_ptr<BuddyAllocator> buddy;
+};
+
+struct MemoryStats {
+	uint32_t blockCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t allocationCount = 0;
+	VkDeviceSize reservedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize requestedBytes = 0;
+	//node size minus requested size, internal fragmentation of the buddy scheme
+	VkDeviceSize wastedBytes = 0;
+	//1 - largest free node / total free bytes, averaged over blocks. 0 means no fragmentation
+	float fragmentation = 0.0f;
+};
+
+//one device memory allocator per VkDevice
+//allocates large blocks per memory type and sub-allocates them with a buddy allocator
+//linear (buffers) and optimal (images) resources never share a block, so bufferImageGranularity
+//cannot be violated by neighbouring sub-allocations
+class DeviceMemoryAllocator {
+public:
+	void init(Vulkan_Backend& backend);
+	void init(VkDevice device, VkPhysicalDevice physicalDevice);
+	void cleanUp();
+
+	//HOST_VISIBLE has to come with HOST_COHERENT, throws otherwise
+	MemoryAllocation allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags properties, bool linear);
+	void free(MemoryAllocation& allocation);
+
+	MemoryStats getStats();
+	void printStats();
+
+	//smallest node the buddy allocators hand out
+	static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+	//blocks are capped to this size, heaps smaller than 8x this use heap size / 8
+	static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+private:
+	VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+	MemoryBlock* createBlock(uint32_t memoryType, bool linear, VkDeviceSize size);
+	void destroyBlock(MemoryBlock* block);
+	VkDeviceMemory allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, void** outMapped);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_memProperties{};
+
+	//pools are indexed by memoryType * 2 + (linear ? 0 : 1)
+	std::vector<std::vector<std::unique_ptr<MemoryBlock>>> m_pools;
+	uint32_t m_dedicatedCount = 0;
+	uint32_t m_allocationCount = 0;
+	VkDeviceSize m_dedicatedBytes = 0;
+	std::mutex m_mutex;
+};
@@ -0,0 +1,238 @@
+#include "MeshCache.h"
+#include "Hash.h"
+#include "VertexPacking.h"
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+static const char MESH_CACHE_MAGIC[4] = { 'S', 'S', 'M', 'C' };
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t utils::hashMeshSource(const std::string& path)
+{
+	MappedFile source;
+	if (!source.open(path))
+		return 0;
+
+	uint64_t hash = hashFNV1a(source.data(), source.size());
+
+	//materials live in separate .mtl files for OBJ, editing them must invalidate the cache too
+	std::string directory = path.substr(0, path.find_last_of('/'));
+	const char* cursor = source.data();
+	const char* end = source.data() + source.size();
+	while (cursor < end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+		if (!lineEnd) lineEnd = end;
+
+		if (lineEnd - cursor > 7 && strncmp(cursor, "mtllib ", 7) == 0)
+		{
+			std::string mtl(cursor + 7, lineEnd);
+			while (!mtl.empty() && (mtl.back() == '\r' || mtl.back() == ' ')) mtl.pop_back();
+
+			MappedFile library;
+			if (library.open(directory + "/" + mtl))
+			{
+				hash = hashFNV1a(library.data(), library.size(), hash);
+			}
+		}
+		cursor = lineEnd + 1;
+	}
+
+	//0 is reserved for "no hash"
+	return hash == 0 ? 1 : hash;
+}
+
+bool utils::readMeshCache(const MappedFile& file, uint64_t sourceHash, uint32_t importFlags, VertexFormat vertexFormat,
+	std::vector<CachedMesh>& outMeshes, std::vector<SceneNode>& outNodes)
+{
+	if (!file.isOpen() || file.size() < sizeof(MeshCacheHeader))
+		return false;
+
+	MeshCacheHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+
+	if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != MESH_CACHE_VERSION ||
+		header.sourceHash != sourceHash ||
+		header.importFlags != importFlags ||
+		header.vertexSize != vertexSizeOf(vertexFormat) ||
+		header.vertexFormat != static_cast<uint32_t>(vertexFormat))
+	{
+		return false;
+	}
+
+	uint64_t entriesEnd = sizeof(MeshCacheHeader) + static_cast<uint64_t>(header.meshCount) * sizeof(MeshCacheEntry);
+	uint64_t nodesEnd = entriesEnd + static_cast<uint64_t>(header.nodeCount) * sizeof(SceneNode);
+	if (nodesEnd > file.size())
+		return false;
+
+	const MeshCacheEntry* entries = reinterpret_cast<const MeshCacheEntry*>(file.data() + sizeof(MeshCacheHeader));
+
+	//parents have to come first, TransformHierarchy relies on it
+	outNodes.resize(header.nodeCount);
+	if (header.nodeCount > 0)
+		memcpy(outNodes.data(), file.data() + entriesEnd, header.nodeCount * sizeof(SceneNode));
+	for (uint32_t i = 0; i < header.nodeCount; ++i)
+	{
+		if (outNodes[i].parent != TransformHierarchy::NO_PARENT && (outNodes[i].parent < 0 || static_cast<uint32_t>(outNodes[i].parent) >= i))
+		{
+			outNodes.clear();
+			return false;
+		}
+	}
+
+	outMeshes.clear();
+	outMeshes.reserve(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		const MeshCacheEntry& entry = entries[i];
+		uint64_t vertexEnd = entry.vertexOffset + static_cast<uint64_t>(entry.vertexCount) * header.vertexSize;
+		uint64_t indexEnd = entry.indexOffset + static_cast<uint64_t>(entry.indexCount) * entry.indexSize;
+		uint64_t meshletEnd = entry.meshletOffset + static_cast<uint64_t>(entry.meshletCount) * sizeof(Meshlet);
+		uint64_t pathEnd = static_cast<uint64_t>(entry.diffusePathOffset) + entry.diffusePathLength;
+		if ((entry.indexSize != 2 && entry.indexSize != 4) || entry.lodCount > MAX_MESH_LODS || entry.transformNode >= header.nodeCount ||
+			vertexEnd > file.size() || indexEnd > file.size() || meshletEnd > file.size() || pathEnd > file.size() ||
+			entry.vertexOffset % 4 != 0 || entry.indexOffset % entry.indexSize != 0 || entry.meshletOffset % alignof(Meshlet) != 0)
+		{
+			outMeshes.clear();
+			return false;
+		}
+		for (uint32_t lod = 0; lod < entry.lodCount; ++lod)
+		{
+			if (static_cast<uint64_t>(entry.lods[lod].firstIndex) + entry.lods[lod].indexCount > entry.indexCount)
+			{
+				outMeshes.clear();
+				return false;
+			}
+		}
+
+		CachedMesh mesh;
+		mesh.vertices = file.data() + entry.vertexOffset;
+		mesh.vertexCount = entry.vertexCount;
+		mesh.indices = file.data() + entry.indexOffset;
+		mesh.indexCount = entry.indexCount;
+		mesh.indexType = entry.indexSize == 4 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+		mesh.meshlets = reinterpret_cast<const Meshlet*>(file.data() + entry.meshletOffset);
+		mesh.meshletCount = entry.meshletCount;
+		mesh.lods = entry.lods;
+		mesh.lodCount = entry.lodCount;
+		mesh.transformNode = entry.transformNode;
+		mesh.boundsMin = entry.boundsMin;
+		mesh.boundsExtent = entry.boundsExtent;
+		mesh.diffusePath.assign(file.data() + entry.diffusePathOffset, entry.diffusePathLength);
+		outMeshes.push_back(std::move(mesh));
+	}
+
+	return true;
+}
+
+bool utils::writeMeshCache(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, VertexFormat vertexFormat,
+	const std::vector<Mesh>& meshes, const std::vector<std::string>& diffusePaths,
+	const std::vector<SceneNode>& nodes, const std::vector<uint32_t>& meshNodes)
+{
+	MeshCacheHeader header{};
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.importFlags = importFlags;
+	header.vertexSize = vertexSizeOf(vertexFormat);
+	header.vertexFormat = static_cast<uint32_t>(vertexFormat);
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+
+	std::vector<MeshCacheEntry> entries(meshes.size());
+	std::string strings;
+
+	uint64_t offset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry) + nodes.size() * sizeof(SceneNode);
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		entries[i].transformNode = meshNodes[i];
+		entries[i].boundsMin = meshes[i].boundsMin;
+		entries[i].boundsExtent = meshes[i].boundsExtent;
+		entries[i].diffusePathOffset = static_cast<uint32_t>(offset + strings.size());
+		entries[i].diffusePathLength = static_cast<uint32_t>(diffusePaths[i].size());
+		strings += diffusePaths[i];
+	}
+	offset += strings.size();
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		offset = alignUp(offset, 16);
+		entries[i].vertexOffset = offset;
+		entries[i].vertexCount = static_cast<uint32_t>(meshes[i].vertices.size());
+		offset += meshes[i].vertices.size() * header.vertexSize;
+
+		offset = alignUp(offset, 16);
+		entries[i].indexOffset = offset;
+		entries[i].indexCount = static_cast<uint32_t>(meshes[i].indices.size());
+		entries[i].indexSize = indexSizeOf(meshes[i].indexType);
+		offset += meshes[i].indices.size() * entries[i].indexSize;
+
+		offset = alignUp(offset, 16);
+		entries[i].meshletOffset = offset;
+		entries[i].meshletCount = static_cast<uint32_t>(meshes[i].meshlets.size());
+		offset += meshes[i].meshlets.size() * sizeof(Meshlet);
+
+		entries[i].lodCount = static_cast<uint32_t>(std::min<size_t>(meshes[i].lods.size(), MAX_MESH_LODS));
+		std::copy(meshes[i].lods.begin(), meshes[i].lods.begin() + entries[i].lodCount, entries[i].lods);
+	}
+
+	//written to a temporary first so a crash never leaves a truncated cache behind
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		const char padding[16] = {};
+		std::vector<packedVertex> packed;
+		auto pad = [&](uint64_t target) {
+			uint64_t pos = static_cast<uint64_t>(out.tellp());
+			out.write(padding, static_cast<std::streamsize>(target - pos));
+		};
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MeshCacheEntry));
+		out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(SceneNode));
+		out.write(strings.data(), strings.size());
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			pad(entries[i].vertexOffset);
+			if (vertexFormat == VertexFormat::Packed)
+			{
+				//same encoding SetupMesh uploaded, against the bounds it stored on the mesh
+				encodePackedVertices(meshes[i].vertices.data(), entries[i].vertexCount, meshes[i].boundsMin, meshes[i].boundsExtent, packed);
+				out.write(reinterpret_cast<const char*>(packed.data()), packed.size() * sizeof(packedVertex));
+			}
+			else
+			{
+				out.write(reinterpret_cast<const char*>(meshes[i].vertices.data()), meshes[i].vertices.size() * sizeof(vertex));
+			}
+			pad(entries[i].indexOffset);
+			if (entries[i].indexSize == 4)
+			{
+				out.write(reinterpret_cast<const char*>(meshes[i].indices.data()), meshes[i].indices.size() * sizeof(uint32_t));
+			}
+			else
+			{
+				std::vector<uint16_t> narrowIndices(meshes[i].indices.size());
+				for (size_t j = 0; j < narrowIndices.size(); ++j)
+					narrowIndices[j] = static_cast<uint16_t>(meshes[i].indices[j]);
+				out.write(reinterpret_cast<const char*>(narrowIndices.data()), narrowIndices.size() * sizeof(uint16_t));
+			}
+			pad(entries[i].meshletOffset);
+			out.write(reinterpret_cast<const char*>(meshes[i].meshlets.data()), meshes[i].meshlets.size() * sizeof(Meshlet));
+		}
+
+		if (!out.good())
+			return false;
+	}
+
+	std::remove(cachePath.c_str());
+	return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Primitives.h"
+#include "MappedFile.h"
+#include "TransformHierarchy.h"
+
+//binary cache of imported meshes, stored next to the source as <path>.meshcache
+//layout: header | entries | scene nodes | texture path strings | vertex, index and meshlet data (16 byte aligned)
+//vertices are stored in the gpu vertex format, so a warm load uploads them without encoding
+//bump MESH_CACHE_VERSION whenever the layout or the import pipeline output changes
+const uint32_t MESH_CACHE_VERSION = 7;
+
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t importFlags;
+	//size of a stored vertex, vertexSizeOf(vertexFormat)
+	uint32_t vertexSize;
+	//gpu vertex format the split / 32 bit index decision was made for
+	uint32_t vertexFormat;
+	uint32_t meshCount;
+	//flattened node hierarchy, right behind the entries
+	uint32_t nodeCount;
+};
+
+struct MeshCacheEntry {
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t diffusePathOffset;
+	uint32_t diffusePathLength;
+	//2 or 4, indices are stored in the width the gpu buffer uses
+	uint32_t indexSize;
+	uint32_t meshletCount;
+	uint64_t meshletOffset;
+	//ranges into the stored indices, which hold every level back to back
+	uint32_t lodCount;
+	MeshLod lods[MAX_MESH_LODS];
+	//index into the stored scene nodes
+	uint32_t transformNode;
+	//packed positions are relative to these
+	glm::vec3 boundsMin;
+	glm::vec3 boundsExtent;
+};
+
+//mesh as stored in the cache, pointers are into the mapped cache file
+struct CachedMesh {
+	//in the gpu vertex format the cache was written for
+	const void* vertices;
+	uint32_t vertexCount;
+	const void* indices;
+	uint32_t indexCount;
+	VkIndexType indexType;
+	const Meshlet* meshlets;
+	uint32_t meshletCount;
+	const MeshLod* lods;
+	uint32_t lodCount;
+	uint32_t transformNode;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsExtent;
+	//relative to the model directory, empty when the mesh has no diffuse map
+	std::string diffusePath;
+};
+
+namespace utils {
+
+	//FNV-1a over the source file and the material libraries it references, 0 if the source can't be read
+	uint64_t hashMeshSource(const std::string& path);
+
+	//false if the cache is missing, stale or malformed
+	bool readMeshCache(const MappedFile& file, uint64_t sourceHash, uint32_t importFlags, VertexFormat vertexFormat,
+		std::vector<CachedMesh>& outMeshes, std::vector<SceneNode>& outNodes);
+
+	//meshes must have been set up, their index type decides the stored index width
+	//meshNodes holds each mesh's index into nodes, the meshes' own transformNode is scene global
+	bool writeMeshCache(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, VertexFormat vertexFormat,
+		const std::vector<Mesh>& meshes, const std::vector<std::string>& diffusePaths,
+		const std::vector<SceneNode>& nodes, const std::vector<uint32_t>& meshNodes);
+
+}
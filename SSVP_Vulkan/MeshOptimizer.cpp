@@ -0,0 +1,371 @@
+#include "MeshOptimizer.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+//fifo cache simulation through timestamps, a vertex is cached while fewer than cacheSize misses happened since it was loaded
+struct FifoCache {
+	std::vector<uint32_t> loadTime;
+	uint32_t time;
+	uint32_t size;
+
+	FifoCache(size_t vertexCount, uint32_t cacheSize) : loadTime(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+	//returns true on a miss
+	bool access(uint32_t v)
+	{
+		if (time - loadTime[v] > size)
+		{
+			loadTime[v] = time++;
+			return true;
+		}
+		return false;
+	}
+
+	//ages every entry past the cache size, next access to any vertex misses
+	void flush() { time += size + 1; }
+};
+
+VertexCacheStats utils::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<char> referenced(vertexCount, 0);
+	size_t misses = 0;
+	size_t uniqueVertices = 0;
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t v = indices[i];
+		if (cache.access(v)) misses++;
+		if (!referenced[v])
+		{
+			referenced[v] = 1;
+			uniqueVertices++;
+		}
+	}
+
+	stats.acmr = float(misses) / float(indexCount / 3);
+	stats.atvr = float(misses) / float(uniqueVertices);
+	return stats;
+}
+
+//triangles using each vertex, in csr form
+struct TriangleAdjacency {
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+
+	TriangleAdjacency(const uint32_t* indices, size_t indexCount, size_t vertexCount) : offsets(vertexCount + 1, 0), triangles(indexCount)
+	{
+		for (size_t i = 0; i < indexCount; ++i)
+			offsets[indices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			offsets[v + 1] += offsets[v];
+
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; ++i)
+			triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	uint32_t count(uint32_t v) const { return offsets[v + 1] - offsets[v]; }
+};
+
+void utils::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* outClusters)
+{
+	if (outClusters) outClusters->clear();
+	if (indexCount < 3 || vertexCount == 0)
+		return;
+
+	const size_t triangleCount = indexCount / 3;
+	TriangleAdjacency adjacency(indices, indexCount, vertexCount);
+
+	//triangles not yet emitted per vertex
+	std::vector<uint32_t> live(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		live[v] = adjacency.count(v);
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	uint32_t cursor = 0;
+
+	std::vector<uint32_t> result;
+	result.reserve(indexCount);
+
+	//restart from the lowest vertex with triangles left, the cache is cold at that point
+	auto nextFromCursor = [&]() -> int64_t {
+		while (cursor < vertexCount && live[cursor] == 0) cursor++;
+		if (cursor == vertexCount)
+			return -1;
+		if (outClusters) outClusters->push_back(static_cast<uint32_t>(result.size()));
+		return cursor;
+	};
+
+	int64_t fan = nextFromCursor();
+	while (fan >= 0)
+	{
+		candidates.clear();
+
+		//emit every remaining triangle around the fanning vertex
+		uint32_t f = static_cast<uint32_t>(fan);
+		for (uint32_t a = adjacency.offsets[f]; a < adjacency.offsets[f + 1]; ++a)
+		{
+			uint32_t t = adjacency.triangles[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = 1;
+
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				uint32_t v = indices[t * 3 + k];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+		}
+
+		//next fan: the candidate that stays in cache longest while its remaining triangles are emitted
+		fan = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = time - cacheTime[v];
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fan = v;
+			}
+		}
+
+		//dead end, go back to recently touched vertices before scanning for a fresh start
+		while (fan < 0 && !deadEnd.empty())
+		{
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0) fan = v;
+		}
+		if (fan < 0)
+			fan = nextFromCursor();
+	}
+
+	std::memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+}
+
+uint32_t utils::optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride,
+	const std::vector<uint32_t>& hardClusters, uint32_t cacheSize, float threshold)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return 0;
+
+	auto position = [&](uint32_t v) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * positionStride);
+	};
+
+	//soft boundaries: inside each hard cluster split wherever the running acmr is already as good as the cluster's
+	std::vector<uint32_t> hard = hardClusters;
+	if (hard.empty() || hard[0] != 0)
+		hard.insert(hard.begin(), 0);
+
+	std::vector<uint32_t> clusters;
+	FifoCache cache(vertexCount, cacheSize);
+	for (size_t h = 0; h < hard.size(); ++h)
+	{
+		size_t begin = hard[h] / 3;
+		size_t end = h + 1 < hard.size() ? hard[h + 1] / 3 : triangleCount;
+
+		cache.flush();
+		size_t clusterMisses = 0;
+		for (size_t t = begin * 3; t < end * 3; ++t)
+			clusterMisses += cache.access(indices[t]);
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - begin);
+
+		cache.flush();
+		size_t start = begin;
+		size_t misses = 0;
+		clusters.push_back(static_cast<uint32_t>(begin));
+		for (size_t t = begin; t < end; ++t)
+		{
+			misses += cache.access(indices[t * 3 + 0]);
+			misses += cache.access(indices[t * 3 + 1]);
+			misses += cache.access(indices[t * 3 + 2]);
+
+			if (t + 1 < end && float(misses) / float(t - start + 1) <= clusterThreshold)
+			{
+				//the cluster may be drawn after any other, so it has to start from a cold cache
+				clusters.push_back(static_cast<uint32_t>(t + 1));
+				start = t + 1;
+				misses = 0;
+				cache.flush();
+			}
+		}
+	}
+
+	//mesh centroid over referenced vertices
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		const float* p = position(indices[i]);
+		meshCentroid[0] += p[0];
+		meshCentroid[1] += p[1];
+		meshCentroid[2] += p[2];
+	}
+	for (float& c : meshCentroid) c /= float(indexCount);
+
+	//sort key: how far the cluster faces away from the mesh centre, outward facing clusters occlude the rest
+	std::vector<float> sortKeys(clusters.size());
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		size_t begin = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float areaSum = 0.0f;
+		for (size_t t = begin; t < end; ++t)
+		{
+			const float* p0 = position(indices[t * 3 + 0]);
+			const float* p1 = position(indices[t * 3 + 1]);
+			const float* p2 = position(indices[t * 3 + 2]);
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			//cross product length is twice the area, the factor cancels out
+			float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; ++k)
+			{
+				centroid[k] += (p0[k] + p1[k] + p2[k]) * (area / 3.0f);
+				normal[k] += n[k];
+			}
+			areaSum += area;
+		}
+
+		if (areaSum <= 0.0f)
+		{
+			sortKeys[c] = 0.0f;
+			continue;
+		}
+
+		float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float inverseNormal = normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+		float key = 0.0f;
+		for (int k = 0; k < 3; ++k)
+			key += (centroid[k] / areaSum - meshCentroid[k]) * normal[k] * inverseNormal;
+		sortKeys[c] = key;
+	}
+
+	std::vector<uint32_t> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indexCount);
+	for (uint32_t c : order)
+	{
+		size_t begin = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		result.insert(result.end(), indices + begin * 3, indices + end * 3);
+	}
+
+	std::memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+	return static_cast<uint32_t>(clusters.size());
+}
+
+size_t utils::optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t& r = remap[indices[i]];
+		if (r == UINT32_MAX) r = next++;
+		indices[i] = r;
+	}
+
+	unsigned char* bytes = static_cast<unsigned char*>(vertices);
+	std::vector<unsigned char> reordered(size_t(next) * vertexSize);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] != UINT32_MAX)
+			std::memcpy(reordered.data() + remap[v] * vertexSize, bytes + v * vertexSize, vertexSize);
+	}
+
+	std::memcpy(bytes, reordered.data(), reordered.size());
+	return next;
+}
+
+size_t utils::splitMesh(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t maxVertices, std::vector<MeshSplit>& outSplits)
+{
+	outSplits.clear();
+	if (indexCount < 3 || maxVertices < 3)
+		return 0;
+
+	//local index per source vertex, valid while localSplit matches the current split
+	std::vector<uint32_t> local(vertexCount, 0);
+	std::vector<uint32_t> localSplit(vertexCount, UINT32_MAX);
+	size_t totalVertices = 0;
+
+	outSplits.emplace_back();
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		MeshSplit* split = &outSplits.back();
+		uint32_t splitIndex = static_cast<uint32_t>(outSplits.size() - 1);
+
+		uint32_t newVertices = 0;
+		for (size_t k = 0; k < 3; ++k)
+			newVertices += localSplit[indices[t + k]] != splitIndex;
+		//a repeated vertex in a degenerate triangle is counted twice, that only ends a split early
+		if (split->vertexRemap.size() + newVertices > maxVertices)
+		{
+			totalVertices += split->vertexRemap.size();
+			outSplits.emplace_back();
+			split = &outSplits.back();
+			splitIndex++;
+		}
+
+		for (size_t k = 0; k < 3; ++k)
+		{
+			uint32_t v = indices[t + k];
+			if (localSplit[v] != splitIndex)
+			{
+				localSplit[v] = splitIndex;
+				local[v] = static_cast<uint32_t>(split->vertexRemap.size());
+				split->vertexRemap.push_back(v);
+			}
+			split->indices.push_back(static_cast<uint16_t>(local[v]));
+		}
+	}
+
+	totalVertices += outSplits.back().vertexRemap.size();
+	return totalVertices;
+}
+
+MeshOptimizationStats utils::optimizeMesh(void* vertices, size_t& vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount)
+{
+	MeshOptimizationStats stats;
+	stats.before = analyzeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE);
+
+	std::vector<uint32_t> hardClusters;
+	optimizeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE, &hardClusters);
+	stats.clusterCount = optimizeOverdraw(indices, indexCount, static_cast<const float*>(vertices), vertexCount, vertexSize,
+		hardClusters, VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD);
+	vertexCount = optimizeVertexFetch(vertices, vertexCount, vertexSize, indices, indexCount);
+
+	stats.after = analyzeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE);
+	return stats;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//import time index and vertex reordering, cpu only and independent of vulkan
+
+//cache size the reordering targets and the stats simulate, close to the fifo depth of current gpus
+const uint32_t VERTEX_CACHE_SIZE = 16;
+//clusters may be split wherever their acmr stays under this factor of the whole mesh acmr
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+//result of running an index buffer through a simulated fifo post-transform cache
+struct VertexCacheStats {
+	//cache misses per triangle, 0.5 is the lower bound for a regular grid, 3 is no reuse at all
+	float acmr = 0.0f;
+	//cache misses per referenced vertex, 1 is optimal
+	float atvr = 0.0f;
+};
+
+//triangle run of a split mesh, with its own vertex numbering starting at 0
+struct MeshSplit {
+	//source vertex of each local vertex, in first use order
+	std::vector<uint32_t> vertexRemap;
+	std::vector<uint16_t> indices;
+};
+
+struct MeshOptimizationStats {
+	VertexCacheStats before;
+	VertexCacheStats after;
+	uint32_t clusterCount = 0;
+};
+
+namespace utils {
+
+	VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+
+	//tipsify (Sander et al. 2007), reorders triangles for post-transform cache reuse
+	//optionally returns the index offsets where a new cluster starts, the cache is cold at each of them
+	void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize,
+		std::vector<uint32_t>* outClusters = nullptr);
+
+	//splits the cache optimized triangle order into clusters and sorts them front to back from the outside
+	//of the mesh in, so early-z rejects more from any view direction. positions are read with a byte stride
+	//returns the number of clusters
+	uint32_t optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride,
+		const std::vector<uint32_t>& hardClusters, uint32_t cacheSize, float threshold);
+
+	//reorders vertices by first use in the index buffer and remaps the indices, unreferenced vertices are dropped
+	//returns the new vertex count
+	size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount);
+
+	//cuts the triangle list, in its current order, into runs that reference at most maxVertices vertices each
+	//vertices shared across a cut are duplicated, returns the total vertex count over all splits
+	size_t splitMesh(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t maxVertices, std::vector<MeshSplit>& outSplits);
+
+	//all three passes in order, positions are the first three floats of each vertex
+	//vertexCount is updated to the count after unreferenced vertices were dropped
+	MeshOptimizationStats optimizeMesh(void* vertices, size_t& vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount);
+
+}
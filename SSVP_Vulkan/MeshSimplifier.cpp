@@ -0,0 +1,375 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+//weight of the planes that keep open borders in place, relative to the surface planes
+static const double BORDER_WEIGHT = 10.0;
+
+enum class VertexKind : uint8_t {
+	//interior vertex with a single set of attributes, collapses anywhere
+	Manifold,
+	//on an open border, collapses only along the border
+	Border,
+	//uv seam, crease, tangent frame border or non manifold, never moves
+	Locked
+};
+
+//symmetric 4x4 plane quadric, error(p) = sum of weight * squared distance to the accumulated planes
+struct Quadric {
+	double a2 = 0, b2 = 0, c2 = 0, ab = 0, ac = 0, bc = 0, ad = 0, bd = 0, cd = 0, d2 = 0;
+	double weight = 0;
+
+	void addPlane(double a, double b, double c, double d, double w)
+	{
+		a2 += w * a * a; b2 += w * b * b; c2 += w * c * c;
+		ab += w * a * b; ac += w * a * c; bc += w * b * c;
+		ad += w * a * d; bd += w * b * d; cd += w * c * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+
+	void add(const Quadric& q)
+	{
+		a2 += q.a2; b2 += q.b2; c2 += q.c2;
+		ab += q.ab; ac += q.ac; bc += q.bc;
+		ad += q.ad; bd += q.bd; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	//weighted mean squared distance, so the result is comparable to a squared object space error
+	double error(const float* p) const
+	{
+		double x = p[0], y = p[1], z = p[2];
+		double e = a2 * x * x + b2 * y * y + c2 * z * z
+			+ 2.0 * (ab * x * y + ac * x * z + bc * y * z)
+			+ 2.0 * (ad * x + bd * y + cd * z) + d2;
+		return weight > 0.0 ? std::fabs(e) / weight : 0.0;
+	}
+};
+
+struct PositionAccess {
+	const unsigned char* base;
+	size_t stride;
+	const float* operator()(uint32_t v) const { return reinterpret_cast<const float*>(base + v * stride); }
+};
+
+static void triangleNormal(const float* a, const float* b, const float* c, double* n)
+{
+	double e1[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+	double e2[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+//vertices with bitwise equal positions get the same id, the lowest vertex index of the group
+static void buildPositionIds(const PositionAccess& position, size_t vertexCount, std::vector<uint32_t>& outIds, std::vector<uint32_t>& outWedgeCount)
+{
+	std::vector<uint32_t> order(vertexCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&position](uint32_t a, uint32_t b) {
+		const float* pa = position(a);
+		const float* pb = position(b);
+		if (pa[0] != pb[0]) return pa[0] < pb[0];
+		if (pa[1] != pb[1]) return pa[1] < pb[1];
+		if (pa[2] != pb[2]) return pa[2] < pb[2];
+		return a < b;
+	});
+
+	outIds.resize(vertexCount);
+	outWedgeCount.assign(vertexCount, 0);
+	for (size_t i = 0; i < vertexCount;)
+	{
+		size_t j = i;
+		const float* p = position(order[i]);
+		while (j < vertexCount && std::equal(p, p + 3, position(order[j]))) j++;
+		for (size_t k = i; k < j; ++k)
+		{
+			outIds[order[k]] = order[i];
+			outWedgeCount[order[k]] = static_cast<uint32_t>(j - i);
+		}
+		i = j;
+	}
+}
+
+//triangle count of every position space edge
+static void countEdges(const uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& positionIds, std::unordered_map<uint64_t, uint32_t>& outEdges)
+{
+	outEdges.clear();
+	outEdges.reserve(indexCount);
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		for (int e = 0; e < 3; ++e)
+		{
+			uint32_t a = positionIds[indices[t + e]];
+			uint32_t b = positionIds[indices[t + (e + 1) % 3]];
+			outEdges[edgeKey(a, b)]++;
+		}
+	}
+}
+
+size_t utils::simplifyMesh(const float* positions, size_t vertexCount, size_t positionStride,
+	const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float maxError,
+	uint32_t* outIndices, float* outError)
+{
+	PositionAccess position{ reinterpret_cast<const unsigned char*>(positions), positionStride };
+	std::vector<uint32_t> result(indices, indices + indexCount);
+	double resultError = 0.0;
+
+	std::vector<uint32_t> positionIds, wedgeCount;
+	buildPositionIds(position, vertexCount, positionIds, wedgeCount);
+
+	std::unordered_map<uint64_t, uint32_t> edges;
+	countEdges(result.data(), result.size(), positionIds, edges);
+
+	std::vector<VertexKind> kind(vertexCount, VertexKind::Manifold);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		if (wedgeCount[v] > 1) kind[v] = VertexKind::Locked;
+	}
+	for (size_t t = 0; t + 2 < result.size(); t += 3)
+	{
+		for (int e = 0; e < 3; ++e)
+		{
+			uint32_t a = result[t + e];
+			uint32_t b = result[t + (e + 1) % 3];
+			uint32_t uses = edges[edgeKey(positionIds[a], positionIds[b])];
+			if (uses == 1)
+			{
+				if (kind[a] == VertexKind::Manifold) kind[a] = VertexKind::Border;
+				if (kind[b] == VertexKind::Manifold) kind[b] = VertexKind::Border;
+			}
+			else if (uses > 2)
+			{
+				kind[a] = VertexKind::Locked;
+				kind[b] = VertexKind::Locked;
+			}
+		}
+	}
+
+	//surface planes weighted by area, open borders get a perpendicular plane along the edge
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t + 2 < result.size(); t += 3)
+	{
+		const float* p[3] = { position(result[t]), position(result[t + 1]), position(result[t + 2]) };
+		double n[3];
+		triangleNormal(p[0], p[1], p[2], n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0)
+			continue;
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+		double area = length * 0.5;
+		for (int k = 0; k < 3; ++k)
+			quadrics[result[t + k]].addPlane(n[0], n[1], n[2], d, area);
+
+		for (int e = 0; e < 3; ++e)
+		{
+			uint32_t a = result[t + e];
+			uint32_t b = result[t + (e + 1) % 3];
+			if (edges[edgeKey(positionIds[a], positionIds[b])] != 1)
+				continue;
+
+			const float* pa = p[e];
+			const float* pb = p[(e + 1) % 3];
+			double edge[3] = { double(pb[0]) - pa[0], double(pb[1]) - pa[1], double(pb[2]) - pa[2] };
+			double en[3] = { edge[1] * n[2] - edge[2] * n[1], edge[2] * n[0] - edge[0] * n[2], edge[0] * n[1] - edge[1] * n[0] };
+			double enLength = std::sqrt(en[0] * en[0] + en[1] * en[1] + en[2] * en[2]);
+			if (enLength == 0.0)
+				continue;
+			en[0] /= enLength; en[1] /= enLength; en[2] /= enLength;
+			double ed = -(en[0] * pa[0] + en[1] * pa[1] + en[2] * pa[2]);
+			double edgeLengthSq = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+			quadrics[a].addPlane(en[0], en[1], en[2], ed, edgeLengthSq * BORDER_WEIGHT);
+			quadrics[b].addPlane(en[0], en[1], en[2], ed, edgeLengthSq * BORDER_WEIGHT);
+		}
+	}
+
+	const double maxErrorSq = double(maxError) * maxError;
+
+	struct Collapse {
+		uint32_t v;
+		uint32_t u;
+		double cost;
+	};
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<char> locked(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+
+	//each pass collapses a set of edges whose one rings don't overlap, so every flip test sees final geometry
+	while (result.size() > targetIndexCount)
+	{
+		countEdges(result.data(), result.size(), positionIds, edges);
+
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t v : result) adjacencyOffsets[v + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i)
+				adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t t = 0; t + 2 < result.size(); t += 3)
+		{
+			for (int e = 0; e < 3; ++e)
+			{
+				uint32_t a = result[t + e];
+				uint32_t b = result[t + (e + 1) % 3];
+				bool borderEdge = edges[edgeKey(positionIds[a], positionIds[b])] == 1;
+
+				for (int dir = 0; dir < 2; ++dir)
+				{
+					uint32_t v = dir == 0 ? a : b;
+					uint32_t u = dir == 0 ? b : a;
+					if (kind[v] == VertexKind::Locked)
+						continue;
+					if (kind[v] == VertexKind::Border && (!borderEdge || kind[u] == VertexKind::Manifold))
+						continue;
+					collapses.push_back({ v, u, quadrics[v].error(position(u)) });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (uint32_t v = 0; v < vertexCount; ++v) remap[v] = v;
+		std::fill(locked.begin(), locked.end(), 0);
+
+		size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+		size_t removed = 0;
+		size_t applied = 0;
+		for (const Collapse& c : collapses)
+		{
+			if (c.cost > maxErrorSq || removed >= trianglesToRemove)
+				break;
+			if (locked[c.v] || locked[c.u])
+				continue;
+
+			//the triangles around v that survive must not flip or fold flat
+			bool valid = true;
+			size_t collapsing = 0;
+			for (uint32_t a = adjacencyOffsets[c.v]; a < adjacencyOffsets[c.v + 1] && valid; ++a)
+			{
+				const uint32_t* tri = &result[adjacency[a] * 3];
+				if (tri[0] == c.u || tri[1] == c.u || tri[2] == c.u)
+				{
+					collapsing++;
+					continue;
+				}
+
+				const float* before[3] = { position(tri[0]), position(tri[1]), position(tri[2]) };
+				const float* after[3] = { before[0], before[1], before[2] };
+				for (int k = 0; k < 3; ++k)
+				{
+					if (tri[k] == c.v) after[k] = position(c.u);
+				}
+				double n0[3], n1[3];
+				triangleNormal(before[0], before[1], before[2], n0);
+				triangleNormal(after[0], after[1], after[2], n1);
+				double d = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+				double l0 = n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2];
+				double l1 = n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2];
+				valid = d > 0.0 && d * d > 0.0625 * l0 * l1;
+			}
+			if (!valid)
+				continue;
+
+			remap[c.v] = c.u;
+			for (uint32_t a = adjacencyOffsets[c.v]; a < adjacencyOffsets[c.v + 1]; ++a)
+			{
+				const uint32_t* tri = &result[adjacency[a] * 3];
+				locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = 1;
+			}
+			locked[c.u] = 1;
+
+			quadrics[c.u].add(quadrics[c.v]);
+			resultError = std::max(resultError, c.cost);
+			removed += collapsing;
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		size_t write = 0;
+		for (size_t t = 0; t + 2 < result.size(); t += 3)
+		{
+			uint32_t a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	std::copy(result.begin(), result.end(), outIndices);
+	if (outError) *outError = static_cast<float>(std::sqrt(resultError));
+	return result.size();
+}
+
+void utils::generateLods(const float* positions, size_t vertexCount, size_t positionStride,
+	std::vector<uint32_t>& indices, float maxError, std::vector<MeshLod>& outLods)
+{
+	outLods.clear();
+	outLods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+	if (indices.size() < 3 || vertexCount == 0)
+		return;
+
+	PositionAccess position{ reinterpret_cast<const unsigned char*>(positions), positionStride };
+	float boundsMin[3] = { position(indices[0])[0], position(indices[0])[1], position(indices[0])[2] };
+	float boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+	for (uint32_t v : indices)
+	{
+		const float* p = position(v);
+		for (int k = 0; k < 3; ++k)
+		{
+			boundsMin[k] = std::min(boundsMin[k], p[k]);
+			boundsMax[k] = std::max(boundsMax[k], p[k]);
+		}
+	}
+	float radius = 0.5f * std::sqrt((boundsMax[0] - boundsMin[0]) * (boundsMax[0] - boundsMin[0]) +
+		(boundsMax[1] - boundsMin[1]) * (boundsMax[1] - boundsMin[1]) +
+		(boundsMax[2] - boundsMin[2]) * (boundsMax[2] - boundsMin[2]));
+	const float errorLimit = maxError * radius;
+
+	std::vector<uint32_t> source(indices.begin(), indices.end());
+	std::vector<uint32_t> simplified(indices.size());
+	float accumulatedError = 0.0f;
+
+	while (outLods.size() < MAX_MESH_LODS)
+	{
+		size_t target = static_cast<size_t>(source.size() / 3 * LOD_TRIANGLE_RATIO) * 3;
+		if (target < 3 || accumulatedError >= errorLimit)
+			break;
+
+		float levelError = 0.0f;
+		size_t count = simplifyMesh(positions, vertexCount, positionStride, source.data(), source.size(), target,
+			errorLimit - accumulatedError, simplified.data(), &levelError);
+		if (count == 0 || count > source.size() * LOD_MIN_REDUCTION)
+			break;
+
+		//each level is simplified from the previous one, so the deviation from lod 0 is bounded by the sum
+		accumulatedError += levelError;
+		optimizeVertexCache(simplified.data(), count, vertexCount, VERTEX_CACHE_SIZE);
+
+		outLods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(count), accumulatedError });
+		indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+		source.assign(simplified.begin(), simplified.begin() + count);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//import time lod generation, cpu only and independent of vulkan
+
+//lod 0 included
+const uint32_t MAX_MESH_LODS = 5;
+//triangle budget of each level relative to the previous one
+const float LOD_TRIANGLE_RATIO = 0.5f;
+//a level that keeps more than this fraction of the previous one's triangles isn't worth storing
+const float LOD_MIN_REDUCTION = 0.8f;
+//largest deviation of the coarsest level, relative to the mesh bounds radius
+const float LOD_MAX_ERROR = 0.05f;
+
+//one level inside the mesh's index buffer, all levels share the lod 0 vertices
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	//object space distance the surface may deviate from lod 0
+	float error;
+};
+
+namespace utils {
+
+	//quadric error metric edge collapse onto existing vertices, so the result indexes the same vertex array
+	//vertices that share a position with another vertex (uv seams, normal creases, tangent frame borders)
+	//never move, open borders only collapse along the border
+	//writes at most indexCount indices to outIndices and returns the count, outError is the largest
+	//collapse error in object space units
+	size_t simplifyMesh(const float* positions, size_t vertexCount, size_t positionStride,
+		const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float maxError,
+		uint32_t* outIndices, float* outError);
+
+	//appends up to MAX_MESH_LODS - 1 simplified levels behind the lod 0 indices and fills outLods, lod 0 first
+	//maxError is the largest deviation a level may have, relative to the mesh bounds radius
+	void generateLods(const float* positions, size_t vertexCount, size_t positionStride,
+		std::vector<uint32_t>& indices, float maxError, std::vector<MeshLod>& outLods);
+
+}
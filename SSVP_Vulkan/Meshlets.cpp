@@ -0,0 +1,294 @@
+#include "Meshlets.h"
+#include <cmath>
+#include <algorithm>
+
+static void sub(const float* a, const float* b, float* out)
+{
+	out[0] = a[0] - b[0];
+	out[1] = a[1] - b[1];
+	out[2] = a[2] - b[2];
+}
+
+static float dot(const float* a, const float* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(const float* a, const float* b, float* out)
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float normalize(float* v)
+{
+	float length = std::sqrt(dot(v, v));
+	if (length > 0.0f)
+	{
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+	return length;
+}
+
+//bounds of the triangles [firstIndex, firstIndex + indexCount)
+static void computeMeshletBounds(const float* positions, size_t positionStride, const uint32_t* indices, Meshlet& meshlet)
+{
+	auto position = [&](uint32_t v) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + v * positionStride);
+	};
+	const uint32_t* tri = indices + meshlet.firstIndex;
+	const uint32_t count = meshlet.indexCount;
+
+	//aabb
+	for (int k = 0; k < 3; ++k)
+	{
+		meshlet.boundsMin[k] = position(tri[0])[k];
+		meshlet.boundsMax[k] = position(tri[0])[k];
+	}
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		const float* p = position(tri[i]);
+		for (int k = 0; k < 3; ++k)
+		{
+			meshlet.boundsMin[k] = std::min(meshlet.boundsMin[k], p[k]);
+			meshlet.boundsMax[k] = std::max(meshlet.boundsMax[k], p[k]);
+		}
+	}
+
+	//ritter sphere: start from the most distant pair of axis extremes, then grow over the outliers
+	uint32_t minVertex[3] = { tri[0], tri[0], tri[0] };
+	uint32_t maxVertex[3] = { tri[0], tri[0], tri[0] };
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		const float* p = position(tri[i]);
+		for (int k = 0; k < 3; ++k)
+		{
+			if (p[k] < position(minVertex[k])[k]) minVertex[k] = tri[i];
+			if (p[k] > position(maxVertex[k])[k]) maxVertex[k] = tri[i];
+		}
+	}
+
+	int widest = 0;
+	float widestSpan = -1.0f;
+	for (int k = 0; k < 3; ++k)
+	{
+		float d[3];
+		sub(position(maxVertex[k]), position(minVertex[k]), d);
+		if (dot(d, d) > widestSpan)
+		{
+			widestSpan = dot(d, d);
+			widest = k;
+		}
+	}
+
+	const float* a = position(minVertex[widest]);
+	const float* b = position(maxVertex[widest]);
+	float center[3] = { (a[0] + b[0]) * 0.5f, (a[1] + b[1]) * 0.5f, (a[2] + b[2]) * 0.5f };
+	float radius = std::sqrt(widestSpan) * 0.5f;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float d[3];
+		sub(position(tri[i]), center, d);
+		float distance = std::sqrt(dot(d, d));
+		if (distance > radius)
+		{
+			float grow = (distance - radius) * 0.5f;
+			radius += grow;
+			for (int k = 0; k < 3; ++k)
+				center[k] += d[k] * (grow / distance);
+		}
+	}
+
+	for (int k = 0; k < 3; ++k)
+		meshlet.center[k] = center[k];
+	meshlet.radius = radius;
+
+	//normal cone: axis is the average triangle normal, spread is the worst triangle against it
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	//unit normal and first corner of every non degenerate triangle
+	std::vector<float> normals;
+	std::vector<uint32_t> corners;
+	normals.reserve(count);
+	corners.reserve(count / 3);
+	for (uint32_t i = 0; i + 2 < count; i += 3)
+	{
+		float e1[3], e2[3], n[3];
+		sub(position(tri[i + 1]), position(tri[i]), e1);
+		sub(position(tri[i + 2]), position(tri[i]), e2);
+		cross(e1, e2, n);
+		if (normalize(n) == 0.0f)
+			continue;
+		normals.insert(normals.end(), n, n + 3);
+		corners.push_back(tri[i]);
+		axis[0] += n[0];
+		axis[1] += n[1];
+		axis[2] += n[2];
+	}
+
+	meshlet.coneCutoff = 1.0f;
+	for (int k = 0; k < 3; ++k)
+	{
+		meshlet.coneApex[k] = center[k];
+		meshlet.coneAxis[k] = 0.0f;
+	}
+	if (normals.empty() || normalize(axis) == 0.0f)
+		return;
+
+	float minDot = 1.0f;
+	for (size_t n = 0; n < normals.size(); n += 3)
+		minDot = std::min(minDot, dot(axis, &normals[n]));
+
+	for (int k = 0; k < 3; ++k)
+		meshlet.coneAxis[k] = axis[k];
+
+	//past ~85 degrees the cone rejects almost nothing and the apex runs off to infinity
+	if (minDot <= 0.1f)
+		return;
+
+	//move the apex back along the axis until it is behind every triangle plane
+	float maxT = 0.0f;
+	for (size_t i = 0; i < corners.size(); ++i)
+	{
+		const float* n = &normals[i * 3];
+		float toCenter[3];
+		sub(center, position(corners[i]), toCenter);
+		maxT = std::max(maxT, dot(toCenter, n) / dot(axis, n));
+	}
+
+	for (int k = 0; k < 3; ++k)
+		meshlet.coneApex[k] = center[k] - axis[k] * maxT;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+void utils::buildMeshlets(const float* positions, size_t vertexCount, size_t positionStride,
+	const uint32_t* indices, size_t indexCount, std::vector<Meshlet>& outMeshlets)
+{
+	outMeshlets.clear();
+	if (indexCount < 3)
+		return;
+
+	//meshlet that last used each vertex, counts unique vertices without clearing anything between meshlets
+	std::vector<uint32_t> lastMeshlet(vertexCount, UINT32_MAX);
+
+	Meshlet current{};
+	uint32_t meshletId = 0;
+	auto finish = [&]() {
+		computeMeshletBounds(positions, positionStride, indices, current);
+		outMeshlets.push_back(current);
+		meshletId++;
+		current = Meshlet{};
+	};
+
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		uint32_t newVertices = 0;
+		for (size_t k = 0; k < 3; ++k)
+			newVertices += lastMeshlet[indices[t + k]] != meshletId;
+
+		if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES)
+		{
+			finish();
+			current.firstIndex = static_cast<uint32_t>(t);
+		}
+		else if (current.indexCount == 0)
+		{
+			current.firstIndex = static_cast<uint32_t>(t);
+		}
+
+		for (size_t k = 0; k < 3; ++k)
+		{
+			uint32_t v = indices[t + k];
+			if (lastMeshlet[v] != meshletId)
+			{
+				lastMeshlet[v] = meshletId;
+				current.vertexCount++;
+			}
+		}
+		current.indexCount += 3;
+	}
+
+	if (current.indexCount > 0)
+		finish();
+}
+
+CullingFrustum utils::makeFrustum(const float position[3], const float forward[3], const float up[3],
+	float fovY, float aspect, float nearZ, float farZ)
+{
+	float f[3] = { forward[0], forward[1], forward[2] };
+	normalize(f);
+	float r[3];
+	cross(f, up, r);
+	normalize(r);
+	float u[3];
+	cross(r, f, u);
+
+	const float tanV = std::tan(fovY * 0.5f);
+	const float tanH = tanV * aspect;
+
+	CullingFrustum frustum;
+	auto setPlane = [&](int index, float nx, float ny, float nz, const float* through) {
+		float n[3] = { nx, ny, nz };
+		normalize(n);
+		frustum.planes[index][0] = n[0];
+		frustum.planes[index][1] = n[1];
+		frustum.planes[index][2] = n[2];
+		frustum.planes[index][3] = -dot(n, through);
+	};
+
+	float nearPoint[3] = { position[0] + f[0] * nearZ, position[1] + f[1] * nearZ, position[2] + f[2] * nearZ };
+	float farPoint[3] = { position[0] + f[0] * farZ, position[1] + f[1] * farZ, position[2] + f[2] * farZ };
+
+	setPlane(0, f[0], f[1], f[2], nearPoint);
+	setPlane(1, -f[0], -f[1], -f[2], farPoint);
+	//side planes contain the eye and one frustum edge, the normals point inwards
+	setPlane(2, f[0] * tanH + r[0], f[1] * tanH + r[1], f[2] * tanH + r[2], position);
+	setPlane(3, f[0] * tanH - r[0], f[1] * tanH - r[1], f[2] * tanH - r[2], position);
+	setPlane(4, f[0] * tanV + u[0], f[1] * tanV + u[1], f[2] * tanV + u[2], position);
+	setPlane(5, f[0] * tanV - u[0], f[1] * tanV - u[1], f[2] * tanV - u[2], position);
+
+	for (int k = 0; k < 3; ++k)
+		frustum.cameraPosition[k] = position[k];
+	return frustum;
+}
+
+void utils::cullMeshlets(const Meshlet* meshlets, size_t meshletCount, const CullingFrustum& frustum,
+	std::vector<IndexRange>& outRanges, MeshletCullStats* stats)
+{
+	for (size_t m = 0; m < meshletCount; ++m)
+	{
+		const Meshlet& meshlet = meshlets[m];
+		const uint64_t triangles = meshlet.indexCount / 3;
+		if (stats)
+		{
+			stats->meshlets++;
+			stats->triangles += triangles;
+		}
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+			outside = dot(frustum.planes[p], meshlet.center) + frustum.planes[p][3] < -meshlet.radius;
+		if (outside)
+		{
+			if (stats) stats->frustumCulledTriangles += triangles;
+			continue;
+		}
+
+		float view[3];
+		sub(meshlet.coneApex, frustum.cameraPosition, view);
+		normalize(view);
+		if (dot(view, meshlet.coneAxis) > meshlet.coneCutoff)
+		{
+			if (stats) stats->coneCulledTriangles += triangles;
+			continue;
+		}
+
+		if (!outRanges.empty() && outRanges.back().firstIndex + outRanges.back().indexCount == meshlet.firstIndex)
+			outRanges.back().indexCount += meshlet.indexCount;
+		else
+			outRanges.push_back({ meshlet.firstIndex, meshlet.indexCount });
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//import time clustering of meshes and cpu cluster culling, independent of vulkan
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+//a run of consecutive triangles in the mesh index buffer with its culling bounds
+//stored as is in the mesh cache, so only plain data in here
+struct Meshlet {
+	//relative to the mesh's own indices
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexCount;
+
+	float center[3];
+	float radius;
+	float boundsMin[3];
+	float boundsMax[3];
+
+	//every triangle faces away from a camera inside the cone behind the apex
+	//cutoff is sin of the cone half angle, 1 disables the test for clusters with too wide a spread of normals
+	float coneApex[3];
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+//inward facing planes (xyz normal, w distance) in mesh space
+struct CullingFrustum {
+	float planes[6][4];
+	float cameraPosition[3];
+};
+
+//drawable index range left after culling, neighbouring meshlets merged
+struct IndexRange {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+struct MeshletCullStats {
+	uint64_t meshlets = 0;
+	uint64_t triangles = 0;
+	uint64_t frustumCulledTriangles = 0;
+	uint64_t coneCulledTriangles = 0;
+};
+
+namespace utils {
+
+	//greedy scan over the triangles in index order, run it after the vertex cache and overdraw passes
+	//so the clusters follow their locality. positions are read with a byte stride
+	void buildMeshlets(const float* positions, size_t vertexCount, size_t positionStride,
+		const uint32_t* indices, size_t indexCount, std::vector<Meshlet>& outMeshlets);
+
+	//symmetric perspective frustum, forward and up don't need to be normalized
+	CullingFrustum makeFrustum(const float position[3], const float forward[3], const float up[3],
+		float fovY, float aspect, float nearZ, float farZ);
+
+	//sphere against the frustum planes, then the normal cone against the camera position
+	//appends the surviving ranges to outRanges, stats are accumulated when given
+	void cullMeshlets(const Meshlet* meshlets, size_t meshletCount, const CullingFrustum& frustum,
+		std::vector<IndexRange>& outRanges, MeshletCullStats* stats = nullptr);
+
+}
@@ -0,0 +1,184 @@
+#include "MipGenerator.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_USE_SSE2 1
+#endif
+
+//linear -> srgb table resolution, 14 bits keeps the error near black under a quarter of an 8 bit step
+static const uint32_t SRGB_ENCODE_BITS = 14;
+static const uint32_t SRGB_ENCODE_SIZE = 1u << SRGB_ENCODE_BITS;
+
+struct ColourTables {
+	float srgbToLinear[256];
+	float unormToFloat[256];
+	unsigned char linearToSrgb[SRGB_ENCODE_SIZE];
+
+	ColourTables()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			float c = i / 255.0f;
+			srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			unormToFloat[i] = c;
+		}
+		for (uint32_t i = 0; i < SRGB_ENCODE_SIZE; ++i)
+		{
+			float l = i / float(SRGB_ENCODE_SIZE - 1);
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			linearToSrgb[i] = static_cast<unsigned char>(std::min(255.0f, c * 255.0f + 0.5f));
+		}
+	}
+};
+
+static const ColourTables& colourTables()
+{
+	static const ColourTables tables;
+	return tables;
+}
+
+bool mipKernelSupported(MipKernel kernel)
+{
+	if (kernel != MipKernel::SSE2)
+		return true;
+#ifdef MIP_USE_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	uint32_t size = std::max(width, height);
+	while (size > 1)
+	{
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+//8 bit rgba row to float, colour through the given table, alpha always unorm
+static void decodeRow(const unsigned char* src, uint32_t width, const float* colourTable, const float* alphaTable, float* out)
+{
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		out[0] = colourTable[src[0]];
+		out[1] = colourTable[src[1]];
+		out[2] = colourTable[src[2]];
+		out[3] = alphaTable[src[3]];
+		src += 4;
+		out += 4;
+	}
+}
+
+//one 2x2 box step, odd edges clamp so the last row / column is reused
+//source rows are decoded once into float scratch rows, the filter itself runs on whole rgba vectors
+template<bool UseSSE2>
+static void downsample(const unsigned char* src, uint32_t srcWidth, uint32_t srcHeight,
+	unsigned char* dst, uint32_t dstWidth, uint32_t dstHeight, bool srgb, std::vector<float>& scratch)
+{
+	const ColourTables& tables = colourTables();
+	const float* toFloat = srgb ? tables.srgbToLinear : tables.unormToFloat;
+	const float encodeScale = srgb ? float(SRGB_ENCODE_SIZE - 1) : 255.0f;
+
+	//one extra texel per row so odd widths can read the clamped neighbour without a branch
+	const size_t rowFloats = (size_t(srcWidth) + 1) * 4;
+	scratch.resize(rowFloats * 2);
+	float* row0 = scratch.data();
+	float* row1 = scratch.data() + rowFloats;
+
+	//rgb go through the encode table (or straight to 8 bit), alpha is always unorm
+	const float scale[4] = { encodeScale * 0.25f, encodeScale * 0.25f, encodeScale * 0.25f, 255.0f * 0.25f };
+#ifdef MIP_USE_SSE2
+	const __m128 scaleSSE2 = _mm_loadu_ps(scale);
+#endif
+
+	for (uint32_t y = 0; y < dstHeight; ++y)
+	{
+		uint32_t y0 = std::min(2 * y, srcHeight - 1);
+		uint32_t y1 = std::min(2 * y + 1, srcHeight - 1);
+		decodeRow(src + size_t(y0) * srcWidth * 4, srcWidth, toFloat, tables.unormToFloat, row0);
+		decodeRow(src + size_t(y1) * srcWidth * 4, srcWidth, toFloat, tables.unormToFloat, row1);
+		memcpy(row0 + size_t(srcWidth) * 4, row0 + size_t(srcWidth - 1) * 4, 4 * sizeof(float));
+		memcpy(row1 + size_t(srcWidth) * 4, row1 + size_t(srcWidth - 1) * 4, 4 * sizeof(float));
+
+		unsigned char* out = dst + size_t(y) * dstWidth * 4;
+		for (uint32_t x = 0; x < dstWidth; ++x)
+		{
+			const float* a = row0 + size_t(x) * 8;
+			const float* b = row1 + size_t(x) * 8;
+
+			int32_t encoded[4];
+#ifdef MIP_USE_SSE2
+			if constexpr (UseSSE2)
+			{
+				__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(a + 4)),
+					_mm_add_ps(_mm_loadu_ps(b), _mm_loadu_ps(b + 4)));
+				//cvtps rounds to nearest with the default rounding mode
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(encoded), _mm_cvtps_epi32(_mm_mul_ps(sum, scaleSSE2)));
+			}
+			else
+#endif
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					encoded[c] = static_cast<int32_t>((a[c] + a[c + 4] + b[c] + b[c + 4]) * scale[c] + 0.5f);
+				}
+			}
+			if (srgb)
+			{
+				out[0] = tables.linearToSrgb[encoded[0]];
+				out[1] = tables.linearToSrgb[encoded[1]];
+				out[2] = tables.linearToSrgb[encoded[2]];
+			}
+			else
+			{
+				out[0] = static_cast<unsigned char>(encoded[0]);
+				out[1] = static_cast<unsigned char>(encoded[1]);
+				out[2] = static_cast<unsigned char>(encoded[2]);
+			}
+			out[3] = static_cast<unsigned char>(encoded[3]);
+			out += 4;
+		}
+	}
+}
+
+uint64_t generateMipChain(const unsigned char* rgba, uint32_t width, uint32_t height, bool srgb, MipChain& out, MipKernel kernel)
+{
+	const bool useSSE2 = mipKernelSupported(MipKernel::SSE2) && kernel != MipKernel::Scalar;
+
+	uint32_t levelCount = mipLevelCount(width, height);
+
+	out.levels.resize(levelCount);
+	size_t total = 0;
+	uint32_t w = width, h = height;
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		out.levels[i] = MipLevel{ total, w, h };
+		total += size_t(w) * h * 4;
+		w = std::max(1u, w >> 1);
+		h = std::max(1u, h >> 1);
+	}
+
+	out.data.resize(total);
+	memcpy(out.data.data(), rgba, size_t(width) * height * 4);
+
+	std::vector<float> scratch;
+	uint64_t filtered = 0;
+	for (uint32_t i = 1; i < levelCount; ++i)
+	{
+		const MipLevel& src = out.levels[i - 1];
+		const MipLevel& dst = out.levels[i];
+		auto filter = useSSE2 ? downsample<true> : downsample<false>;
+		filter(out.data.data() + src.offset, src.width, src.height,
+			out.data.data() + dst.offset, dst.width, dst.height, srgb, scratch);
+		filtered += uint64_t(src.width) * src.height;
+	}
+	return filtered;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct MipLevel {
+	size_t offset;
+	uint32_t width;
+	uint32_t height;
+};
+
+//rgba8 mip chain, all levels packed back to back in data
+struct MipChain {
+	std::vector<unsigned char> data;
+	std::vector<MipLevel> levels;
+
+	uint32_t levelCount() const { return static_cast<uint32_t>(levels.size()); }
+	const unsigned char* level(uint32_t i) const { return data.data() + levels[i].offset; }
+};
+
+//filter implementations, Best is the fastest one the build supports
+enum class MipKernel { Best, Scalar, SSE2 };
+
+//SSE2 needs an x64 build or /arch:SSE2 on x86
+bool mipKernelSupported(MipKernel kernel);
+
+//floor(log2(max(width, height))) + 1
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+//builds the full chain down to 1x1 with a 2x2 box filter
+//with srgb set, colour is averaged in linear space and alpha stays linear
+//returns the number of source pixels filtered, for throughput stats
+//an unsupported kernel falls back to the scalar one
+uint64_t generateMipChain(const unsigned char* rgba, uint32_t width, uint32_t height, bool srgb, MipChain& out,
+	MipKernel kernel = MipKernel::Best);
@@ -0,0 +1,301 @@
+#include "PipelineBuilder.h"
+#include "Renderer.h"
+#include "ShaderUtilities.h"
+#include "Hash.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+static bool hasDynamicState(const GraphicsPipelineDesc& desc, VkDynamicState state)
+{
+	return std::find(desc.dynamicStates.begin(), desc.dynamicStates.end(), state) != desc.dynamicStates.end();
+}
+
+template<typename T>
+static uint64_t hashVector(const std::vector<T>& values, uint64_t hash)
+{
+	uint64_t count = values.size();
+	hash = hashFNV1a(&count, sizeof(count), hash);
+	return hashFNV1a(values.data(), values.size() * sizeof(T), hash);
+}
+
+//the vulkan structs compared here are all 32 bit members, no padding
+template<typename T>
+static bool equalVectors(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+uint64_t hashPipelineDesc(const GraphicsPipelineDesc& desc)
+{
+	uint64_t hash = hashFNV1a(desc.vertexShader);
+	hash = hashFNV1a(desc.fragmentShader, hash);
+	hash = hashVector(desc.bindings, hash);
+	hash = hashVector(desc.attributes, hash);
+	hash = hashFNV1a(&desc.topology, sizeof(desc.topology), hash);
+	if (!hasDynamicState(desc, VK_DYNAMIC_STATE_VIEWPORT))
+		hash = hashFNV1a(&desc.viewport, sizeof(desc.viewport), hash);
+	if (!hasDynamicState(desc, VK_DYNAMIC_STATE_SCISSOR))
+		hash = hashFNV1a(&desc.scissor, sizeof(desc.scissor), hash);
+	hash = hashFNV1a(&desc.cullMode, sizeof(desc.cullMode), hash);
+	hash = hashFNV1a(&desc.frontFace, sizeof(desc.frontFace), hash);
+	uint32_t depth = (desc.depthTest ? 1u : 0u) | (desc.depthWrite ? 2u : 0u);
+	hash = hashFNV1a(&depth, sizeof(depth), hash);
+	hash = hashFNV1a(&desc.depthCompare, sizeof(desc.depthCompare), hash);
+	hash = hashVector(desc.blendAttachments, hash);
+	hash = hashVector(desc.dynamicStates, hash);
+	hash = hashFNV1a(&desc.layout, sizeof(desc.layout), hash);
+	if (desc.renderPassKey != 0)
+		hash = hashFNV1a(&desc.renderPassKey, sizeof(desc.renderPassKey), hash);
+	else
+		hash = hashFNV1a(&desc.renderPass, sizeof(desc.renderPass), hash);
+	return hashFNV1a(&desc.subpass, sizeof(desc.subpass), hash);
+}
+
+bool operator==(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b)
+{
+	if (a.vertexShader != b.vertexShader || a.fragmentShader != b.fragmentShader ||
+		!equalVectors(a.bindings, b.bindings) || !equalVectors(a.attributes, b.attributes) ||
+		a.topology != b.topology || a.cullMode != b.cullMode || a.frontFace != b.frontFace ||
+		a.depthTest != b.depthTest || a.depthWrite != b.depthWrite || a.depthCompare != b.depthCompare ||
+		!equalVectors(a.blendAttachments, b.blendAttachments) || !equalVectors(a.dynamicStates, b.dynamicStates) ||
+		a.layout != b.layout || a.renderPassKey != b.renderPassKey || a.subpass != b.subpass)
+	{
+		return false;
+	}
+
+	if (a.renderPassKey == 0 && a.renderPass != b.renderPass)
+		return false;
+	if (!hasDynamicState(a, VK_DYNAMIC_STATE_VIEWPORT) && memcmp(&a.viewport, &b.viewport, sizeof(a.viewport)) != 0)
+		return false;
+	if (!hasDynamicState(a, VK_DYNAMIC_STATE_SCISSOR) && memcmp(&a.scissor, &b.scissor, sizeof(a.scissor)) != 0)
+		return false;
+	return true;
+}
+
+VkPipelineColorBlendAttachmentState opaqueBlendAttachment()
+{
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	return colorBlendAttachment;
+}
+
+PipelineBuilder::PipelineBuilder(Vulkan_Backend& backend) : m_backend{ backend }
+{
+}
+
+PipelineBuilder::~PipelineBuilder()
+{
+	waitAll();
+
+	printStats();
+
+	for (Request& request : m_requests)
+	{
+		if (!request.taken && request.pipeline != VK_NULL_HANDLE)
+			vkDestroyPipeline(m_backend.m_device, request.pipeline, nullptr);
+	}
+}
+
+PipelineTicket PipelineBuilder::compile(const GraphicsPipelineDesc& desc)
+{
+	Request* request;
+	PipelineTicket ticket;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_requests.empty())
+			m_firstCompile = std::chrono::steady_clock::now();
+		m_requests.emplace_back();
+		request = &m_requests.back();
+		request->desc = desc;
+		ticket = static_cast<PipelineTicket>(m_requests.size() - 1);
+	}
+
+	m_backend.m_jobs->submit([this, request]() {
+		auto start = std::chrono::steady_clock::now();
+		try {
+			request->pipeline = build(m_backend, request->desc);
+		}
+		catch (...) {
+			request->error = std::current_exception();
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		request->milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		m_compileNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+
+		uint64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_firstCompile).count();
+		uint64_t previous = m_wallNanoseconds.load(std::memory_order_relaxed);
+		while (previous < wall && !m_wallNanoseconds.compare_exchange_weak(previous, wall, std::memory_order_relaxed)) {}
+	}, &request->counter);
+
+	return ticket;
+}
+
+bool PipelineBuilder::isReady(PipelineTicket ticket) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_requests[ticket].counter.done();
+}
+
+VkPipeline PipelineBuilder::wait(PipelineTicket ticket)
+{
+	Request* request;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		request = &m_requests[ticket];
+	}
+
+	m_backend.m_jobs->wait(request->counter);
+	if (request->error)
+		std::rethrow_exception(request->error);
+	if (request->taken)
+		throw std::runtime_error("pipeline " + request->desc.name + " was already taken");
+	request->taken = true;
+	return request->pipeline;
+}
+
+void PipelineBuilder::waitAll()
+{
+	//not under the lock, waiting runs other jobs and those may compile more pipelines
+	std::vector<Request*> requests;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Request& request : m_requests)
+			requests.push_back(&request);
+	}
+	for (Request* request : requests)
+		m_backend.m_jobs->wait(request->counter);
+}
+
+VkPipeline PipelineBuilder::build(Vulkan_Backend& backend, const GraphicsPipelineDesc& desc)
+{
+	VkDevice device = backend.m_device;
+
+	VkShaderModule vertShaderModule = createShaderModule(readFile(desc.vertexShader), device);
+	VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+	try {
+		fragShaderModule = createShaderModule(readFile(desc.fragmentShader), device);
+	}
+	catch (...) {
+		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		throw;
+	}
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings.size());
+	vertexInputInfo.pVertexBindingDescriptions = desc.bindings.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes.size());
+	vertexInputInfo.pVertexAttributeDescriptions = desc.attributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = desc.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = &desc.viewport;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = &desc.scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = desc.cullMode;
+	rasterizer.frontFace = desc.frontFace;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling.minSampleShading = 1.0f;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = desc.depthCompare;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.minDepthBounds = 0.0f;
+	depthStencil.maxDepthBounds = 1.0f;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	colorBlending.attachmentCount = static_cast<uint32_t>(desc.blendAttachments.size());
+	colorBlending.pAttachments = desc.blendAttachments.data();
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(desc.dynamicStates.size());
+	dynamicState.pDynamicStates = desc.dynamicStates.data();
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = desc.depthTest || desc.depthWrite ? &depthStencil : nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = desc.dynamicStates.empty() ? nullptr : &dynamicState;
+	pipelineInfo.layout = desc.layout;
+	pipelineInfo.renderPass = desc.renderPass;
+	pipelineInfo.subpass = desc.subpass;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = backend.m_pipelineCache.createGraphicsPipelines(1, &pipelineInfo, &pipeline);
+
+	//modules are only needed while the pipeline is created
+	vkDestroyShaderModule(device, fragShaderModule, nullptr);
+	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("failed to create pipeline " + desc.name);
+	return pipeline;
+}
+
+void PipelineBuilder::printStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_requests.empty())
+		return;
+
+	std::cout << "[PIPELINES]: " << m_requests.size() << " compiled on the job system, "
+		<< m_compileNanoseconds.load() / 1.0e6 << " ms of compiling in "
+		<< m_wallNanoseconds.load() / 1.0e6 << " ms wall time" << std::endl;
+	for (const Request& request : m_requests)
+		std::cout << "\t" << request.desc.name << ": " << request.milliseconds << " ms" << std::endl;
+}
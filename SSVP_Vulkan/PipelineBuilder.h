@@ -0,0 +1,112 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "JobSystem.h"
+
+class Vulkan_Backend;
+
+//everything a graphics pipeline is built from, held by value so it can be compiled on another thread
+//after the code that described it returned. hashable and comparable, see PipelineStateCache
+struct GraphicsPipelineDesc {
+	//for the stats and error messages, not part of the identity
+	std::string name;
+	//spir-v paths, entry point is main. the identity is the path, not the code
+	std::string vertexShader;
+	std::string fragmentShader;
+
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	//ignored (and not part of the identity) when the matching dynamic state is set
+	VkViewport viewport{};
+	VkRect2D scissor{};
+
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+	//no depth stencil state at all when neither is set
+	bool depthTest = false;
+	bool depthWrite = false;
+	VkCompareOp depthCompare = VK_COMPARE_OP_LESS;
+
+	//one per color attachment of the subpass
+	std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+	//no dynamic state at all when empty
+	std::vector<VkDynamicState> dynamicStates;
+
+	//part of the identity by handle, a cached pipeline must not outlive its layout
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	//render pass compatibility (attachment formats and samples) instead of the handle, so a render pass
+	//recreated identically finds the old pipelines. 0 uses the handle
+	uint64_t renderPassKey = 0;
+	uint32_t subpass = 0;
+};
+
+uint64_t hashPipelineDesc(const GraphicsPipelineDesc& desc);
+//same identity as hashPipelineDesc, the name is ignored
+bool operator==(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b);
+inline bool operator!=(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b) { return !(a == b); }
+
+//color write of all channels, no blending
+VkPipelineColorBlendAttachmentState opaqueBlendAttachment();
+
+//index of a pipeline handed to a PipelineBuilder
+typedef uint32_t PipelineTicket;
+
+//compiles graphics pipelines on the job system, shader module creation included. the pipeline
+//cache is internally synchronized, so any number of compiles run at once against it.
+//callers keep their ticket and only wait for the pipeline when they are about to record with it,
+//so startup work (asset loading, descriptor setup) and other compiles overlap the driver's compiler
+class PipelineBuilder {
+public:
+	PipelineBuilder(Vulkan_Backend& backend);
+	PipelineBuilder(const PipelineBuilder&) = delete;
+	PipelineBuilder& operator=(const PipelineBuilder&) = delete;
+	//waits for every compile in flight, pipelines not taken by anyone are destroyed
+	~PipelineBuilder();
+
+	//starts compiling right away
+	PipelineTicket compile(const GraphicsPipelineDesc& desc);
+
+	bool isReady(PipelineTicket ticket) const;
+	//helps out on the job system until the pipeline exists, rethrows if its compile failed.
+	//the caller owns the returned pipeline, a ticket can be waited on once
+	VkPipeline wait(PipelineTicket ticket);
+	//errors are left for wait on the failed ticket
+	void waitAll();
+
+	void printStats() const;
+
+private:
+	struct Request {
+		GraphicsPipelineDesc desc;
+		JobCounter counter;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		bool taken = false;
+		double milliseconds = 0.0;
+		//kept for wait on this ticket, waitAll doesn't throw
+		std::exception_ptr error;
+	};
+
+	static VkPipeline build(Vulkan_Backend& backend, const GraphicsPipelineDesc& desc);
+
+	Vulkan_Backend& m_backend;
+	//references stay valid while requests are appended
+	std::deque<Request> m_requests;
+	mutable std::mutex m_mutex;
+
+	std::chrono::steady_clock::time_point m_firstCompile;
+	std::atomic<uint64_t> m_compileNanoseconds{ 0 };
+	//first submission to the last finished compile
+	std::atomic<uint64_t> m_wallNanoseconds{ 0 };
+};
@@ -0,0 +1,157 @@
+#include "PipelineCache.h"
+#include "Renderer.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+static const char PIPELINE_CACHE_MAGIC[4] = { 'S', 'S', 'P', 'C' };
+
+void PipelineCache::init(Vulkan_Backend& backend, const std::string& path)
+{
+	m_backend = &backend;
+	m_path = path;
+
+	MappedFile file;
+	const char* initialData = nullptr;
+	size_t initialSize = 0;
+	if (file.open(path))
+	{
+		if (validate(file.data(), file.size()))
+		{
+			initialData = file.data() + sizeof(PipelineCacheFileHeader);
+			initialSize = file.size() - sizeof(PipelineCacheFileHeader);
+		}
+		else
+		{
+			std::cout << "[PIPELINES]: " << path << " is stale or from another device, starting cold" << std::endl;
+		}
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = initialSize;
+	cacheInfo.pInitialData = initialData;
+
+	VkResult result = vkCreatePipelineCache(backend.m_device, &cacheInfo, nullptr, &m_cache);
+	if (result != VK_SUCCESS && initialSize > 0)
+	{
+		//the driver may still refuse data that passed the header checks
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+		initialSize = 0;
+		result = vkCreatePipelineCache(backend.m_device, &cacheInfo, nullptr, &m_cache);
+	}
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("failed to create pipeline cache");
+
+	m_warm = initialSize > 0;
+	m_loadedBytes = initialSize;
+}
+
+void PipelineCache::cleanUp()
+{
+	if (m_cache == VK_NULL_HANDLE)
+		return;
+
+	printStats();
+	if (!save())
+		std::cout << "[PIPELINES]: failed to write " << m_path << std::endl;
+
+	vkDestroyPipelineCache(m_backend->m_device, m_cache, nullptr);
+	m_cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::validate(const char* data, size_t size) const
+{
+	if (size < sizeof(PipelineCacheFileHeader))
+		return false;
+
+	PipelineCacheFileHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != PIPELINE_CACHE_FILE_VERSION ||
+		header.dataSize != size - sizeof(PipelineCacheFileHeader))
+	{
+		return false;
+	}
+
+	const char* blob = data + sizeof(PipelineCacheFileHeader);
+	if (hashFNV1a(blob, header.dataSize) != header.dataHash)
+		return false;
+
+	//VkPipelineCacheHeaderVersionOne: header size, header version, vendor id, device id, cache uuid
+	uint32_t blobHeader[4];
+	if (header.dataSize < sizeof(blobHeader) + VK_UUID_SIZE)
+		return false;
+	memcpy(blobHeader, blob, sizeof(blobHeader));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_backend->m_physicalDevice, &properties);
+
+	return blobHeader[0] >= sizeof(blobHeader) + VK_UUID_SIZE &&
+		blobHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		blobHeader[2] == properties.vendorID &&
+		blobHeader[3] == properties.deviceID &&
+		memcmp(blob + sizeof(blobHeader), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::save()
+{
+	size_t size = 0;
+	if (vkGetPipelineCacheData(m_backend->m_device, m_cache, &size, nullptr) != VK_SUCCESS || size == 0)
+		return false;
+
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(m_backend->m_device, m_cache, &size, data.data()) != VK_SUCCESS)
+		return false;
+
+	PipelineCacheFileHeader header{};
+	memcpy(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = PIPELINE_CACHE_FILE_VERSION;
+	header.dataSize = size;
+	header.dataHash = hashFNV1a(data.data(), size);
+
+	//written next to the old file first, a crash mid write must not leave a half blob behind
+	std::string tempPath = m_path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(data.data(), static_cast<std::streamsize>(size));
+		if (!out.good())
+			return false;
+	}
+
+	std::remove(m_path.c_str());
+	return std::rename(tempPath.c_str(), m_path.c_str()) == 0;
+}
+
+VkResult PipelineCache::createGraphicsPipelines(uint32_t count, const VkGraphicsPipelineCreateInfo* infos, VkPipeline* outPipelines)
+{
+	auto start = std::chrono::steady_clock::now();
+	VkResult result = vkCreateGraphicsPipelines(m_backend->m_device, m_cache, count, infos, nullptr, outPipelines);
+	m_createNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+	m_pipelineCount.fetch_add(count, std::memory_order_relaxed);
+	return result;
+}
+
+void PipelineCache::printStats() const
+{
+	uint32_t pipelines = m_pipelineCount.load(std::memory_order_relaxed);
+	double milliseconds = m_createNanoseconds.load(std::memory_order_relaxed) / 1.0e6;
+
+	std::cout << "[PIPELINES]: " << (m_warm ? "warm" : "cold") << " cache";
+	if (m_warm)
+		std::cout << " (" << m_loadedBytes / 1024 << " KB loaded)";
+	std::cout << ", " << pipelines << " pipelines created in " << milliseconds << " ms";
+	if (pipelines > 0)
+		std::cout << ", " << milliseconds / pipelines << " ms each";
+	std::cout << std::endl;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+class Vulkan_Backend;
+
+//bump PIPELINE_CACHE_FILE_VERSION whenever the file layout changes
+const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+//in front of the driver's blob, a truncated or foreign file is dropped before the driver sees it
+struct PipelineCacheFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t dataSize;
+	uint64_t dataHash;
+};
+
+//one VkPipelineCache per device, shared by every pipeline creation. loaded from disk at init and
+//written back at cleanUp. a blob from another vendor, device or driver (pipelineCacheUUID) is
+//ignored and the cache starts cold
+class PipelineCache {
+public:
+	void init(Vulkan_Backend& backend, const std::string& path);
+	//saves, then destroys the cache. pipelines created from it stay valid
+	void cleanUp();
+
+	//false if the blob couldn't be written, the old file is kept then
+	bool save();
+
+	VkPipelineCache handle() const { return m_cache; }
+	//a valid blob was loaded at init
+	bool isWarm() const { return m_warm; }
+
+	//vkCreateGraphicsPipelines against the shared cache, timed for the stats. callable from any thread
+	VkResult createGraphicsPipelines(uint32_t count, const VkGraphicsPipelineCreateInfo* infos, VkPipeline* outPipelines);
+
+	void printStats() const;
+
+private:
+	//checks the wrapper and the driver's own header against the current device
+	bool validate(const char* data, size_t size) const;
+
+	Vulkan_Backend* m_backend = nullptr;
+	VkPipelineCache m_cache = VK_NULL_HANDLE;
+	std::string m_path;
+	bool m_warm = false;
+	size_t m_loadedBytes = 0;
+
+	std::atomic<uint32_t> m_pipelineCount{ 0 };
+	std::atomic<uint64_t> m_createNanoseconds{ 0 };
+};
@@ -0,0 +1,103 @@
+#include "PipelineStateCache.h"
+#include "Renderer.h"
+#include <iostream>
+#include <algorithm>
+
+PipelineStateCache::PipelineStateCache(Vulkan_Backend& backend, PipelineBuilder& builder) : m_backend{ backend }, m_builder{ builder }
+{
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+	printStats();
+
+	for (Entry& entry : m_entries)
+	{
+		std::lock_guard<std::mutex> lock(entry.mutex);
+		if (entry.pipeline == VK_NULL_HANDLE)
+		{
+			//still compiling or failed, either way nobody took it from the builder yet
+			try {
+				entry.pipeline = m_builder.wait(entry.ticket);
+			}
+			catch (...) {
+			}
+		}
+		if (entry.pipeline != VK_NULL_HANDLE)
+			vkDestroyPipeline(m_backend.m_device, entry.pipeline, nullptr);
+	}
+}
+
+PipelineStateId PipelineStateCache::request(const GraphicsPipelineDesc& desc)
+{
+	uint64_t hash = hashPipelineDesc(desc);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<PipelineStateId>& bucket = m_lookup[hash];
+	for (PipelineStateId id : bucket)
+	{
+		if (m_entries[id].desc == desc)
+		{
+			m_hits++;
+			return id;
+		}
+	}
+
+	m_misses++;
+	m_entries.emplace_back();
+	Entry& entry = m_entries.back();
+	entry.desc = desc;
+	entry.requested = std::chrono::steady_clock::now();
+	entry.ticket = m_builder.compile(desc);
+
+	PipelineStateId id = static_cast<PipelineStateId>(m_entries.size() - 1);
+	bucket.push_back(id);
+	return id;
+}
+
+VkPipeline PipelineStateCache::get(PipelineStateId id)
+{
+	Entry* entry;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		entry = &m_entries[id];
+	}
+
+	std::lock_guard<std::mutex> lock(entry->mutex);
+	if (entry->pipeline != VK_NULL_HANDLE)
+		return entry->pipeline;
+
+	//a failed compile throws here, and again for every later get of the same id
+	entry->pipeline = m_builder.wait(entry->ticket);
+
+	//latency as seen by the pass, a compile that finished long before it was needed counts up to the first get
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - entry->requested).count();
+	{
+		std::lock_guard<std::mutex> statsLock(m_mutex);
+		m_resolved++;
+		m_compileMilliseconds += milliseconds;
+		m_maxCompileMilliseconds = std::max(m_maxCompileMilliseconds, milliseconds);
+	}
+	return entry->pipeline;
+}
+
+PipelineStateStats PipelineStateCache::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	PipelineStateStats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.averageCompileMilliseconds = m_resolved > 0 ? m_compileMilliseconds / m_resolved : 0.0;
+	stats.maxCompileMilliseconds = m_maxCompileMilliseconds;
+	return stats;
+}
+
+void PipelineStateCache::printStats() const
+{
+	PipelineStateStats stats = getStats();
+	if (stats.hits + stats.misses == 0)
+		return;
+
+	std::cout << "[PSO]: " << stats.hits << " hits, " << stats.misses << " misses, "
+		<< stats.averageCompileMilliseconds << " ms average / " << stats.maxCompileMilliseconds << " ms max compile latency" << std::endl;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include "PipelineBuilder.h"
+
+class Vulkan_Backend;
+
+//index of a cached pipeline, stays valid for the cache's lifetime
+typedef uint32_t PipelineStateId;
+
+struct PipelineStateStats {
+	uint64_t hits = 0;
+	//each miss is one compile
+	uint64_t misses = 0;
+	//request to the pipeline being usable, over resolved misses
+	double averageCompileMilliseconds = 0.0;
+	double maxCompileMilliseconds = 0.0;
+};
+
+//runtime pipeline cache keyed by hashPipelineDesc. an identical desc returns the pipeline built
+//for the first one, missing ones are compiled on demand through the PipelineBuilder.
+//the cache owns every pipeline it hands out, passes only borrow them, so a pass recreated with the
+//same state (e.g. after a swap chain resize) doesn't compile anything
+class PipelineStateCache {
+public:
+	PipelineStateCache(Vulkan_Backend& backend, PipelineBuilder& builder);
+	PipelineStateCache(const PipelineStateCache&) = delete;
+	PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+	~PipelineStateCache();
+
+	//finds the pipeline or starts compiling it, never blocks
+	PipelineStateId request(const GraphicsPipelineDesc& desc);
+	//blocks until the pipeline is compiled, rethrows if that failed
+	VkPipeline get(PipelineStateId id);
+	VkPipeline get(const GraphicsPipelineDesc& desc) { return get(request(desc)); }
+
+	PipelineStateStats getStats() const;
+	void printStats() const;
+
+private:
+	struct Entry {
+		GraphicsPipelineDesc desc;
+		PipelineTicket ticket;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::chrono::steady_clock::time_point requested;
+		//serializes taking the pipeline from the builder
+		std::mutex mutex;
+	};
+
+	Vulkan_Backend& m_backend;
+	PipelineBuilder& m_builder;
+
+	mutable std::mutex m_mutex;
+	std::deque<Entry> m_entries;
+	//desc hash to entry ids, collisions are told apart with operator==
+	std::unordered_map<uint64_t, std::vector<PipelineStateId>> m_lookup;
+
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+	uint64_t m_resolved = 0;
+	double m_compileMilliseconds = 0.0;
+	double m_maxCompileMilliseconds = 0.0;
+};
@@ -1,8 +1,11 @@
 #include "Primitives.h"
+#include "MaterialTable.h"
+#include "VertexPacking.h"
 //#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h" 
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
 
 VkVertexInputBindingDescription getBindingDescription() {
 	VkVertexInputBindingDescription bindingDescription{};
@@ -44,6 +47,36 @@ std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions() {
 	return attributeDescriptions;
 }
 
+VkVertexInputBindingDescription getPackedBindingDescription() {
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(packedVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 3> getPackedAttributeDescriptions() {
+	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+	attributeDescriptions[0].offset = offsetof(packedVertex, pos);
+
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+	attributeDescriptions[1].offset = offsetof(packedVertex, uv);
+
+	attributeDescriptions[2].binding = 0;
+	attributeDescriptions[2].location = 2;
+	attributeDescriptions[2].format = VK_FORMAT_R16G16B16A16_SNORM;
+	attributeDescriptions[2].offset = offsetof(packedVertex, qtangent);
+
+	return attributeDescriptions;
+}
+
 void Texture::setupTexture(Vulkan_Backend& backend)
 {
 	int texWidth, texHeight, texChannels;
@@ -54,38 +87,49 @@ void Texture::setupTexture(Vulkan_Backend& backend)
 	{
 		std::cout << "Texture failed to load at path: " << this->path.c_str() << std::endl;
 		std::cout << stbi_failure_reason() << std::endl;
-		stbi_image_free(pixels);
+		createFromPixels(backend, nullptr, 0, 0);
+		return;
 	}
 
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	createBuffer(backend, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(backend.m_device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(backend.m_device, stagingBufferMemory);
+	createFromPixels(backend, pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
 
 	stbi_image_free(pixels);
+}
 
-	createImage(backend, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, img, imgMem);
+void Texture::createFromPixels(Vulkan_Backend& backend, const unsigned char* pixels, uint32_t texWidth, uint32_t texHeight)
+{
+	//textures that failed to decode still get a valid 1x1 white image, so descriptors never point at nothing
+	static const unsigned char fallbackPixel[4] = { 255, 255, 255, 255 };
+	if (!pixels)
+	{
+		pixels = fallbackPixel;
+		texWidth = 1;
+		texHeight = 1;
+	}
 
-	transitionImageLayout(backend, img, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	MipChain mips;
+	generateMipChain(pixels, texWidth, texHeight, true, mips);
+	createFromMipChain(backend, mips);
+}
 
-	copyBufferToImage(backend, stagingBuffer,img, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+void Texture::createFromMipChain(Vulkan_Backend& backend, const MipChain& mips)
+{
+	mipLevels = mips.levelCount();
 
-	transitionImageLayout(backend, img, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	createImage(backend, mips.levels[0].width, mips.levels[0].height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, img, imgMem, mipLevels);
 
-	vkDestroyBuffer(backend.m_device, stagingBuffer, nullptr);
-	vkFreeMemory(backend.m_device, stagingBufferMemory, nullptr);
+	//whole chain goes out in the same batch
+	UploadContext& uploader = backend.m_uploader;
+	uploader.transitionImageLayout(img, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+	for (uint32_t level = 0; level < mipLevels; ++level)
+	{
+		uploader.uploadImage(img, mips.level(level), mips.levels[level].width, mips.levels[level].height, 4, level);
+	}
+	uploader.transitionImageLayout(img, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+	uploadToken = uploader.currentToken();
 
-	imgView = createImageView(backend, img, VK_FORMAT_R8G8B8A8_SRGB);
+	imgView = createImageView(backend, img, VK_FORMAT_R8G8B8A8_SRGB, mipLevels);
 
 	//create sampler
 
@@ -111,7 +155,7 @@ void Texture::setupTexture(Vulkan_Backend& backend)
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(mipLevels);
 
 	auto res = vkCreateSampler(backend.m_device, &samplerInfo, nullptr, &imgSampler);
 	if (res != VK_SUCCESS) {
@@ -122,84 +166,115 @@ void Texture::setupTexture(Vulkan_Backend& backend)
 	imgDescriptor.imageView = imgView;
 	imgDescriptor.sampler = imgSampler;
 
-
+	resident.store(true, std::memory_order_release);
 }
 
-void Material::CreateMaterial(Vulkan_Backend& backend, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout)
+void Texture::destroyTexture(Vulkan_Backend& backend)
 {
-	VkDescriptorSetAllocateInfo allocateInfo{};	
-
-	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocateInfo.descriptorPool = descriptorPool;
-	allocateInfo.pSetLayouts = &descriptorSetLayout;
-	allocateInfo.descriptorSetCount = 1;
-
-	auto res = vkAllocateDescriptorSets(backend.m_device,
-		&allocateInfo,
-		&matDescriptorSet
-		);
-
-	if (res != VK_SUCCESS) throw std::runtime_error("failed to create material descriptor set");
+	if (!resident.load(std::memory_order_acquire))
+		return;
 
-	std::vector<VkDescriptorImageInfo> imageDescriptors{};
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
-
-	imageDescriptors.push_back(diffuse->imgDescriptor);
-	
-	VkWriteDescriptorSet writeDescSet{};
-	writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	writeDescSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	writeDescSet.descriptorCount = 1;
-	writeDescSet.dstSet = matDescriptorSet;
-	writeDescSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-	writeDescSet.pImageInfo = &diffuse->imgDescriptor;
-	
-	writeDescriptorSets.push_back(writeDescSet);
+	vkDestroySampler(backend.m_device, imgSampler, nullptr);
+	vkDestroyImageView(backend.m_device, imgView, nullptr);
+	destroyImage(backend, img, imgMem);
+}
 
-	vkUpdateDescriptorSets(backend.m_device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+void Material::CreateMaterial(Vulkan_Backend& backend)
+{
+	id = backend.m_materials->add(*this);
 }
 
 void Mesh::SetupMesh(Vulkan_Backend& backend)
 {
-	// setup vertex buffer //
-	VkDeviceSize bufferSize = sizeof(vertices[0])*vertices.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	createBuffer(backend ,bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void *data;
-	vkMapMemory(backend.m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(backend.m_device, stagingBufferMemory);
-	
-	createBuffer(backend, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+	uint32_t numVertices = static_cast<uint32_t>(vertices.size());
+	uint32_t numIndices = static_cast<uint32_t>(indices.size());
+	if (numVertices > MAX_UINT16_INDEXED_VERTICES)
+	{
+		SetupMesh(backend, vertices.data(), numVertices, indices.data(), numIndices, VK_INDEX_TYPE_UINT32);
+		return;
+	}
 
+	std::vector<uint16_t> narrowIndices(numIndices);
+	for (uint32_t i = 0; i < numIndices; ++i)
+		narrowIndices[i] = static_cast<uint16_t>(indices[i]);
+	SetupMesh(backend, vertices.data(), numVertices, narrowIndices.data(), numIndices, VK_INDEX_TYPE_UINT16);
+}
 
-	copyBuffer(backend, stagingBuffer, vertexBuffer, bufferSize, backend.m_commandPool);
+void Mesh::SetupMesh(Vulkan_Backend& backend, const vertex* vertexData, uint32_t numVertices, const void* indexData, uint32_t numIndices, VkIndexType type)
+{
+	glm::vec3 meshBoundsMin, meshBoundsExtent;
+	computeBounds(vertexData, numVertices, meshBoundsMin, meshBoundsExtent);
 
-	vkDestroyBuffer(backend.m_device, stagingBuffer, nullptr);
-	vkFreeMemory(backend.m_device, stagingBufferMemory, nullptr);
+	if (vertexFormat != VertexFormat::Packed)
+	{
+		SetupMesh(backend, vertexData, numVertices, meshBoundsMin, meshBoundsExtent, indexData, numIndices, type);
+		return;
+	}
 
-	//---setup index buffer ---//
+	std::vector<packedVertex> packed;
+	encodePackedVertices(vertexData, numVertices, meshBoundsMin, meshBoundsExtent, packed);
+	SetupMesh(backend, packed.data(), numVertices, meshBoundsMin, meshBoundsExtent, indexData, numIndices, type);
+}
 
-	bufferSize = sizeof(indices[0]) * indices.size();
+void Mesh::SetupMesh(Vulkan_Backend& backend, const void* gpuVertexData, uint32_t numVertices, const glm::vec3& meshBoundsMin, const glm::vec3& meshBoundsExtent,
+	const void* indexData, uint32_t numIndices, VkIndexType type)
+{
+	vertexCount = numVertices;
+	indexCount = numIndices;
+	indexType = type;
+	boundsMin = meshBoundsMin;
+	boundsExtent = meshBoundsExtent;
 
-	stagingBuffer;
-	 stagingBufferMemory;
-	createBuffer(backend, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	//vertices and indices go into the shared arena buffers, no per mesh VkBuffer
+	geometry = backend.m_geometryArena->allocate(vertexFormat, gpuVertexData, numVertices, indexType, indexData, numIndices);
 
-	data;
-	vkMapMemory(backend.m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(backend.m_device, stagingBufferMemory);
+	uploadToken = backend.m_uploader.currentToken();
+}
 
-	createBuffer(backend, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+void Mesh::destroyMesh(Vulkan_Backend& backend)
+{
+	backend.m_geometryArena->free(geometry);
+	geometry = nullptr;
+}
 
-	copyBuffer(backend, stagingBuffer, indexBuffer, bufferSize, backend.m_commandPool);
+uint32_t Mesh::selectLod(float distance, float projectionScale, uint32_t currentLod) const
+{
+	if (lods.size() < 2)
+		return 0;
+	if (distance <= 0.0f)
+		return 0;
+
+	auto pixels = [&](uint32_t lod) { return lods[lod].error * projectionScale / distance; };
+	uint32_t lod = std::min(currentLod, static_cast<uint32_t>(lods.size() - 1));
+
+	//refine as soon as the current level is over the threshold, coarsen only once the next one is well under it
+	while (lod > 0 && pixels(lod) > LOD_ERROR_PIXELS)
+		lod--;
+	while (lod + 1 < lods.size() && pixels(lod + 1) <= LOD_ERROR_PIXELS * (1.0f - LOD_HYSTERESIS))
+		lod++;
+	return lod;
+}
 
-	vkDestroyBuffer(backend.m_device, stagingBuffer, nullptr);
-	vkFreeMemory(backend.m_device, stagingBufferMemory, nullptr);
+void Mesh::recordDraw(VkCommandBuffer commandBuffer, uint32_t instanceCount) const
+{
+	recordDrawLod(commandBuffer, 0, instanceCount);
+}
 
+void Mesh::recordDrawLod(VkCommandBuffer commandBuffer, uint32_t lod, uint32_t instanceCount) const
+{
+	if (lods.empty())
+	{
+		vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, geometry->firstIndex, geometry->vertexOffset, 0);
+		return;
+	}
+	const MeshLod& level = lods[std::min(lod, static_cast<uint32_t>(lods.size() - 1))];
+	vkCmdDrawIndexed(commandBuffer, level.indexCount, instanceCount, geometry->firstIndex + level.firstIndex, geometry->vertexOffset, 0);
 }
 
+void Mesh::recordDrawRanges(VkCommandBuffer commandBuffer, const std::vector<IndexRange>& ranges) const
+{
+	for (const IndexRange& range : ranges)
+	{
+		vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, geometry->firstIndex + range.firstIndex, geometry->vertexOffset, 0);
+	}
+}
@@ -7,11 +7,27 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <memory>
+#include <atomic>
 #include "Renderer.h"
+#include "MipGenerator.h"
+#include "GeometryArena.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
 
 struct globalShaderVars {
 	float totalElapsedTime;
 	float frameTime;
+	//std140 starts the matrix at 16
+	float padding[2];
+	//world to vulkan clip space
+	glm::mat4 viewProjection;
+};
+
+//per draw block, pushed into the UniformRing for every draw and picked with a dynamic offset
+struct objectShaderVars {
+	//TransformHierarchy::world of the mesh's node
+	glm::mat4 world;
 };
 
 struct vertex {
@@ -22,44 +38,135 @@ struct vertex {
 	glm::vec3 bitangent;	
 };
 
+//20 byte alternative to vertex, decoded by shaders/packedVertex.glsl
+struct packedVertex {
+	//unorm16, relative to the mesh bounds. w is padding
+	uint16_t pos[4];
+	//half float
+	uint16_t uv[2];
+	//snorm16 quaternion of the tangent frame, sign of w is the bitangent handedness
+	int16_t qtangent[4];
+};
+
+enum class VertexFormat {
+	Full,
+	Packed
+};
+
+//meshes with more vertices than this need 32 bit indices or have to be split
+const uint32_t MAX_UINT16_INDEXED_VERTICES = 65536;
+
+//bytes per vertex in the gpu buffer for a format
+inline uint32_t vertexSizeOf(VertexFormat format)
+{
+	return format == VertexFormat::Packed ? sizeof(packedVertex) : sizeof(vertex);
+}
+
+inline uint32_t indexSizeOf(VkIndexType indexType)
+{
+	return indexType == VK_INDEX_TYPE_UINT32 ? 4 : 2;
+}
+
 struct Texture {
 	VkSampler imgSampler;
 	VkImage img;
 	VkImageView imgView;
-	VkDeviceMemory imgMem;
+	MemoryAllocation imgMem;
 	VkDescriptorImageInfo imgDescriptor;
 	VkImageLayout imgLayout;
 	std::string type;
 	std::string path;
+	uint32_t mipLevels = 1;
+	//image is sampleable once this upload completed
+	UploadToken uploadToken = 0;
+	//set once the image, view and sampler exist and the upload is recorded
+	std::atomic<bool> resident{ false };
 
+	//decodes on the calling thread, the TextureRegistry decodes on workers and calls createFromPixels
 	void setupTexture(Vulkan_Backend& backend);
+	//rgba8 pixels, null creates a 1x1 white placeholder. builds the mip chain on the calling thread
+	void createFromPixels(Vulkan_Backend& backend, const unsigned char* pixels, uint32_t width, uint32_t height);
+	void createFromMipChain(Vulkan_Backend& backend, const MipChain& mips);
+	void destroyTexture(Vulkan_Backend& backend);
 };
 
+//handed out by the TextureRegistry, the last owner going away destroys the image, view and sampler
+typedef std::shared_ptr<Texture> TextureHandle;
+
+//index of a material's record in the backend's MaterialTable
+typedef uint32_t MaterialId;
+const MaterialId INVALID_MATERIAL_ID = ~0u;
+
 struct Material {
-	Texture* diffuse;
-	VkDescriptorSet matDescriptorSet = VK_NULL_HANDLE;
+	TextureHandle diffuse;
+	//pushed per draw, the textures come from the MaterialTable's set
+	MaterialId id = INVALID_MATERIAL_ID;
 
-	//create material, descriptor set
-	void CreateMaterial(Vulkan_Backend& backend, VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout);
+	//registers with the backend's MaterialTable, doesn't wait for the textures
+	void CreateMaterial(Vulkan_Backend& backend);
 };
 
 VkVertexInputBindingDescription getBindingDescription();
 
 std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions();
 
+VkVertexInputBindingDescription getPackedBindingDescription();
+
+std::array<VkVertexInputAttributeDescription, 3> getPackedAttributeDescriptions();
+
 struct Mesh {
 	
-	Mesh(std::vector<vertex> v, std::vector<uint16_t> i, Material m) { vertices = v; indices = i; mat = m; };
+	Mesh(std::vector<vertex> v, std::vector<uint32_t> i, Material m) : vertices(std::move(v)), indices(std::move(i)), mat(m) {};
 	std::vector<vertex> vertices;
-	std::vector<uint16_t> indices;
+	//cpu side indices are always 32 bit, the gpu buffer uses indexType
+	std::vector<uint32_t> indices;
 	Material mat;
 
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
+	//clusters over indices for culling, ranges are relative to this mesh's indices
+	std::vector<Meshlet> meshlets;
+	//lod 0 first, every level is a range of this mesh's indices over the same vertices. meshlets cover lod 0 only
+	std::vector<MeshLod> lods;
+
+	//node in the scene's TransformHierarchy holding the object to world matrix
+	uint32_t transformNode = 0;
+
+	//slice of the shared geometry buffers, owned by the GeometryArena. offsets change when the arena compacts
+	GeometryRange* geometry = nullptr;
+
+	uint32_t vertexCount = 0;
+	//all lods together
+	uint32_t indexCount = 0;
+	//16 bit whenever every index fits, set by SetupMesh
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+	//layout of the gpu vertex buffer, set before SetupMesh. cpu side vertices are always full
+	VertexFormat vertexFormat = VertexFormat::Full;
+	//packed positions decode as boundsMin + unorm * boundsExtent
+	glm::vec3 boundsMin{ 0.0f };
+	glm::vec3 boundsExtent{ 0.0f };
 
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	//buffers are drawable once this upload completed
+	UploadToken uploadToken = 0;
 
 	void SetupMesh(Vulkan_Backend& backend);
-	
+	//uploads from external memory, the cpu side vectors stay empty
+	//indexData is already in the gpu index type
+	void SetupMesh(Vulkan_Backend& backend, const vertex* vertexData, uint32_t numVertices, const void* indexData, uint32_t numIndices, VkIndexType type);
+	//same, but gpuVertexData is already in vertexFormat and encoded against the given bounds (e.g. a mapped mesh cache)
+	void SetupMesh(Vulkan_Backend& backend, const void* gpuVertexData, uint32_t numVertices, const glm::vec3& meshBoundsMin, const glm::vec3& meshBoundsExtent,
+		const void* indexData, uint32_t numIndices, VkIndexType type);
+
+	//returns the geometry to the arena
+	void destroyMesh(Vulkan_Backend& backend);
+
+	//coarsest lod whose error stays under LOD_ERROR_PIXELS at this distance, with hysteresis against currentLod
+	//projectionScale is the viewport height / (2 * tan(fovY / 2)), so error * projectionScale / distance is in pixels
+	uint32_t selectLod(float distance, float projectionScale, uint32_t currentLod) const;
+
+	//draw only, the arena buffers for vertexFormat and indexType have to be bound through GeometryArena::bind
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1) const;
+	void recordDrawLod(VkCommandBuffer commandBuffer, uint32_t lod, uint32_t instanceCount = 1) const;
+	//draws only the given index ranges, as returned by utils::cullMeshlets
+	void recordDrawRanges(VkCommandBuffer commandBuffer, const std::vector<IndexRange>& ranges) const;
+
 };
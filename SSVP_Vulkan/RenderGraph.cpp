@@ -0,0 +1,820 @@
+#include "RenderGraph.h"
+#include "Hash.h"
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	struct UsageInfo {
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageUsageFlags imageUsage;
+		bool write;
+		bool attachment;
+	};
+
+	UsageInfo usageInfo(RenderGraphUsage usage)
+	{
+		const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		//sampled and storage images can be used by any shader, the graph doesn't know which
+		const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		switch (usage)
+		{
+		case RenderGraphUsage::ColorAttachment:
+			return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true };
+		case RenderGraphUsage::DepthAttachment:
+			return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, depthStages,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, true };
+		case RenderGraphUsage::DepthRead:
+			return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, depthStages,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false, true };
+		case RenderGraphUsage::Sampled:
+			return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false, false };
+		case RenderGraphUsage::StorageRead:
+			return { VK_IMAGE_LAYOUT_GENERAL, shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_STORAGE_BIT, false, false };
+		case RenderGraphUsage::StorageWrite:
+			return { VK_IMAGE_LAYOUT_GENERAL, shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT, true, false };
+		case RenderGraphUsage::TransferSrc:
+			return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false, false };
+		case RenderGraphUsage::TransferDst:
+			return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true, false };
+		}
+		throw std::runtime_error("unknown render graph usage");
+	}
+
+	bool isDepthFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+			format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	bool hasStencil(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	VkImageAspectFlags aspectFor(VkFormat format)
+	{
+		if (!isDepthFormat(format))
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		return hasStencil(format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+	}
+
+	//state of an image between passes while walking the compiled order
+	struct ImageState {
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		bool written;
+	};
+}
+
+RenderGraph::RenderGraph(VkDevice device, DeviceMemoryAllocator& allocator, const VkExtent2D& swapChainExtent,
+	std::function<void(std::function<void()>)> deferDestroy)
+	: m_device{ device }, m_allocator{ allocator }, m_swapChainExtent{ swapChainExtent }, m_deferDestroy{ std::move(deferDestroy) }
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+	destroyCompiled();
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	m_resources.push_back(std::move(resource));
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importImages(const std::string& name, VkFormat format, const std::vector<VkImage>& images,
+	const std::vector<VkImageView>& views, VkExtent2D extent, VkImageLayout initialLayout, VkImageLayout finalLayout)
+{
+	if (images.empty() || images.size() != views.size())
+		throw std::runtime_error("render graph import " + name + " needs one view per image");
+
+	Resource resource;
+	resource.name = name;
+	resource.desc.format = format;
+	resource.desc.fixedExtent = extent;
+	resource.imported = true;
+	resource.importedImages = images;
+	resource.importedViews = views;
+	resource.initialLayout = initialLayout;
+	resource.finalLayout = finalLayout;
+	m_resources.push_back(std::move(resource));
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+void RenderGraph::setImportedIndex(RenderGraphResource resource, uint32_t index)
+{
+	Resource& res = m_resources[resource];
+	if (!res.imported || index >= res.importedImages.size())
+		throw std::runtime_error("invalid imported image index for " + res.name);
+	res.importedIndex = index;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, const std::vector<RenderGraphAccess>& accesses, RenderGraphExecuteFn execute, bool secondaryContents)
+{
+	for (size_t i = 0; i < accesses.size(); ++i)
+	{
+		if (accesses[i].resource >= m_resources.size())
+			throw std::runtime_error("render graph pass " + name + " uses an unknown resource");
+		for (size_t j = 0; j < i; ++j)
+			if (accesses[j].resource == accesses[i].resource)
+				throw std::runtime_error("render graph pass " + name + " uses " + m_resources[accesses[i].resource].name + " twice");
+	}
+
+	Pass pass;
+	pass.name = name;
+	pass.accesses = accesses;
+	pass.execute = std::move(execute);
+	pass.secondaryContents = secondaryContents;
+	m_passes.push_back(std::move(pass));
+	return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void RenderGraph::clear()
+{
+	m_resources.clear();
+	m_passes.clear();
+}
+
+
+VkImage RenderGraph::image(RenderGraphResource resource) const
+{
+	const Resource& res = m_resources[resource];
+	return res.imported ? res.importedImages[res.importedIndex] : m_compiledResources[resource].image;
+}
+
+VkImageView RenderGraph::view(RenderGraphResource resource) const
+{
+	const Resource& res = m_resources[resource];
+	return res.imported ? res.importedViews[res.importedIndex] : m_compiledResources[resource].view;
+}
+
+uint64_t RenderGraph::declarationHash() const
+{
+	//everything compile() derives objects from, the imported index is picked per frame and left out
+	uint64_t hash = FNV_OFFSET_BASIS;
+	VkExtent2D swapExtent = m_swapChainExtent;
+	hash = hashFNV1a(&swapExtent, sizeof(swapExtent), hash);
+
+	for (const Resource& res : m_resources)
+	{
+		hash = hashFNV1a(res.name, hash);
+		hash = hashFNV1a(&res.imported, sizeof(res.imported), hash);
+		hash = hashFNV1a(&res.desc.format, sizeof(res.desc.format), hash);
+		hash = hashFNV1a(&res.desc.scale, sizeof(res.desc.scale), hash);
+		hash = hashFNV1a(&res.desc.fixedExtent, sizeof(res.desc.fixedExtent), hash);
+		hash = hashFNV1a(&res.initialLayout, sizeof(res.initialLayout), hash);
+		hash = hashFNV1a(&res.finalLayout, sizeof(res.finalLayout), hash);
+		hash = hashFNV1a(res.importedImages.data(), res.importedImages.size() * sizeof(VkImage), hash);
+		hash = hashFNV1a(res.importedViews.data(), res.importedViews.size() * sizeof(VkImageView), hash);
+	}
+
+	for (const Pass& pass : m_passes)
+	{
+		hash = hashFNV1a(pass.name, hash);
+		hash = hashFNV1a(&pass.secondaryContents, sizeof(pass.secondaryContents), hash);
+		for (const RenderGraphAccess& access : pass.accesses)
+		{
+			hash = hashFNV1a(&access.resource, sizeof(access.resource), hash);
+			hash = hashFNV1a(&access.usage, sizeof(access.usage), hash);
+			hash = hashFNV1a(&access.clear, sizeof(access.clear), hash);
+			hash = hashFNV1a(&access.clearValue, sizeof(access.clearValue), hash);
+		}
+	}
+	return hash;
+}
+
+void RenderGraph::destroyCompiled()
+{
+	releaseCompiled(false);
+}
+
+void RenderGraph::releaseCompiled(bool deferred)
+{
+	//the objects move into the destruction, the graph can compile again right away
+	auto destroy = [device = m_device, &allocator = m_allocator, passes = std::move(m_compiledPasses), resources = std::move(m_compiledResources), slots = std::move(m_slots)]() mutable {
+		for (CompiledPass& pass : passes)
+		{
+			for (VkFramebuffer framebuffer : pass.framebuffers)
+				vkDestroyFramebuffer(device, framebuffer, nullptr);
+			if (pass.renderPass != VK_NULL_HANDLE)
+				vkDestroyRenderPass(device, pass.renderPass, nullptr);
+		}
+
+		for (CompiledResource& res : resources)
+		{
+			if (res.view != VK_NULL_HANDLE)
+				vkDestroyImageView(device, res.view, nullptr);
+			if (res.image != VK_NULL_HANDLE)
+				vkDestroyImage(device, res.image, nullptr);
+		}
+
+		for (MemorySlot& slot : slots)
+			allocator.free(slot.allocation);
+	};
+	m_compiledPasses.clear();
+	m_compiledResources.clear();
+	m_slots.clear();
+
+	if (deferred && m_deferDestroy)
+		m_deferDestroy(std::move(destroy));
+	else
+		destroy();
+
+	m_order.clear();
+	m_finalBarriers = BarrierBatch{};
+	m_compiled = false;
+}
+
+void RenderGraph::compile()
+{
+	uint64_t hash = declarationHash();
+	if (m_compiled && hash == m_compiledHash)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+
+	//frames in flight may still use the objects of the last compile, m_deferDestroy destroys them
+	//once those completed instead of stalling on the device
+	releaseCompiled(m_compiled);
+
+	m_compiledPasses.resize(m_passes.size());
+	m_compiledResources.resize(m_resources.size());
+	orderPasses();
+	createTransients();
+	createRenderPasses();
+	computeBarriers();
+
+	m_compiledHash = hash;
+	m_compiled = true;
+	m_compileCount++;
+	m_compileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printStats();
+}
+
+void RenderGraph::orderPasses()
+{
+	const uint32_t passCount = static_cast<uint32_t>(m_passes.size());
+
+	//per resource in declaration order: a reader depends on the writer before it (read after write), a writer on
+	//the writer before it (write after write) and on every reader since (write after read), so a later writer
+	//can't overwrite what an earlier reader still has to see
+	std::vector<std::vector<uint32_t>> successors(passCount);
+	std::vector<uint32_t> inDegree(passCount, 0);
+	auto addEdge = [&successors, &inDegree](uint32_t from, uint32_t to) {
+		successors[from].push_back(to);
+		inDegree[to]++;
+	};
+	std::vector<int32_t> lastWriter(m_resources.size(), -1);
+	std::vector<std::vector<uint32_t>> readersSinceWrite(m_resources.size());
+	for (uint32_t p = 0; p < passCount; ++p)
+	{
+		for (const RenderGraphAccess& access : m_passes[p].accesses)
+		{
+			const RenderGraphResource r = access.resource;
+			if (lastWriter[r] >= 0)
+				addEdge(static_cast<uint32_t>(lastWriter[r]), p);
+			if (!usageInfo(access.usage).write)
+			{
+				readersSinceWrite[r].push_back(p);
+				continue;
+			}
+			for (uint32_t reader : readersSinceWrite[r])
+				addEdge(reader, p);
+			readersSinceWrite[r].clear();
+			lastWriter[r] = static_cast<int32_t>(p);
+		}
+	}
+
+	//kahn, the lowest declared ready pass goes first so independent passes keep the order they were added in.
+	//every edge points forward in declaration order, the sort can't find a cycle
+	std::vector<uint32_t> sorted;
+	sorted.reserve(passCount);
+	std::vector<uint32_t> ready;
+	for (uint32_t p = 0; p < passCount; ++p)
+		if (inDegree[p] == 0)
+			ready.push_back(p);
+	while (!ready.empty())
+	{
+		auto lowest = std::min_element(ready.begin(), ready.end());
+		uint32_t p = *lowest;
+		ready.erase(lowest);
+		sorted.push_back(p);
+		for (uint32_t next : successors[p])
+			if (--inDegree[next] == 0)
+				ready.push_back(next);
+	}
+	//walking back from the outputs, a pass is kept if something kept (or outside the graph) uses what it writes.
+	//passes without writes have side effects the graph can't see and are always kept
+	std::vector<bool> needed(m_resources.size(), false);
+	for (size_t r = 0; r < m_resources.size(); ++r)
+		needed[r] = m_resources[r].imported;
+	for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+	{
+		const Pass& pass = m_passes[*it];
+		bool writes = false, keep = false;
+		for (const RenderGraphAccess& access : pass.accesses)
+		{
+			if (!usageInfo(access.usage).write)
+				continue;
+			writes = true;
+			keep = keep || needed[access.resource];
+		}
+
+		m_compiledPasses[*it].culled = writes && !keep;
+		if (m_compiledPasses[*it].culled)
+			continue;
+		//earlier writers of anything this pass touches are needed too, attachments may be loaded
+		for (const RenderGraphAccess& access : pass.accesses)
+			needed[access.resource] = true;
+	}
+
+	for (uint32_t p : sorted)
+		if (!m_compiledPasses[p].culled)
+			m_order.push_back(p);
+
+	//lifetimes and usage flags from the kept passes only
+	std::vector<bool> written(m_resources.size(), false);
+	for (int32_t pos = 0; pos < static_cast<int32_t>(m_order.size()); ++pos)
+	{
+		for (const RenderGraphAccess& access : m_passes[m_order[pos]].accesses)
+		{
+			UsageInfo info = usageInfo(access.usage);
+			CompiledResource& res = m_compiledResources[access.resource];
+			if (!info.write && !written[access.resource] && !m_resources[access.resource].imported)
+				throw std::runtime_error("render graph pass " + m_passes[m_order[pos]].name + " reads " + m_resources[access.resource].name + " before anything writes it");
+
+			written[access.resource] = written[access.resource] || info.write;
+			if (res.firstUse < 0)
+				res.firstUse = pos;
+			res.lastUse = pos;
+			res.usage |= info.imageUsage;
+		}
+	}
+}
+
+void RenderGraph::createTransients()
+{
+	VkDevice device = m_device;
+	VkExtent2D swapExtent = m_swapChainExtent;
+
+	std::vector<RenderGraphResource> transients;
+	m_transientBytes = 0;
+	for (RenderGraphResource r = 0; r < m_resources.size(); ++r)
+	{
+		const Resource& decl = m_resources[r];
+		CompiledResource& res = m_compiledResources[r];
+		if (decl.imported)
+		{
+			res.extent = decl.desc.fixedExtent;
+			continue;
+		}
+		//culled away, never created
+		if (res.firstUse < 0)
+			continue;
+
+		if (decl.desc.fixedExtent.width != 0 && decl.desc.fixedExtent.height != 0)
+			res.extent = decl.desc.fixedExtent;
+		else
+		{
+			res.extent.width = std::max(1u, static_cast<uint32_t>(std::floor(swapExtent.width * decl.desc.scale)));
+			res.extent.height = std::max(1u, static_cast<uint32_t>(std::floor(swapExtent.height * decl.desc.scale)));
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = res.extent.width;
+		imageInfo.extent.height = res.extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = decl.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = res.usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &res.image) != VK_SUCCESS)
+			throw std::runtime_error("failed to create render graph image " + decl.name);
+
+		vkGetImageMemoryRequirements(device, res.image, &res.requirements);
+		m_transientBytes += res.requirements.size;
+		transients.push_back(r);
+	}
+
+	//largest first, every image goes into the first slot with a compatible memory type whose
+	//occupants are all dead before it's first used or born after its last use
+	std::stable_sort(transients.begin(), transients.end(), [this](RenderGraphResource a, RenderGraphResource b) {
+		return m_compiledResources[a].requirements.size > m_compiledResources[b].requirements.size;
+	});
+
+	for (RenderGraphResource r : transients)
+	{
+		CompiledResource& res = m_compiledResources[r];
+		uint32_t slotIndex = static_cast<uint32_t>(m_slots.size());
+		for (uint32_t s = 0; s < m_slots.size() && slotIndex == m_slots.size(); ++s)
+		{
+			if ((m_slots[s].requirements.memoryTypeBits & res.requirements.memoryTypeBits) == 0)
+				continue;
+
+			bool overlaps = false;
+			for (RenderGraphResource other : m_slots[s].occupants)
+			{
+				const CompiledResource& o = m_compiledResources[other];
+				overlaps = overlaps || !(o.lastUse < res.firstUse || res.lastUse < o.firstUse);
+			}
+			if (!overlaps)
+				slotIndex = s;
+		}
+
+		if (slotIndex == m_slots.size())
+		{
+			m_slots.emplace_back();
+			m_slots.back().requirements = res.requirements;
+		}
+		else
+		{
+			VkMemoryRequirements& req = m_slots[slotIndex].requirements;
+			req.size = std::max(req.size, res.requirements.size);
+			req.alignment = std::max(req.alignment, res.requirements.alignment);
+			req.memoryTypeBits &= res.requirements.memoryTypeBits;
+		}
+		m_slots[slotIndex].occupants.push_back(r);
+		res.slot = slotIndex;
+	}
+
+	m_aliasedBytes = 0;
+	for (MemorySlot& slot : m_slots)
+	{
+		slot.allocation = m_allocator.allocate(slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+		m_aliasedBytes += slot.requirements.size;
+	}
+
+	for (RenderGraphResource r : transients)
+	{
+		CompiledResource& res = m_compiledResources[r];
+		const MemorySlot& slot = m_slots[res.slot];
+		vkBindImageMemory(device, res.image, slot.allocation.memory, slot.allocation.offset);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = res.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = m_resources[r].desc.format;
+		viewInfo.subresourceRange.aspectMask = aspectFor(m_resources[r].desc.format);
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &viewInfo, nullptr, &res.view) != VK_SUCCESS)
+			throw std::runtime_error("failed to create render graph image view " + m_resources[r].name);
+	}
+}
+
+void RenderGraph::createRenderPasses()
+{
+	VkDevice device = m_device;
+
+	//first position a resource is written at, to tell load from don't care
+	std::vector<int32_t> firstWrite(m_resources.size(), -1);
+	for (int32_t pos = 0; pos < static_cast<int32_t>(m_order.size()); ++pos)
+		for (const RenderGraphAccess& access : m_passes[m_order[pos]].accesses)
+			if (usageInfo(access.usage).write && firstWrite[access.resource] < 0)
+				firstWrite[access.resource] = pos;
+
+	for (int32_t pos = 0; pos < static_cast<int32_t>(m_order.size()); ++pos)
+	{
+		const Pass& pass = m_passes[m_order[pos]];
+		CompiledPass& compiled = m_compiledPasses[m_order[pos]];
+
+		std::vector<VkAttachmentDescription> attachments;
+		std::vector<VkAttachmentReference> colorRefs;
+		VkAttachmentReference depthRef{};
+		bool hasDepth = false;
+		std::vector<RenderGraphResource> attached;
+
+		for (const RenderGraphAccess& access : pass.accesses)
+		{
+			UsageInfo info = usageInfo(access.usage);
+			if (!info.attachment)
+				continue;
+
+			const Resource& decl = m_resources[access.resource];
+			const CompiledResource& res = m_compiledResources[access.resource];
+			if (attached.empty())
+				compiled.extent = res.extent;
+			else if (res.extent.width != compiled.extent.width || res.extent.height != compiled.extent.height)
+				throw std::runtime_error("render graph pass " + pass.name + " has attachments of different sizes");
+
+			bool loads = firstWrite[access.resource] >= 0 && firstWrite[access.resource] < pos;
+			loads = loads || (decl.imported && decl.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+			bool stores = decl.imported || pos < res.lastUse;
+
+			VkAttachmentDescription attachment{};
+			attachment.format = decl.desc.format;
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (loads ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+			attachment.storeOp = stores ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp = hasStencil(decl.desc.format) ? attachment.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = hasStencil(decl.desc.format) ? attachment.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			//layout transitions are done by the graph's barriers, never by the render pass
+			attachment.initialLayout = info.layout;
+			attachment.finalLayout = info.layout;
+
+			VkAttachmentReference ref{};
+			ref.attachment = static_cast<uint32_t>(attachments.size());
+			ref.layout = info.layout;
+			if (access.usage == RenderGraphUsage::ColorAttachment)
+				colorRefs.push_back(ref);
+			else
+			{
+				if (hasDepth)
+					throw std::runtime_error("render graph pass " + pass.name + " has more than one depth attachment");
+				depthRef = ref;
+				hasDepth = true;
+			}
+
+			attachments.push_back(attachment);
+			compiled.clearValues.push_back(access.clearValue);
+			attached.push_back(access.resource);
+
+			if (decl.imported && decl.importedImages.size() > 1)
+			{
+				if (compiled.framebufferSelector >= 0)
+					throw std::runtime_error("render graph pass " + pass.name + " renders to more than one multi image import");
+				compiled.framebufferSelector = static_cast<int32_t>(access.resource);
+			}
+		}
+
+		if (attachments.empty())
+			continue;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorRefs.size());
+		subpass.pColorAttachments = colorRefs.data();
+		subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &compiled.renderPass) != VK_SUCCESS)
+			throw std::runtime_error("failed to create render pass for " + pass.name);
+
+		//what render pass compatibility depends on for a single subpass: attachment formats, samples and their use
+		uint64_t key = FNV_OFFSET_BASIS;
+		for (const VkAttachmentDescription& attachment : attachments)
+		{
+			key = hashFNV1a(&attachment.format, sizeof(attachment.format), key);
+			key = hashFNV1a(&attachment.samples, sizeof(attachment.samples), key);
+		}
+		key = hashFNV1a(colorRefs.data(), colorRefs.size() * sizeof(VkAttachmentReference), key);
+		key = hashFNV1a(&hasDepth, sizeof(hasDepth), key);
+		compiled.renderPassKey = key;
+
+		size_t framebufferCount = compiled.framebufferSelector >= 0 ? m_resources[compiled.framebufferSelector].importedImages.size() : 1;
+		for (size_t i = 0; i < framebufferCount; ++i)
+		{
+			std::vector<VkImageView> views;
+			for (RenderGraphResource r : attached)
+			{
+				const Resource& decl = m_resources[r];
+				if (!decl.imported)
+					views.push_back(m_compiledResources[r].view);
+				else
+					views.push_back(decl.importedViews[static_cast<int32_t>(r) == compiled.framebufferSelector ? i : 0]);
+			}
+
+			VkFramebufferCreateInfo framebufferInfo{};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = compiled.renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+			framebufferInfo.pAttachments = views.data();
+			framebufferInfo.width = compiled.extent.width;
+			framebufferInfo.height = compiled.extent.height;
+			framebufferInfo.layers = 1;
+
+			VkFramebuffer framebuffer;
+			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+				throw std::runtime_error("failed to create framebuffer for " + pass.name);
+			compiled.framebuffers.push_back(framebuffer);
+		}
+	}
+}
+
+void RenderGraph::computeBarriers()
+{
+	//usage at the last access, what the next occupant of a slot (or the next frame) has to wait for
+	std::vector<RenderGraphUsage> lastUsage(m_resources.size(), RenderGraphUsage::Sampled);
+	for (uint32_t p : m_order)
+		for (const RenderGraphAccess& access : m_passes[p].accesses)
+			lastUsage[access.resource] = access.usage;
+
+	std::vector<ImageState> states(m_resources.size());
+	std::vector<bool> started(m_resources.size(), false);
+
+	for (int32_t pos = 0; pos < static_cast<int32_t>(m_order.size()); ++pos)
+	{
+		BarrierBatch& batch = m_compiledPasses[m_order[pos]].barriers;
+		for (const RenderGraphAccess& access : m_passes[m_order[pos]].accesses)
+		{
+			const RenderGraphResource r = access.resource;
+			const Resource& decl = m_resources[r];
+			const CompiledResource& res = m_compiledResources[r];
+			UsageInfo info = usageInfo(access.usage);
+			ImageState& state = states[r];
+
+			if (!started[r])
+			{
+				started[r] = true;
+				if (decl.imported)
+				{
+					//whoever hands the image over (e.g. the acquire semaphore) waits on the stages of the first use
+					state = { decl.initialLayout, info.stages, 0, false };
+				}
+				else
+				{
+					//the memory was last used by the slot's previous occupant, or by the last occupant in the previous frame
+					const MemorySlot& slot = m_slots[res.slot];
+					RenderGraphResource previous = r;
+					int32_t previousLast = -1, latest = -1;
+					RenderGraphResource latestOccupant = r;
+					for (RenderGraphResource other : slot.occupants)
+					{
+						const CompiledResource& o = m_compiledResources[other];
+						if (o.lastUse < res.firstUse && o.lastUse > previousLast)
+						{
+							previousLast = o.lastUse;
+							previous = other;
+						}
+						if (o.lastUse > latest)
+						{
+							latest = o.lastUse;
+							latestOccupant = other;
+						}
+					}
+					if (previousLast < 0)
+						previous = latestOccupant;
+
+					UsageInfo before = usageInfo(lastUsage[previous]);
+					//contents are never kept, the layout is whatever the previous occupant left
+					state = { VK_IMAGE_LAYOUT_UNDEFINED, before.stages, before.write ? before.access : 0, true };
+				}
+			}
+			else if (state.layout == info.layout && !state.written && !info.write)
+			{
+				//read after read in the same layout, later writers have to wait for both readers
+				state.stages |= info.stages;
+				continue;
+			}
+
+			Barrier barrier;
+			barrier.resource = r;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = info.layout;
+			barrier.srcAccess = state.written ? state.access : 0;
+			barrier.dstAccess = info.access;
+			batch.barriers.push_back(barrier);
+			batch.srcStages |= state.stages;
+			batch.dstStages |= info.stages;
+
+			state = { info.layout, info.stages, info.access, info.write };
+		}
+	}
+
+	for (RenderGraphResource r = 0; r < m_resources.size(); ++r)
+	{
+		const Resource& decl = m_resources[r];
+		const ImageState& state = states[r];
+		if (!decl.imported || !started[r] || decl.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+			continue;
+		if (state.layout == decl.finalLayout && !state.written)
+			continue;
+
+		Barrier barrier;
+		barrier.resource = r;
+		barrier.oldLayout = state.layout;
+		barrier.newLayout = decl.finalLayout;
+		barrier.srcAccess = state.written ? state.access : 0;
+		//whatever comes after the frame (present, the next frame's first use) synchronizes with a semaphore or its own barrier
+		barrier.dstAccess = 0;
+		m_finalBarriers.barriers.push_back(barrier);
+		m_finalBarriers.srcStages |= state.stages;
+		m_finalBarriers.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	}
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const
+{
+	if (batch.barriers.empty())
+		return;
+
+	std::vector<VkImageMemoryBarrier> barriers(batch.barriers.size());
+	for (size_t i = 0; i < batch.barriers.size(); ++i)
+	{
+		const Barrier& source = batch.barriers[i];
+		VkImageMemoryBarrier& barrier = barriers[i];
+		barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = source.oldLayout;
+		barrier.newLayout = source.newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		//imported images are patched in here, they change every frame
+		barrier.image = image(source.resource);
+		barrier.subresourceRange.aspectMask = aspectFor(m_resources[source.resource].desc.format);
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = source.srcAccess;
+		barrier.dstAccessMask = source.dstAccess;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		batch.srcStages != 0 ? batch.srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+		batch.dstStages != 0 ? batch.dstStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+		0, 0, nullptr, 0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+	compile();
+
+	for (uint32_t p : m_order)
+	{
+		const Pass& pass = m_passes[p];
+		const CompiledPass& compiled = m_compiledPasses[p];
+		recordBarriers(commandBuffer, compiled.barriers);
+
+		RenderGraphPassContext context{};
+		context.commandBuffer = commandBuffer;
+		context.renderPass = compiled.renderPass;
+		context.extent = compiled.renderPass != VK_NULL_HANDLE ? compiled.extent : m_swapChainExtent;
+
+		if (compiled.renderPass != VK_NULL_HANDLE)
+		{
+			context.framebuffer = compiled.framebuffers[compiled.framebufferSelector >= 0 ? m_resources[compiled.framebufferSelector].importedIndex : 0];
+
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = compiled.renderPass;
+			renderPassInfo.framebuffer = context.framebuffer;
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = compiled.extent;
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(compiled.clearValues.size());
+			renderPassInfo.pClearValues = compiled.clearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+				pass.secondaryContents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		if (pass.execute)
+			pass.execute(context);
+
+		if (compiled.renderPass != VK_NULL_HANDLE)
+			vkCmdEndRenderPass(commandBuffer);
+	}
+
+	recordBarriers(commandBuffer, m_finalBarriers);
+}
+
+void RenderGraph::printStats() const
+{
+	if (m_compileCount == 0)
+		return;
+
+	size_t culled = 0, renderPasses = 0, barriers = m_finalBarriers.barriers.size(), batches = m_finalBarriers.barriers.empty() ? 0 : 1;
+	for (const CompiledPass& pass : m_compiledPasses)
+	{
+		culled += pass.culled ? 1 : 0;
+		renderPasses += pass.renderPass != VK_NULL_HANDLE ? 1 : 0;
+		barriers += pass.barriers.barriers.size();
+		batches += pass.barriers.barriers.empty() ? 0 : 1;
+	}
+
+	std::cout << "[RENDERGRAPH]: compile " << m_compileCount << " took " << m_compileMilliseconds << " ms, "
+		<< m_order.size() << " passes (" << culled << " culled), " << renderPasses << " render passes, "
+		<< barriers << " image barriers in " << batches << " batches per frame" << std::endl;
+	std::cout << "\ttransients: " << m_transientBytes / 1024 << " KB in " << m_slots.size() << " memory slots, "
+		<< m_aliasedBytes / 1024 << " KB allocated, " << (m_transientBytes - m_aliasedBytes) / 1024 << " KB saved by aliasing" << std::endl;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include "MemoryAllocator.h"
+
+//how a pass uses an image, decides its layout and the stages and access masks of the barriers around it
+enum class RenderGraphUsage : uint32_t {
+	ColorAttachment,
+	DepthAttachment,
+	//depth test without writes
+	DepthRead,
+	Sampled,
+	StorageRead,
+	StorageWrite,
+	TransferSrc,
+	TransferDst
+};
+
+typedef uint32_t RenderGraphResource;
+
+//transient image created and owned by the graph, scale is relative to the swap chain unless fixedExtent is set
+struct RenderGraphImageDesc {
+	VkFormat format;
+	float scale = 1.0f;
+	VkExtent2D fixedExtent{ 0, 0 };
+};
+
+struct RenderGraphAccess {
+	RenderGraphResource resource;
+	RenderGraphUsage usage;
+	//attachments only, cleared on load. otherwise loaded when an earlier pass wrote them, don't care if not
+	bool clear = false;
+	VkClearValue clearValue{};
+};
+
+struct RenderGraphPassContext {
+	VkCommandBuffer commandBuffer;
+	//null for passes without attachments, the render pass is already begun otherwise
+	VkRenderPass renderPass;
+	VkFramebuffer framebuffer;
+	VkExtent2D extent;
+};
+
+typedef std::function<void(const RenderGraphPassContext& context)> RenderGraphExecuteFn;
+
+//passes declare the images they read and write, compile() turns that into an execution order, the
+//barriers and layout transitions between passes, one render pass and framebuffer per raster pass and
+//the transient images. transients whose lifetimes don't overlap share memory.
+//declarations are kept across frames, execute() only recompiles when they or the swap chain changed.
+//the accesses to a resource happen in declaration order: a reader sees what the writer declared before it
+//wrote, a writer waits for the previous writer and for every reader in between. passes whose results
+//never reach an imported image are culled
+class RenderGraph {
+public:
+	//swapChainExtent is read again at every compile, e.g. the backend's. deferDestroy hands the destruction of
+	//replaced objects to whoever knows when the frames using them completed (the FrameScheduler), without one
+	//they are destroyed right away
+	RenderGraph(VkDevice device, DeviceMemoryAllocator& allocator, const VkExtent2D& swapChainExtent,
+		std::function<void(std::function<void()>)> deferDestroy = nullptr);
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+	~RenderGraph();
+
+	RenderGraphResource createImage(const std::string& name, const RenderGraphImageDesc& desc);
+	//images owned elsewhere (e.g. the swap chain), one of them is used per frame, see setImportedIndex
+	//initialLayout is what the image is in when the frame starts, the graph leaves it in finalLayout
+	RenderGraphResource importImages(const std::string& name, VkFormat format, const std::vector<VkImage>& images,
+		const std::vector<VkImageView>& views, VkExtent2D extent, VkImageLayout initialLayout, VkImageLayout finalLayout);
+	void setImportedIndex(RenderGraphResource resource, uint32_t index);
+
+	//secondaryContents begins the render pass for vkCmdExecuteCommands instead of inline recording
+	uint32_t addPass(const std::string& name, const std::vector<RenderGraphAccess>& accesses, RenderGraphExecuteFn execute, bool secondaryContents = false);
+
+	//drops every declaration, the compiled objects stay until the next compile and are reused if the
+	//graph is declared the same way again
+	void clear();
+
+	//no-op while the declarations and the swap chain are unchanged. the objects of a previous compile
+	//are destroyed once the frames in flight using them completed
+	void compile();
+	//compiles if needed, then records every pass with the barriers in between
+	void execute(VkCommandBuffer commandBuffer);
+	//frees everything compile created, e.g. before the swap chain images it references go away.
+	//the device must be idle, the next execute compiles again
+	void destroyCompiled();
+
+	//valid after compile
+	VkRenderPass renderPass(uint32_t pass) const { return m_compiledPasses[pass].renderPass; }
+	//equal for compatible render passes (same attachment formats and samples), survives recompiles
+	uint64_t renderPassKey(uint32_t pass) const { return m_compiledPasses[pass].renderPassKey; }
+	VkImage image(RenderGraphResource resource) const;
+	VkImageView view(RenderGraphResource resource) const;
+
+	void printStats() const;
+
+private:
+	struct Resource {
+		std::string name;
+		RenderGraphImageDesc desc;
+		bool imported = false;
+		std::vector<VkImage> importedImages;
+		std::vector<VkImageView> importedViews;
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t importedIndex = 0;
+	};
+
+	struct CompiledResource {
+		VkExtent2D extent{ 0, 0 };
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkImageUsageFlags usage = 0;
+		VkMemoryRequirements requirements{};
+		//positions in m_order, -1 if no kept pass uses it
+		int32_t firstUse = -1;
+		int32_t lastUse = -1;
+		uint32_t slot = 0;
+	};
+
+	struct Barrier {
+		RenderGraphResource resource;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	//one batched vkCmdPipelineBarrier
+	struct BarrierBatch {
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<Barrier> barriers;
+	};
+
+	struct Pass {
+		std::string name;
+		std::vector<RenderGraphAccess> accesses;
+		RenderGraphExecuteFn execute;
+		bool secondaryContents = false;
+	};
+
+	struct CompiledPass {
+		bool culled = false;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		uint64_t renderPassKey = 0;
+		//one per image of the imported attachment, or a single one
+		std::vector<VkFramebuffer> framebuffers;
+		//imported resource whose current index picks the framebuffer, -1 if there is just one
+		int32_t framebufferSelector = -1;
+		VkExtent2D extent{ 0, 0 };
+		std::vector<VkClearValue> clearValues;
+		BarrierBatch barriers;
+	};
+
+	//transient memory shared by images with disjoint lifetimes
+	struct MemorySlot {
+		VkMemoryRequirements requirements{};
+		std::vector<RenderGraphResource> occupants;
+		MemoryAllocation allocation;
+	};
+
+	uint64_t declarationHash() const;
+	//destroys the compiled objects now or hands them to m_deferDestroy
+	void releaseCompiled(bool deferred);
+	void orderPasses();
+	void createTransients();
+	void createRenderPasses();
+	void computeBarriers();
+	void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const;
+
+	VkDevice m_device;
+	DeviceMemoryAllocator& m_allocator;
+	//follows the swap chain, it's recreated in place
+	const VkExtent2D& m_swapChainExtent;
+	std::function<void(std::function<void()>)> m_deferDestroy;
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+
+	//compiled, indexed like the declarations. kept across clear() so a graph that is declared again
+	//unchanged doesn't recompile
+	std::vector<CompiledResource> m_compiledResources;
+	std::vector<CompiledPass> m_compiledPasses;
+	uint64_t m_compiledHash = 0;
+	bool m_compiled = false;
+	std::vector<uint32_t> m_order;
+	std::vector<MemorySlot> m_slots;
+	//imported images back to their final layout
+	BarrierBatch m_finalBarriers;
+
+	uint32_t m_compileCount = 0;
+	double m_compileMilliseconds = 0.0;
+	VkDeviceSize m_transientBytes = 0;
+	VkDeviceSize m_aliasedBytes = 0;
+};
@@ -1,9 +1,13 @@
 #pragma once
 
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
 
 class RenderPass {
 public:
-	virtual void RenderFrame() = 0;
+	//records the frame into a command buffer of the current frame slot, the FrameScheduler acquired
+	//imageIndex and submits the buffer
+	virtual VkCommandBuffer RenderFrame(uint32_t imageIndex) = 0;
 	virtual void freeResources() = 0;
 	virtual void recreateResources() = 0;
 };
@@ -3,10 +3,20 @@
 #include <vector>
 #include <iostream>
 #include <set>
+#include <cstring>
 #include <cstdint>
 #include <algorithm>
 #include "RenderPass.h"
 #include "ShaderUtilities.h"
+#include "TextureRegistry.h"
+#include "GeometryArena.h"
+#include "JobSystem.h"
+#include "PipelineBuilder.h"
+#include "PipelineStateCache.h"
+#include "MaterialTable.h"
+#include "DescriptorAllocator.h"
+#include "UniformRing.h"
+#include "FrameScheduler.h"
 #include <chrono>
 
 #ifdef NDEBUG
@@ -15,6 +25,9 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+//static init runs before main, time to first frame is measured from here
+static const std::chrono::steady_clock::time_point s_launchTime = std::chrono::steady_clock::now();
+
 VkCommandBuffer beginSingleTimeCommands(Vulkan_Backend& backend)
 {
 	VkCommandBufferAllocateInfo allocInfo{};
@@ -42,8 +55,11 @@ void endSingleTimeCommands(Vulkan_Backend& backend, VkCommandBuffer cmdBuffer)
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &cmdBuffer;
 
-	vkQueueSubmit(backend.m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(backend.m_graphicsQueue);
+	{
+		std::lock_guard<std::mutex> lock(backend.m_queueMutex);
+		vkQueueSubmit(backend.m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		vkQueueWaitIdle(backend.m_graphicsQueue);
+	}
 
 	vkFreeCommandBuffers(backend.m_device,backend.m_commandPool, 1, &cmdBuffer);
 
@@ -66,7 +82,7 @@ uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, V
 	throw std::runtime_error("failed to find suitable memory type");
 }
 
-void createBuffer(Vulkan_Backend& backend, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+void createBuffer(Vulkan_Backend& backend, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory) {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
@@ -81,27 +97,26 @@ void createBuffer(Vulkan_Backend& backend, VkDeviceSize size, VkBufferUsageFlags
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(backend.m_device, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, backend);
+	bufferMemory = backend.m_allocator.allocate(memRequirements, properties, true);
 
-	ret = vkAllocateMemory(backend.m_device, &allocInfo, nullptr, &bufferMemory);
-	if (ret != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
-	}
+	vkBindBufferMemory(backend.m_device, buffer, bufferMemory.memory, bufferMemory.offset);
+}
 
-	vkBindBufferMemory(backend.m_device, buffer, bufferMemory, 0);
+void destroyBuffer(Vulkan_Backend& backend, VkBuffer& buffer, MemoryAllocation& bufferMemory)
+{
+	vkDestroyBuffer(backend.m_device, buffer, nullptr);
+	backend.m_allocator.free(bufferMemory);
+	buffer = VK_NULL_HANDLE;
 }
 
-void createImage(Vulkan_Backend& backend, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+void createImage(Vulkan_Backend& backend, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory, uint32_t mipLevels) {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = mipLevels;
 	imageInfo.arrayLayers = 1;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
@@ -117,28 +132,26 @@ void createImage(Vulkan_Backend& backend, uint32_t width, uint32_t height, VkFor
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(backend.m_device, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, backend);
-
-	if (vkAllocateMemory(backend.m_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+	imageMemory = backend.m_allocator.allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR);
 
-	vkBindImageMemory(backend.m_device, image, imageMemory, 0);
+	vkBindImageMemory(backend.m_device, image, imageMemory.memory, imageMemory.offset);
 }
 
-void copyBufferToImage(Vulkan_Backend& backend, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void destroyImage(Vulkan_Backend& backend, VkImage& image, MemoryAllocation& imageMemory)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands(backend);
+	vkDestroyImage(backend.m_device, image, nullptr);
+	backend.m_allocator.free(imageMemory);
+	image = VK_NULL_HANDLE;
+}
 
+void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel)
+{
 	VkBufferImageCopy region{};
 	region.bufferOffset = 0;
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;;
+	region.imageSubresource.mipLevel = mipLevel;
 	region.imageSubresource.baseArrayLayer = 0;
 	region.imageSubresource.layerCount= 1;
 
@@ -153,13 +166,18 @@ void copyBufferToImage(Vulkan_Backend& backend, VkBuffer buffer, VkImage image,
 		1,
 		&region
 	);
+}
 
+void copyBufferToImage(Vulkan_Backend& backend, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel)
+{
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(backend);
 
+	recordCopyBufferToImage(commandBuffer, buffer, image, width, height, mipLevel);
 
 	endSingleTimeCommands(backend, commandBuffer);
 }
 
-VkImageView createImageView(Vulkan_Backend& backend, VkImage image, VkFormat format)
+VkImageView createImageView(Vulkan_Backend& backend, VkImage image, VkFormat format, uint32_t mipLevels)
 {
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -170,7 +188,7 @@ VkImageView createImageView(Vulkan_Backend& backend, VkImage image, VkFormat for
 	viewInfo.subresourceRange.baseMipLevel = 0;
 	viewInfo.subresourceRange.layerCount = 1;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = mipLevels;
 
 	VkImageView imageView;
 	auto res = vkCreateImageView(backend.m_device, &viewInfo, nullptr, &imageView);
@@ -182,10 +200,8 @@ VkImageView createImageView(Vulkan_Backend& backend, VkImage image, VkFormat for
 	return imageView;
 }
 
-void transitionImageLayout(Vulkan_Backend& backend, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
+void recordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands(backend);
-
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = oldLayout;
@@ -197,7 +213,7 @@ void transitionImageLayout(Vulkan_Backend& backend, VkImage image, VkFormat form
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.layerCount = 1;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.levelCount = mipLevels;
 	barrier.srcAccessMask = 0;
 	barrier.dstAccessMask = 0;
 
@@ -225,20 +241,32 @@ void transitionImageLayout(Vulkan_Backend& backend, VkImage image, VkFormat form
 	}	
 
 	vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage ,0,0,nullptr,0,nullptr,1,&barrier);
+}
 
+void transitionImageLayout(Vulkan_Backend& backend, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+{
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(backend);
+
+	recordImageLayoutTransition(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
 
 	endSingleTimeCommands(backend, commandBuffer);
 }
 
+void recordCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset)
+{
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+
+	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+}
 
 void copyBuffer(Vulkan_Backend& backend, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool commandPool)
 {
 	VkCommandBuffer commandBuffer =beginSingleTimeCommands(backend);
 
-	VkBufferCopy copyRegion{};
-	copyRegion.size = size;
-	
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	recordCopyBuffer(commandBuffer, srcBuffer, dstBuffer, size, 0, 0);
 
 	endSingleTimeCommands(backend, commandBuffer);
 		
@@ -355,6 +383,59 @@ bool Vulkan_Backend::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	return requiredExtensions.empty();
 }
 
+bool Vulkan_Backend::supportsDescriptorIndexing(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+		return false;
+
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	bool extensionFound = false;
+	for (const auto& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+			extensionFound = true;
+	}
+	if (!extensionFound)
+		return false;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	//what the MaterialTable's texture array needs
+	return indexingFeatures.runtimeDescriptorArray &&
+		indexingFeatures.descriptorBindingPartiallyBound &&
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+}
+
+bool Vulkan_Backend::supportsTimelineSemaphores(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2)
+		return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return timelineFeatures.timelineSemaphore;
+}
+
 SwapChainSupportDetails Vulkan_Backend::querySwapChainSupport(VkPhysicalDevice device)
 {
 	SwapChainSupportDetails details;
@@ -525,7 +606,10 @@ void Vulkan_Backend::recreateSwapChain()
 	m_width = width;
 	m_height = height;	
 
-	vkDeviceWaitIdle(m_device);
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		vkDeviceWaitIdle(m_device);
+	}
 
 	cleanupSwapChain();
 	createSwapChain();
@@ -547,10 +631,11 @@ void Vulkan_Backend::cleanupSwapChain()
 
 }
 
-Vulkan_Backend::Vulkan_Backend()
+Vulkan_Backend::Vulkan_Backend(uint32_t framesInFlight)
 {
 	m_width = 1280;
 	m_height = 720;
+	m_framesInFlight = std::clamp<uint32_t>(framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
 	initWindow();
 	initVulkan();	
 }
@@ -582,16 +667,47 @@ void Vulkan_Backend::initVulkan()
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	m_allocator.init(*this);
+	m_pipelineCache.init(*this, PIPELINE_CACHE_PATH);
 	createCommandPool();
+	m_frames = std::make_unique<FrameScheduler>(*this, m_framesInFlight);
+	m_uploader.init(*this, STAGING_RING_SIZE);
+	m_descriptors = std::make_unique<DescriptorAllocator>(*this);
+	m_uniforms = std::make_unique<UniformRing>(*this);
+	m_jobs = std::make_unique<JobSystem>();
+	m_pipelineBuilder = std::make_unique<PipelineBuilder>(*this);
+	m_pipelineStates = std::make_unique<PipelineStateCache>(*this, *m_pipelineBuilder);
+	m_textureRegistry = std::make_unique<TextureRegistry>(*this);
+	m_materials = std::make_unique<MaterialTable>(*this);
+	m_geometryArena = std::make_unique<GeometryArena>(*this);
 	createSwapChain();
 	createImageViews();	
 }
 
 void Vulkan_Backend::cleanUp()
 {
+	//deferred destructions may free memory and descriptor sets, run them while every subsystem is still alive
+	m_frames->waitIdle();
 	cleanupSwapChain();
 
+	//drops its texture references first, the registry has to outlive them
+	m_materials.reset();
+	m_textureRegistry.reset();
+	m_geometryArena.reset();
+	//waits for compiles still in flight, they need the job system
+	m_pipelineStates.reset();
+	m_pipelineBuilder.reset();
+	//runs whatever is still queued before joining the workers
+	m_jobs.reset();
+	m_uniforms.reset();
+	m_descriptors.reset();
+	//the device is idle and nothing defers during teardown, this only destroys the frame's sync objects
+	m_frames.reset();
+	m_uploader.cleanUp();
+	m_pipelineCache.cleanUp();
 	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+	m_allocator.printStats();
+	m_allocator.cleanUp();
 	vkDestroySurfaceKHR(m_instance, m_surface, nullptr);	
 	vkDestroyDevice(m_device, nullptr);
 	vkDestroyInstance(m_instance, nullptr);
@@ -612,7 +728,8 @@ void Vulkan_Backend::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1,0,0);
 	appInfo.pEngineName = "Kr Vulkan Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	//1.1 for vkGetPhysicalDeviceFeatures2, 1.2 for timeline semaphores. both are checked per device
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -705,8 +822,46 @@ void Vulkan_Backend::createLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}		
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	//material ids index the texture array, the fallback path needs at least dynamically uniform indexing
+	deviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+
+	std::vector<const char*> extensions = deviceExtensions;
+	m_descriptorIndexing = supportsDescriptorIndexing(m_physicalDevice);
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (m_descriptorIndexing)
+	{
+		extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	}
+
+	m_timelineSemaphores = supportsTimelineSemaphores(m_physicalDevice);
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
+	void* featureChain = nullptr;
+	if (m_descriptorIndexing)
+	{
+		indexingFeatures.pNext = featureChain;
+		featureChain = &indexingFeatures;
+	}
+	if (m_timelineSemaphores)
+	{
+		timelineFeatures.pNext = featureChain;
+		featureChain = &timelineFeatures;
+	}
 
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -714,8 +869,9 @@ void Vulkan_Backend::createLogicalDevice()
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = 1;
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.pNext = featureChain;
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (enableValidationLayers)
 	{
@@ -782,7 +938,7 @@ bool Vulkan_Backend::checkValidationLayerSupport()
 	return true;
 }
 
-Vulkan_Renderer::Vulkan_Renderer() :m_viewport{ 0 }
+Vulkan_Renderer::Vulkan_Renderer(uint32_t framesInFlight) :m_backend{ framesInFlight }, m_viewport{ 0 }
 {
 	startTime = std::chrono::high_resolution_clock::now();
 
@@ -814,10 +970,42 @@ void Vulkan_Renderer::mainLoop(RenderPass* pass)
 			m_backend.m_surfParams.resized = false;
 		}
 
-		pass->RenderFrame();
+		//kick off whatever the loaders recorded since last frame and retire finished uploads
+		m_backend.m_textureRegistry->pump(TEXTURE_UPLOADS_PER_FRAME);
+		m_backend.m_uploader.submit();
+		m_backend.m_uploader.collect();
+
+		FrameScheduler& frames = *m_backend.m_frames;
+		if (!frames.beginFrame())
+		{
+			//out of date swap chain, it is recreated at the top of the next iteration
+			glfwPollEvents();
+			continue;
+		}
+
+		//the slot's previous frame completed, its per frame resources start over
+		uint32_t frame = frames.frameIndex();
+		//textures that became resident since this frame slot was last recorded
+		m_backend.m_materials->beginFrame(frame);
+		//transient descriptor sets go back to their pools, constants start at the front of the slot's region
+		m_backend.m_descriptors->beginFrame(frame);
+		m_backend.m_uniforms->beginFrame(frame);
+
+		frames.submit(pass->RenderFrame(frames.imageIndex()));
+		m_backend.m_geometryArena->endFrame();
+
+		if (!m_firstFrameDone)
+		{
+			//launch to the first submitted frame, pipelines compiled for it included. compare a first run
+			//(cold pipeline cache) against the next one
+			m_firstFrameDone = true;
+			std::cout << "[STARTUP]: first frame submitted " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_launchTime).count()
+				<< " ms after launch" << std::endl;
+			m_backend.m_pipelineCache.printStats();
+		}
 		glfwPollEvents();
 
 		
 	}
-	vkDeviceWaitIdle(m_backend.m_device);
+	m_backend.m_frames->waitIdle();
 }
@@ -5,9 +5,50 @@
 #include <optional>
 #include <vector>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include "MemoryAllocator.h"
+#include "UploadContext.h"
+#include "PipelineCache.h"
 
 class Vulkan_Backend;
-const int MAX_FRAMES_IN_FLIGHT = 2;
+class TextureRegistry;
+class GeometryArena;
+class JobSystem;
+class PipelineBuilder;
+class PipelineStateCache;
+class MaterialTable;
+class DescriptorAllocator;
+class UniformRing;
+class FrameScheduler;
+//frames the cpu records ahead of the gpu unless Vulkan_Renderer is given another count (--frames-in-flight).
+//more hides cpu spikes and keeps the gpu busy, fewer cuts input latency and per frame memory
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+//the runtime count is clamped to [1, MAX_FRAMES_IN_FLIGHT]
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+//size of the persistently mapped ring all host to device uploads go through
+const VkDeviceSize STAGING_RING_SIZE = 32ull * 1024 * 1024;
+//decoded textures uploaded per frame, spreads a burst of texture loads over several frames
+const uint32_t TEXTURE_UPLOADS_PER_FRAME = 4;
+//starting size of the shared vertex buffers (one per vertex format) and the index buffer, they grow by doubling
+const VkDeviceSize GEOMETRY_VERTEX_CAPACITY = 32ull * 1024 * 1024;
+const VkDeviceSize GEOMETRY_INDEX_CAPACITY = 8ull * 1024 * 1024;
+//largest screen space error in pixels a mesh lod may show
+const float LOD_ERROR_PIXELS = 1.0f;
+//a coarser lod has to be this much below the pixel threshold before switching to it, stops popping at the boundary
+const float LOD_HYSTERESIS = 0.25f;
+//texture array size of the MaterialTable with descriptor indexing, clamped to the device's update after bind limits
+const uint32_t BINDLESS_TEXTURE_CAPACITY = 16384;
+//without descriptor indexing the whole array is bound, has to match textures[] in shaders/bindless.glsl
+const uint32_t BINDLESS_FALLBACK_TEXTURE_CAPACITY = 64;
+//material records per frame in flight
+const uint32_t MATERIAL_CAPACITY = 4096;
+//bytes of constants (camera, pass and per draw data) a frame can allocate from the UniformRing
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 4ull * 1024 * 1024;
+//sets per descriptor pool of the DescriptorAllocator, see [DESCRIPTORS] for how many pools a scene needs
+const uint32_t DESCRIPTOR_POOL_SETS = 256;
+//driver pipeline cache blob, relative to the working directory
+const char* const PIPELINE_CACHE_PATH = "pipeline.cache";
 
 //https://vulkan-tutorial.com/Drawing_a_triangle/Presentation/Image_views
 
@@ -15,19 +56,27 @@ const int MAX_FRAMES_IN_FLIGHT = 2;
 VkCommandBuffer beginSingleTimeCommands(Vulkan_Backend& backend);
 void endSingleTimeCommands(Vulkan_Backend& backend, VkCommandBuffer cmdBuffer);
 uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, Vulkan_Backend& backend);
-void createBuffer(Vulkan_Backend& backend, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+void createBuffer(Vulkan_Backend& backend, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory);
+void destroyBuffer(Vulkan_Backend& backend, VkBuffer& buffer, MemoryAllocation& bufferMemory);
 void copyBuffer(Vulkan_Backend& backend, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkCommandPool commandPool);
-void createImage(Vulkan_Backend& backend, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+void createImage(Vulkan_Backend& backend, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory, uint32_t mipLevels = 1);
+void destroyImage(Vulkan_Backend& backend, VkImage& image, MemoryAllocation& imageMemory);
 void copyBufferToImage(Vulkan_Backend& backend,
-	VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-VkImageView createImageView(Vulkan_Backend& backend, VkImage image, VkFormat format);
+	VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel = 0);
+VkImageView createImageView(Vulkan_Backend& backend, VkImage image, VkFormat format, uint32_t mipLevels = 1);
 
 
 void transitionImageLayout(Vulkan_Backend& backend,
 	VkImage image,
 	VkFormat format,
 	VkImageLayout oldLayout,
-	VkImageLayout newLayout); 
+	VkImageLayout newLayout,
+	uint32_t mipLevels = 1); 
+
+//record only variants, used by the blocking helpers above
+void recordCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset);
+void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel = 0);
+void recordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels = 1);
 
 class RenderPass;
 
@@ -63,7 +112,7 @@ class Vulkan_Backend
 {
 public:
 	Vulkan_Backend(const Vulkan_Backend&) = delete;
-	Vulkan_Backend();
+	explicit Vulkan_Backend(uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
 	~Vulkan_Backend();
 
 	void initWindow();
@@ -80,6 +129,10 @@ public:
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 	bool isDeviceSuitable(VkPhysicalDevice device);
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	//VK_EXT_descriptor_indexing with the features the MaterialTable uses, optional
+	bool supportsDescriptorIndexing(VkPhysicalDevice device);
+	//vulkan 1.2 timeline semaphores for the FrameScheduler, optional
+	bool supportsTimelineSemaphores(VkPhysicalDevice device);
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
@@ -95,33 +148,57 @@ public:
 	VkDevice m_device;
 	VkQueue m_graphicsQueue;
 	VkQueue m_presentQueue;
+	//queues need external synchronization and uploads submit from job threads. held around every
+	//vkQueueSubmit, vkQueuePresentKHR, vkQueueWaitIdle and vkDeviceWaitIdle, the queues may be the same one
+	std::mutex m_queueMutex;
 	VkSurfaceKHR m_surface;
 	VkSwapchainKHR m_swapChain;
 	SwapChain_ParamsAndData m_swapChainParams;
 	QueueFamilyIndices m_queueFamily;
 	SurfaceParams m_surfParams{false};
+	//set by createLogicalDevice, the MaterialTable falls back to a fixed size texture array without it
+	bool m_descriptorIndexing = false;
+	//set by createLogicalDevice, the FrameScheduler falls back to a fence per frame without it
+	bool m_timelineSemaphores = false;
+	//size of every per frame resource, fixed for the backend's lifetime
+	uint32_t m_framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	//frame numbers, gpu completion, acquire/submit/present and deferred destruction
+	std::unique_ptr<FrameScheduler> m_frames;
 	VkCommandPool m_commandPool;
-	VkDescriptorPool m_descriptorPool;
+	//persistent and per frame descriptor sets, pools chain as they fill up
+	std::unique_ptr<DescriptorAllocator> m_descriptors;
+	//per frame constants, bound with dynamic offsets
+	std::unique_ptr<UniformRing> m_uniforms;
+	DeviceMemoryAllocator m_allocator;
+	UploadContext m_uploader;
+	//every pipeline is created against it, persisted across runs
+	PipelineCache m_pipelineCache;
+	//cpu side parallel work: imports, texture decode, command recording
+	std::unique_ptr<JobSystem> m_jobs;
+	//compiles pipelines on m_jobs, against m_pipelineCache
+	std::unique_ptr<PipelineBuilder> m_pipelineBuilder;
+	//owns every pipeline the passes use, identical descs share one
+	std::unique_ptr<PipelineStateCache> m_pipelineStates;
+	std::unique_ptr<TextureRegistry> m_textureRegistry;
+	//every material's textures and parameters, bound once per command buffer
+	std::unique_ptr<MaterialTable> m_materials;
+	std::unique_ptr<GeometryArena> m_geometryArena;
 		
 	int m_width;
 	int m_height;
 };
 
-struct defaultPassSemaphores {
-	VkSemaphore waitImageAvailable;
-	VkSemaphore waitRenderFinished;	
-};
-
 class Vulkan_Renderer
 {
 public:
-	Vulkan_Renderer();
+	explicit Vulkan_Renderer(uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
 	~Vulkan_Renderer();
 
 	Vulkan_Backend m_backend;
 	VkViewport m_viewport;
-	size_t currentFrame = 0;
 	std::chrono::steady_clock::time_point startTime;
+	//set once the first frame was submitted
+	bool m_firstFrameDone = false;
 	double elapsedTime;
 	double frameTime;
 	
@@ -6,10 +6,13 @@
 #include <optional>
 #include <vector>
 #include "Primitives.h"
+#include "TransformHierarchy.h"
+#include "CommandRecorder.h"
+#include "RenderGraph.h"
+#include "PipelineStateCache.h"
+#include <memory>
 #include <chrono>
 
-extern const int MAX_FRAMES_IN_FLIGHT;
-
 class Vulkan_Renderer;
 
 class ScreenQuadRenderPass : public RenderPass {
@@ -17,57 +20,76 @@ public:
 	ScreenQuadRenderPass(Vulkan_Renderer& renderer);
 	~ScreenQuadRenderPass();
 
-	virtual void RenderFrame() override;
+	virtual VkCommandBuffer RenderFrame(uint32_t imageIndex) override;
 
 	//some important parameter changed
 	virtual void freeResources() override;
 	virtual void recreateResources() override;
 
+	//keeps the loaded meshes in m_meshList and frames them with the camera
 	void loadAssets();
+	//declares the frame's render graph, the compiled quad pass is what the pipeline is built against
 	void createRenderPass();
+	//requests the pipeline from the backend's PipelineStateCache, it isn't usable before resolvePipelines
 	void createPipeline();
-	void createFramebuffers();
+	void createPipelineLayout();
+	void resolvePipelines();
 	void createCommandBuffers();
-	void createSemaphores();	
+	//re-records the frame into a primary buffer from the current frame's pools
+	VkCommandBuffer recordFrame(uint32_t imageIndex);
 	
 
-	void createImageDescriptorLayout();
 	void createDescriptorLayout();
 
-	void createUniformBuffers();
-	void updateUniformBuffer(uint32_t index);
-	void createDescriptorPool();
-	
-	void createDescriptorSets();	
-	void createImageDescriptorSets();
+	//returns the dynamic offset of the frame's globals
+	uint32_t updateUniformBuffer();
+	//meshes whose geometry is uploaded, recorded after the quad in this order
+	void collectDraws();
+	void createDescriptorSet();
 
     //https://vulkan-tutorial.com/Texture_mapping/Images
 	//layout transitions
 
 public:
 	Vulkan_Renderer& m_renderer;
-		
-	std::vector<VkSemaphore> waitImageAvailable;
-	std::vector<VkSemaphore> waitRenderFinished;
 
 	VkPipelineLayout m_pipelineLayout;
+	//owned by m_renderGraph
 	VkRenderPass m_renderPass;
-	VkPipeline m_ScreenQuadPipeline;
-	std::vector<VkFramebuffer> m_swapChainFramebuffers;	
-	std::vector<VkCommandBuffer> m_commandBuffers;	
-	std::vector<VkFence> m_inFlightFences;
-	std::vector<VkFence> m_imagesInFlight;
+	//borrowed from the PipelineStateCache, null until resolvePipelines
+	VkPipeline m_ScreenQuadPipeline = VK_NULL_HANDLE;
+	PipelineStateId m_quadPipelineState;
+	//draws m_meshList over the quad, same layout and render pass
+	VkPipeline m_meshPipeline = VK_NULL_HANDLE;
+	PipelineStateId m_meshPipelineState;
+	//passes, barriers and framebuffers of the frame, recompiled when the swap chain changes
+	std::unique_ptr<RenderGraph> m_renderGraph;
+	RenderGraphResource m_backbuffer;
+	RenderGraphResource m_depth;
+	uint32_t m_quadPass;
+	//swap chain image the frame being recorded renders to
+	uint32_t m_imageIndex = 0;
+	//per frame, per thread pools, everything is recorded again every frame
+	std::unique_ptr<CommandRecorder> m_commandRecorder;
+	//reused every frame
+	std::vector<VkCommandBuffer> m_secondaries;
 
 	VkDescriptorSetLayout m_descriptorSetLayout;	
-	VkDescriptorSetLayout m_imageDescriptorSetLayout;
 
-	std::vector<VkBuffer> m_uniformBuffers;
-	std::vector<VkDeviceMemory> m_uniformBuffersMemory;
 
-	std::vector<VkDescriptorSet> m_descriptorSets;
-	std::vector<VkDescriptorSet> m_ImageDescriptorSets;
+	//frame globals (binding 0) and per draw data (binding 1) through the backend's UniformRing,
+	//bound with m_globalsOffset and the draw's own offset
+	VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+	uint32_t m_globalsOffset = 0;
 
 	std::vector<Mesh> m_meshList;
+	//world matrices of m_meshList, indexed by Mesh::transformNode
+	TransformHierarchy m_transforms;
+	//indices into m_meshList drawn this frame
+	std::vector<uint32_t> m_draws;
+	//world space bounds of the scene, the camera sits inside them
+	glm::vec3 m_sceneMin{ 0.0f };
+	glm::vec3 m_sceneMax{ 0.0f };
 
 	std::string model_path;
 		
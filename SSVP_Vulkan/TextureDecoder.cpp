@@ -0,0 +1,107 @@
+#include "TextureDecoder.h"
+#include "stb_image.h"
+#include <iostream>
+#include <chrono>
+
+TextureDecoder::TextureDecoder(JobSystem& jobs, size_t capacity)
+	: m_jobs{ jobs }, m_capacity{ capacity > 0 ? capacity : 1 }
+{
+}
+
+TextureDecoder::~TextureDecoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+		m_requests.clear();
+	}
+
+	//decodes already running finish, their results are dropped
+	m_jobs.wait(m_pending);
+}
+
+void TextureDecoder::enqueue(DecodeRequest request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(std::move(request));
+	}
+	launch();
+}
+
+bool TextureDecoder::tryPop(DecodedImage& out)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_decoded.empty())
+			return false;
+
+		out = std::move(m_decoded.front());
+		m_decoded.pop_front();
+	}
+	launch();
+	return true;
+}
+
+void TextureDecoder::launch()
+{
+	std::vector<DecodeRequest> starting;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (!m_stopping && !m_requests.empty() && m_decoding + m_decoded.size() < m_capacity)
+		{
+			starting.push_back(std::move(m_requests.front()));
+			m_requests.pop_front();
+			m_decoding++;
+		}
+	}
+
+	for (auto& request : starting)
+	{
+		m_jobs.submit([this, request = std::move(request)]() mutable { decode(std::move(request)); }, &m_pending);
+	}
+}
+
+size_t TextureDecoder::inFlight()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_requests.size() + m_decoding + m_decoded.size();
+}
+
+double TextureDecoder::mipThroughputMPixPerSec() const
+{
+	uint64_t nanoseconds = m_mipNanoseconds.load();
+	if (nanoseconds == 0)
+		return 0.0;
+	return (m_mipPixels.load() / 1.0e6) / (nanoseconds / 1.0e9);
+}
+
+void TextureDecoder::decode(DecodeRequest request)
+{
+	DecodedImage image;
+	image.texture = request.texture;
+	image.path = request.path;
+
+	//nobody holds the texture anymore, skip the decode entirely
+	if (!request.texture.expired())
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(request.path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (pixels)
+		{
+			auto mipStart = std::chrono::steady_clock::now();
+			m_mipPixels += generateMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), true, image.mips);
+			m_mipNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mipStart).count();
+			stbi_image_free(pixels);
+		}
+		else
+		{
+			std::cout << "Texture failed to load at path: " << request.path << std::endl;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_decoding--;
+	if (!m_stopping)
+		m_decoded.push_back(std::move(image));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "MipGenerator.h"
+#include "JobSystem.h"
+
+struct Texture;
+
+struct DecodeRequest {
+	//expired by the time the decode finishes if nobody wants the texture anymore
+	std::weak_ptr<Texture> texture;
+	std::string path;
+};
+
+//full rgba8 mip chain, no levels if the file failed to decode
+struct DecodedImage {
+	std::weak_ptr<Texture> texture;
+	std::string path;
+	MipChain mips;
+};
+
+//decodes image files and builds their mip chains as jobs on the shared JobSystem
+//finished images wait in a bounded queue, a decode only starts while the decoding and finished
+//images together stay under capacity, so at most capacity decoded images are held in memory
+class TextureDecoder {
+public:
+	TextureDecoder(JobSystem& jobs, size_t capacity);
+	TextureDecoder(const TextureDecoder&) = delete;
+	TextureDecoder& operator=(const TextureDecoder&) = delete;
+	~TextureDecoder();
+
+	void enqueue(DecodeRequest request);
+	//non blocking, false if nothing finished decoding yet
+	bool tryPop(DecodedImage& out);
+	//requests queued, decoding or waiting to be popped
+	size_t inFlight();
+
+	//source pixels filtered per second by the mip stage, summed over all workers
+	double mipThroughputMPixPerSec() const;
+
+private:
+	//starts decode jobs for queued requests while there is room
+	void launch();
+	void decode(DecodeRequest request);
+
+	JobSystem& m_jobs;
+	//every decode job still running
+	JobCounter m_pending;
+	std::mutex m_mutex;
+	std::deque<DecodeRequest> m_requests;
+	std::deque<DecodedImage> m_decoded;
+	size_t m_capacity;
+	size_t m_decoding = 0;
+	bool m_stopping = false;
+
+	std::atomic<uint64_t> m_mipPixels{ 0 };
+	std::atomic<uint64_t> m_mipNanoseconds{ 0 };
+};
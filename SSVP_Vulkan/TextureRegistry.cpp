@@ -0,0 +1,166 @@
+#include "TextureRegistry.h"
+#include "Hash.h"
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <thread>
+#include <iostream>
+
+TextureRegistry::TextureRegistry(Vulkan_Backend& backend)
+	: m_backend{ backend }, m_decoder{ *backend.m_jobs, DECODE_QUEUE_CAPACITY }
+{
+}
+
+TextureRegistry::~TextureRegistry()
+{
+	TextureRegistryStats stats = getStats();
+	std::cout << "[TEXTURES]: " << stats.misses << " loaded, " << stats.hits << " reused (" << stats.coalesced << " while decoding)"
+		<< ", mip filtering " << m_decoder.mipThroughputMPixPerSec() << " MPix/s" << std::endl;
+}
+
+std::string TextureRegistry::canonicalPath(const std::string& path)
+{
+	//purely lexical so a lookup never touches the file system
+	std::string canonical = std::filesystem::path(path).lexically_normal().generic_string();
+#ifdef _WIN32
+	std::transform(canonical.begin(), canonical.end(), canonical.begin(),
+		[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+#endif
+	return canonical;
+}
+
+TextureHandle TextureRegistry::makeHandle(const std::string& path, const std::string& type)
+{
+	Texture* texture = new Texture{};
+	texture->type = type;
+	texture->path = path;
+
+	Vulkan_Backend* backend = &m_backend;
+	TextureHandle handle(texture, [backend](Texture* t) {
+		//the image may still be the target of a pending copy
+		if (t->resident.load(std::memory_order_acquire))
+		{
+			backend->m_uploader.wait(t->uploadToken);
+		}
+		t->destroyTexture(*backend);
+		delete t;
+	});
+
+	m_decoder.enqueue(DecodeRequest{ handle, path });
+	return handle;
+}
+
+TextureHandle TextureRegistry::find(const std::string& path)
+{
+	std::string canonical = canonicalPath(path);
+	uint64_t key = hashFNV1a(canonical);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end() || it->second.path != canonical)
+		return nullptr;
+
+	TextureHandle texture = it->second.texture.lock();
+	if (!texture)
+		m_entries.erase(it);
+	return texture;
+}
+
+TextureHandle TextureRegistry::acquire(const std::string& path, const std::string& type)
+{
+	std::string canonical = canonicalPath(path);
+	uint64_t key = hashFNV1a(canonical);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it != m_entries.end())
+	{
+		Entry& entry = it->second;
+		if (entry.path != canonical)
+		{
+			//64 bit collision, astronomically rare. load without registering rather than hand out the wrong image
+			std::cout << "[TEXTURES]: hash collision between " << entry.path << " and " << canonical << std::endl;
+			return makeHandle(canonical, type);
+		}
+
+		if (TextureHandle known = entry.texture.lock())
+		{
+			m_stats.hits++;
+			if (!known->resident.load(std::memory_order_acquire))
+				m_stats.coalesced++;
+			return known;
+		}
+	}
+
+	TextureHandle texture = makeHandle(canonical, type);
+	Entry& entry = m_entries[key];
+	entry.path = canonical;
+	entry.texture = texture;
+	m_stats.misses++;
+	return texture;
+}
+
+void TextureRegistry::sweepExpired()
+{
+	for (auto it = m_entries.begin(); it != m_entries.end();)
+	{
+		if (it->second.texture.expired())
+			it = m_entries.erase(it);
+		else
+			++it;
+	}
+	m_sweepThreshold = std::max<size_t>(64, m_entries.size() * 2);
+}
+
+uint32_t TextureRegistry::pump(uint32_t maxUploads)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_entries.size() >= m_sweepThreshold)
+			sweepExpired();
+	}
+
+	uint32_t uploaded = 0;
+	DecodedImage image;
+	while (uploaded < maxUploads && m_decoder.tryPop(image))
+	{
+		if (TextureHandle texture = image.texture.lock())
+		{
+			if (image.mips.levels.empty())
+				texture->createFromPixels(m_backend, nullptr, 0, 0);
+			else
+				texture->createFromMipChain(m_backend, image.mips);
+			uploaded++;
+		}
+	}
+	return uploaded;
+}
+
+bool TextureRegistry::isResident(const TextureHandle& texture)
+{
+	return texture->resident.load(std::memory_order_acquire) && m_backend.m_uploader.isComplete(texture->uploadToken);
+}
+
+void TextureRegistry::waitResident(const TextureHandle& texture)
+{
+	while (!texture->resident.load(std::memory_order_acquire))
+	{
+		//another thread may be uploading it, or it is still being decoded
+		if (pump(1) == 0)
+			std::this_thread::yield();
+	}
+	m_backend.m_uploader.wait(texture->uploadToken);
+}
+
+TextureRegistryStats TextureRegistry::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	TextureRegistryStats stats = m_stats;
+	stats.resident = 0;
+	for (auto& entry : m_entries)
+	{
+		TextureHandle texture = entry.second.texture.lock();
+		if (texture && texture->resident.load(std::memory_order_acquire)) stats.resident++;
+	}
+	return stats;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "Primitives.h"
+#include "TextureDecoder.h"
+
+struct TextureRegistryStats {
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	//hits on textures that were still decoding, served without a second decode
+	uint32_t coalesced = 0;
+	uint32_t resident = 0;
+};
+
+//one registry per backend, deduplicates textures by canonical path
+//the registry only holds weak references, textures live as long as some material uses them
+//acquire never blocks, files are decoded on worker threads and uploaded by pump()
+class TextureRegistry {
+public:
+	explicit TextureRegistry(Vulkan_Backend& backend);
+	~TextureRegistry();
+	TextureRegistry(const TextureRegistry&) = delete;
+	TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+	//returns the known texture or queues a decode, the handle becomes resident later
+	TextureHandle acquire(const std::string& path, const std::string& type);
+	//null if the texture was never requested or already released
+	TextureHandle find(const std::string& path);
+
+	//uploads up to maxUploads decoded images, returns how many were uploaded
+	//also drops entries of released textures once enough of them piled up
+	uint32_t pump(uint32_t maxUploads);
+	//image, view and sampler exist and the upload finished on the GPU
+	bool isResident(const TextureHandle& texture);
+	//pumps until the texture is resident and its upload completed
+	void waitResident(const TextureHandle& texture);
+
+	TextureRegistryStats getStats();
+
+	//lexically normalized, forward slashes, lower case on windows
+	static std::string canonicalPath(const std::string& path);
+
+	//decoded images waiting for upload, bounds the memory held by decoded pixels
+	static const size_t DECODE_QUEUE_CAPACITY = 8;
+
+private:
+	struct Entry {
+		std::string path;
+		std::weak_ptr<Texture> texture;
+	};
+
+	TextureHandle makeHandle(const std::string& path, const std::string& type);
+	//erases the entries whose texture was released, m_mutex has to be held
+	void sweepExpired();
+
+	Vulkan_Backend& m_backend;
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, Entry> m_entries;
+	//entry count that triggers the next sweep, doubles with the live entries so sweeping stays amortized O(1)
+	size_t m_sweepThreshold = 64;
+	TextureRegistryStats m_stats;
+	//declared last so workers are joined before anything else goes away
+	TextureDecoder m_decoder;
+};
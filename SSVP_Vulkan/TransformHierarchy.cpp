@@ -0,0 +1,113 @@
+#include "TransformHierarchy.h"
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_SSE 1
+#endif
+
+//out = a * b, column major like glm. out may not alias a or b
+static inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+	const float* pa = &a[0][0];
+	const float* pb = &b[0][0];
+	float* po = &out[0][0];
+#ifdef TRANSFORM_SSE
+	__m128 a0 = _mm_loadu_ps(pa);
+	__m128 a1 = _mm_loadu_ps(pa + 4);
+	__m128 a2 = _mm_loadu_ps(pa + 8);
+	__m128 a3 = _mm_loadu_ps(pa + 12);
+	for (int c = 0; c < 4; ++c)
+	{
+		const float* column = pb + c * 4;
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+		_mm_storeu_ps(po + c * 4, r);
+	}
+#else
+	for (int c = 0; c < 4; ++c)
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			po[c * 4 + r] = pa[r] * pb[c * 4] + pa[4 + r] * pb[c * 4 + 1] + pa[8 + r] * pb[c * 4 + 2] + pa[12 + r] * pb[c * 4 + 3];
+		}
+	}
+#endif
+}
+
+uint32_t TransformHierarchy::addNode(int32_t parent, const glm::mat4& local)
+{
+	if (parent != NO_PARENT && (parent < 0 || static_cast<uint32_t>(parent) >= size()))
+	{
+		throw std::runtime_error("transform parent has to be added before its children");
+	}
+
+	uint32_t node = size();
+	m_parents.push_back(parent);
+	m_local.push_back(local);
+	m_world.push_back(local);
+	m_dirty.push_back(1);
+	m_firstDirty = std::min(m_firstDirty, node);
+	return node;
+}
+
+uint32_t TransformHierarchy::addNodes(const SceneNode* nodes, size_t count, int32_t parent)
+{
+	uint32_t base = size();
+	m_parents.reserve(base + count);
+	m_local.reserve(base + count);
+	m_world.reserve(base + count);
+	m_dirty.reserve(base + count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		int32_t nodeParent = nodes[i].parent == NO_PARENT ? parent : static_cast<int32_t>(base) + nodes[i].parent;
+		addNode(nodeParent, nodes[i].local);
+	}
+	return base;
+}
+
+void TransformHierarchy::setLocal(uint32_t node, const glm::mat4& local)
+{
+	m_local[node] = local;
+	m_dirty[node] = 1;
+	m_firstDirty = std::min(m_firstDirty, node);
+}
+
+uint32_t TransformHierarchy::updateWorld()
+{
+	const uint32_t count = size();
+	uint32_t updated = 0;
+
+	//a parent is always visited before its children, so its flag already includes every dirty ancestor
+	for (uint32_t i = m_firstDirty; i < count; ++i)
+	{
+		int32_t parent = m_parents[i];
+		uint8_t dirty = m_dirty[i] | (parent != NO_PARENT ? m_dirty[parent] : 0);
+		if (!dirty)
+			continue;
+
+		m_dirty[i] = 1;
+		if (parent == NO_PARENT)
+			m_world[i] = m_local[i];
+		else
+			multiply(m_world[parent], m_local[i], m_world[i]);
+		updated++;
+	}
+
+	if (m_firstDirty < count)
+		std::fill(m_dirty.begin() + m_firstDirty, m_dirty.end(), 0);
+	m_firstDirty = count;
+	return updated;
+}
+
+void TransformHierarchy::clear()
+{
+	m_parents.clear();
+	m_local.clear();
+	m_world.clear();
+	m_dirty.clear();
+	m_firstDirty = 0;
+}
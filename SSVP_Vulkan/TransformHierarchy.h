@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+//one node of an imported hierarchy, parent indexes the same list and always comes before the node
+//stored as is in the mesh cache, so only plain data in here
+struct SceneNode {
+	int32_t parent;
+	glm::mat4 local;
+};
+
+//flattened node hierarchy, parents are always stored before their children so a single linear pass
+//updates every world matrix. structure of arrays, the update loop only streams through the parent
+//indices, dirty flags and the two matrix arrays
+class TransformHierarchy {
+public:
+	static const int32_t NO_PARENT = -1;
+
+	//parent has to be an existing node or NO_PARENT
+	uint32_t addNode(int32_t parent, const glm::mat4& local);
+	//appends a whole imported hierarchy, its roots become children of parent. returns the index of nodes[0]
+	uint32_t addNodes(const SceneNode* nodes, size_t count, int32_t parent = NO_PARENT);
+
+	//marks the node dirty, its world matrix and those below it are recomputed by the next updateWorld
+	void setLocal(uint32_t node, const glm::mat4& local);
+
+	//recomputes the world matrices of the dirty nodes and their descendants, returns how many were recomputed
+	uint32_t updateWorld();
+
+	//object to world, current as of the last updateWorld
+	const glm::mat4& world(uint32_t node) const { return m_world[node]; }
+	uint32_t size() const { return static_cast<uint32_t>(m_parents.size()); }
+	void clear();
+
+public:
+	std::vector<int32_t> m_parents;
+	std::vector<glm::mat4> m_local;
+	std::vector<glm::mat4> m_world;
+	std::vector<uint8_t> m_dirty;
+	//every node before this one is clean, updateWorld starts here
+	uint32_t m_firstDirty = 0;
+};
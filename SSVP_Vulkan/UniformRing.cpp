@@ -0,0 +1,74 @@
+#include "UniformRing.h"
+#include "Renderer.h"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformRing::UniformRing(Vulkan_Backend& backend) : m_backend{ backend }
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(backend.m_physicalDevice, &properties);
+	//both are powers of two, the larger one satisfies the other
+	m_alignment = std::max<VkDeviceSize>({ 1, properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment });
+	m_frameSize = alignUp(UNIFORM_RING_FRAME_SIZE, m_alignment);
+
+	createBuffer(backend, m_frameSize * backend.m_framesInFlight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_buffer, m_memory);
+	if (!m_memory.mapped)
+		throw std::runtime_error("uniform ring memory isn't mapped");
+}
+
+UniformRing::~UniformRing()
+{
+	printStats();
+	destroyBuffer(m_backend, m_buffer, m_memory);
+}
+
+void UniformRing::beginFrame(uint32_t frame)
+{
+	if (m_frames > 0)
+		m_peakBytes = std::max(m_peakBytes, m_head.load(std::memory_order_relaxed));
+	m_frames++;
+
+	m_frameBase = m_frameSize * frame;
+	m_head.store(0, std::memory_order_relaxed);
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size)
+{
+	VkDeviceSize alignedSize = alignUp(size, m_alignment);
+	VkDeviceSize offset = m_head.fetch_add(alignedSize, std::memory_order_relaxed);
+	if (offset + alignedSize > m_frameSize)
+		throw std::runtime_error("uniform ring frame region is full, raise UNIFORM_RING_FRAME_SIZE");
+
+	m_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	UniformAllocation allocation;
+	allocation.offset = static_cast<uint32_t>(m_frameBase + offset);
+	allocation.data = static_cast<char*>(m_memory.mapped) + allocation.offset;
+	return allocation;
+}
+
+VkDescriptorBufferInfo UniformRing::descriptorInfo(VkDeviceSize range) const
+{
+	VkDescriptorBufferInfo info{};
+	info.buffer = m_buffer;
+	info.offset = 0;
+	info.range = range;
+	return info;
+}
+
+void UniformRing::printStats() const
+{
+	if (m_frames == 0)
+		return;
+
+	VkDeviceSize peak = std::max(m_peakBytes, m_head.load(std::memory_order_relaxed));
+	std::cout << "[UNIFORMS]: " << peak / 1024 << " / " << m_frameSize / 1024 << " KB peak per frame, "
+		<< m_allocations.load(std::memory_order_relaxed) / m_frames << " allocations per frame, " << m_alignment << " byte alignment" << std::endl;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include "MemoryAllocator.h"
+
+class Vulkan_Backend;
+
+struct UniformAllocation {
+	//mapped, host coherent, write only
+	void* data = nullptr;
+	//dynamic offset for a UNIFORM_BUFFER_DYNAMIC or STORAGE_BUFFER_DYNAMIC descriptor of buffer()
+	uint32_t offset = 0;
+};
+
+//per frame constants (camera, pass and per draw data) out of one persistently mapped buffer.
+//every frame in flight owns a region of UNIFORM_RING_FRAME_SIZE bytes that is bump allocated and
+//starts over in beginFrame. descriptors point at the buffer once with a fixed range and draws pick
+//their data with dynamic offsets, so no memory is mapped and no set is written per frame
+class UniformRing {
+public:
+	explicit UniformRing(Vulkan_Backend& backend);
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+	~UniformRing();
+
+	//the frame slot's previous submission has to be complete
+	void beginFrame(uint32_t frame);
+
+	//aligned for uniform and storage offsets, any thread. throws when the frame's region is full
+	UniformAllocation allocate(VkDeviceSize size);
+	//copies value in, returns its dynamic offset
+	template<typename T>
+	uint32_t push(const T& value)
+	{
+		UniformAllocation allocation = allocate(sizeof(T));
+		memcpy(allocation.data, &value, sizeof(T));
+		return allocation.offset;
+	}
+
+	VkBuffer buffer() const { return m_buffer; }
+	//for the descriptor write, range is what one dynamic offset exposes to the shader
+	VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const;
+
+	void printStats() const;
+
+private:
+	Vulkan_Backend& m_backend;
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	MemoryAllocation m_memory;
+	VkDeviceSize m_alignment = 1;
+	VkDeviceSize m_frameSize = 0;
+
+	VkDeviceSize m_frameBase = 0;
+	//bytes handed out in the current frame
+	std::atomic<VkDeviceSize> m_head{ 0 };
+
+	uint64_t m_frames = 0;
+	VkDeviceSize m_peakBytes = 0;
+	std::atomic<uint64_t> m_allocations{ 0 };
+};
@@ -0,0 +1,339 @@
+#include "UploadContext.h"
+#include "Renderer.h"
+#include "AssetUtilities.h"
+#include <stdexcept>
+#include <iostream>
+#include <numeric>
+#include <algorithm>
+#include <cstring>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void UploadContext::init(Vulkan_Backend& backend, VkDeviceSize stagingSize)
+{
+	m_backend = &backend;
+
+	QueueFamilyIndices queueFamilyIndices = backend.findQueueFamilies(backend.m_physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(backend.m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(backend.m_physicalDevice, &properties);
+	m_stagingAlignment = std::max<VkDeviceSize>(m_stagingAlignment, properties.limits.optimalBufferCopyOffsetAlignment);
+
+	m_stagingSize = alignUp(stagingSize, m_stagingAlignment);
+	createBuffer(backend, m_stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_stagingBuffer, m_stagingMemory);
+}
+
+void UploadContext::cleanUp()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	submit();
+	waitAll();
+
+	for (auto& batch : m_freeBatches)
+	{
+		vkDestroyFence(m_backend->m_device, batch.fence, nullptr);
+	}
+	m_freeBatches.clear();
+
+	if (m_stagingStalls > 0)
+	{
+		std::cout << "[UPLOAD]: staging ring ran full " << m_stagingStalls << " times, consider a bigger STAGING_RING_SIZE" << std::endl;
+	}
+	destroyBuffer(*m_backend, m_stagingBuffer, m_stagingMemory);
+
+	vkDestroyCommandPool(m_backend->m_device, m_commandPool, nullptr);
+	m_commandPool = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer UploadContext::recordingCommandBuffer()
+{
+	if (m_isRecording)
+		return m_recording.commandBuffer;
+
+	if (!m_freeBatches.empty())
+	{
+		m_recording = std::move(m_freeBatches.back());
+		m_freeBatches.pop_back();
+		vkResetCommandBuffer(m_recording.commandBuffer, 0);
+	}
+	else
+	{
+		m_recording = Batch{};
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = m_commandPool;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(m_backend->m_device, &allocInfo, &m_recording.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(m_backend->m_device, &fenceInfo, nullptr, &m_recording.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(m_recording.commandBuffer, &beginInfo);
+
+	m_recording.token = m_nextToken;
+	m_isRecording = true;
+	return m_recording.commandBuffer;
+}
+
+bool UploadContext::tryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset)
+{
+	//nothing alive in the ring, restart at the beginning so a full size slice can fit
+	if (m_head == m_tail)
+	{
+		m_head = alignUp(m_head, m_stagingSize);
+		m_tail = m_head;
+	}
+
+	VkDeviceSize lapStart = m_head - m_head % m_stagingSize;
+	VkDeviceSize physical = alignUp(m_head % m_stagingSize, alignment);
+	if (physical + size > m_stagingSize)
+	{
+		//slices never wrap, skip the rest of this lap
+		lapStart += m_stagingSize;
+		physical = 0;
+	}
+
+	VkDeviceSize end = lapStart + physical + size;
+	if (end - m_tail > m_stagingSize)
+		return false;
+
+	m_head = end;
+	outOffset = physical;
+	return true;
+}
+
+VkDeviceSize UploadContext::allocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+	if (size > m_stagingSize)
+	{
+		throw std::runtime_error("upload slice bigger than the staging ring");
+	}
+
+	VkDeviceSize offset = 0;
+	while (!tryAllocateStaging(size, alignment, offset))
+	{
+		//the recording batch may be the one holding the ring, it has to go out before it can retire
+		if (m_inFlight.empty())
+		{
+			submit();
+		}
+		if (m_inFlight.empty())
+		{
+			throw std::runtime_error("staging ring is full but no upload is in flight");
+		}
+		m_stagingStalls++;
+		retireOldest();
+	}
+	return offset;
+}
+
+void UploadContext::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	//a quarter of the ring per copy lets the next chunk be written while the GPU copies the previous one
+	const VkDeviceSize maxChunk = std::max(m_stagingSize / 4, m_stagingAlignment);
+	const char* src = static_cast<const char*>(data);
+
+	VkDeviceSize done = 0;
+	while (done < size)
+	{
+		VkDeviceSize chunk = std::min(size - done, maxChunk);
+		VkDeviceSize offset = allocateStaging(chunk, m_stagingAlignment);
+		memcpy(static_cast<char*>(m_stagingMemory.mapped) + offset, src + done, static_cast<size_t>(chunk));
+		recordCopyBuffer(recordingCommandBuffer(), m_stagingBuffer, dst, chunk, offset, dstOffset + done);
+		done += chunk;
+	}
+}
+
+void UploadContext::uploadImage(VkImage image, const void* pixels, uint32_t width, uint32_t height, uint32_t texelSize, uint32_t mipLevel)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	const VkDeviceSize maxChunk = std::max(m_stagingSize / 4, m_stagingAlignment);
+	const VkDeviceSize rowPitch = static_cast<VkDeviceSize>(width) * texelSize;
+	//buffer offsets of image copies have to be a multiple of both 4 and the texel size
+	const VkDeviceSize alignment = std::lcm(m_stagingAlignment, std::lcm<VkDeviceSize>(texelSize, 4));
+	const uint32_t rowsPerChunk = static_cast<uint32_t>(std::max<VkDeviceSize>(1, maxChunk / rowPitch));
+	const char* src = static_cast<const char*>(pixels);
+
+	uint32_t row = 0;
+	while (row < height)
+	{
+		uint32_t rows = std::min(rowsPerChunk, height - row);
+		VkDeviceSize chunk = rowPitch * rows;
+		VkDeviceSize offset = allocateStaging(chunk, alignment);
+		memcpy(static_cast<char*>(m_stagingMemory.mapped) + offset, src + rowPitch * row, static_cast<size_t>(chunk));
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = mipLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, static_cast<int32_t>(row), 0 };
+		region.imageExtent = { width, rows, 1 };
+
+		vkCmdCopyBufferToImage(recordingCommandBuffer(), m_stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		row += rows;
+	}
+}
+
+void UploadContext::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	recordCopyBuffer(recordingCommandBuffer(), srcBuffer, dstBuffer, size, srcOffset, dstOffset);
+}
+
+void UploadContext::barrier()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(recordingCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void UploadContext::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	recordImageLayoutTransition(recordingCommandBuffer(), image, format, oldLayout, newLayout, mipLevels);
+}
+
+void UploadContext::releaseAfterCompletion(VkBuffer buffer, const MemoryAllocation& allocation)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	recordingCommandBuffer();
+	m_recording.releases.emplace_back(buffer, allocation);
+}
+
+UploadToken UploadContext::submit()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	if (!m_isRecording)
+		return m_completedToken;
+
+	//make every transfer write visible to whatever the following frame submissions read
+	//image layouts are already handled by the transitions recorded with the copies
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+		VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(m_recording.commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkEndCommandBuffer(m_recording.commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_recording.commandBuffer;
+
+	{
+		std::lock_guard<std::mutex> queueLock(m_backend->m_queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(m_backend->m_graphicsQueue, 1, &submitInfo, m_recording.fence), "failed to submit upload batch");
+	}
+
+	UploadToken token = m_recording.token;
+	m_recording.ringEnd = m_head;
+	m_inFlight.push_back(std::move(m_recording));
+	m_recording = Batch{};
+	m_isRecording = false;
+	m_nextToken++;
+	return token;
+}
+
+void UploadContext::retire(Batch& batch)
+{
+	for (auto& release : batch.releases)
+	{
+		destroyBuffer(*m_backend, release.first, release.second);
+	}
+	batch.releases.clear();
+
+	vkResetFences(m_backend->m_device, 1, &batch.fence);
+	m_completedToken = batch.token;
+	m_tail = std::max(m_tail, batch.ringEnd);
+	m_freeBatches.push_back(std::move(batch));
+}
+
+void UploadContext::collect()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	//batches go through one queue, so they complete in submission order
+	while (!m_inFlight.empty() && vkGetFenceStatus(m_backend->m_device, m_inFlight.front().fence) == VK_SUCCESS)
+	{
+		retire(m_inFlight.front());
+		m_inFlight.pop_front();
+	}
+}
+
+bool UploadContext::isComplete(UploadToken token)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	if (token <= m_completedToken)
+		return true;
+
+	collect();
+	return token <= m_completedToken;
+}
+
+void UploadContext::wait(UploadToken token)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	if (token <= m_completedToken)
+		return;
+
+	if (m_isRecording && token >= m_recording.token)
+		submit();
+
+	while (!m_inFlight.empty() && m_inFlight.front().token <= token)
+	{
+		retireOldest();
+	}
+}
+
+void UploadContext::waitAll()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	while (!m_inFlight.empty())
+	{
+		retireOldest();
+	}
+}
+
+void UploadContext::retireOldest()
+{
+	vkWaitForFences(m_backend->m_device, 1, &m_inFlight.front().fence, VK_TRUE, UINT64_MAX);
+	retire(m_inFlight.front());
+	m_inFlight.pop_front();
+}
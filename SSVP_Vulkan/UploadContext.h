@@ -0,0 +1,88 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <mutex>
+#include "MemoryAllocator.h"
+
+class Vulkan_Backend;
+
+//monotonic id of an upload batch, a resource is usable once its token completed
+typedef uint64_t UploadToken;
+
+//batches transfer work (buffer copies, image copies, layout transitions) into one
+//command buffer per submit instead of a vkQueueWaitIdle per copy
+//host data goes through one persistently mapped staging ring, slices are recycled
+//when the batch that used them retires
+//all public calls are serialized, loader threads and the render thread can share one context
+class UploadContext {
+public:
+	void init(Vulkan_Backend& backend, VkDeviceSize stagingSize);
+	void cleanUp();
+
+	//copies host data into dst, split into several copies if it doesn't fit the ring at once
+	void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	//copies tightly packed texels into one mip level of an image in TRANSFER_DST_OPTIMAL layout, split by rows
+	void uploadImage(VkImage image, const void* pixels, uint32_t width, uint32_t height, uint32_t texelSize, uint32_t mipLevel = 0);
+
+	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
+	//transfers recorded after this see the writes of every transfer recorded before, copies are unordered otherwise
+	void barrier();
+	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels = 1);
+	void releaseAfterCompletion(VkBuffer buffer, const MemoryAllocation& allocation);
+
+	//token of the batch currently being recorded, completes after the next submit
+	UploadToken currentToken() const { std::lock_guard<std::recursive_mutex> lock(m_mutex); return m_nextToken; }
+	//submits the recorded batch, no-op if nothing was recorded
+	UploadToken submit();
+	//polls fences, frees deferred buffers and staging slices of finished batches
+	void collect();
+
+	bool isComplete(UploadToken token);
+	void wait(UploadToken token);
+	void waitAll();
+
+private:
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		UploadToken token = 0;
+		//ring position after the last slice of this batch, the tail moves here on retire
+		VkDeviceSize ringEnd = 0;
+		std::vector<std::pair<VkBuffer, MemoryAllocation>> releases;
+	};
+
+	VkCommandBuffer recordingCommandBuffer();
+	void retire(Batch& batch);
+	void retireOldest();
+
+	//returns the physical offset of a slice in the staging buffer, blocks on old batches when the ring is full
+	VkDeviceSize allocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+	bool tryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset);
+
+	Vulkan_Backend* m_backend = nullptr;
+	//recursive, wait() and the staging allocator call submit() themselves
+	mutable std::recursive_mutex m_mutex;
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+	Batch m_recording;
+	bool m_isRecording = false;
+	std::deque<Batch> m_inFlight;
+	std::vector<Batch> m_freeBatches;
+
+	UploadToken m_nextToken = 1;
+	UploadToken m_completedToken = 0;
+
+	//staging ring, head and tail are virtual offsets that only grow, physical = virtual % size
+	VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_stagingMemory;
+	VkDeviceSize m_stagingSize = 0;
+	VkDeviceSize m_stagingAlignment = 16;
+	VkDeviceSize m_head = 0;
+	VkDeviceSize m_tail = 0;
+	//number of times the ring ran full and had to wait on the GPU
+	uint32_t m_stagingStalls = 0;
+};
@@ -1,5 +1,6 @@
 #include "VertexBuffer.h"
 #include <stdexcept>
+#include <algorithm>
 #include "Renderer.h"
 
 //INSIGHT: This should belong in a backend perhaps?
@@ -7,7 +8,7 @@ VertexBuffer::VertexBuffer()
 {
 }
 
-VertexBuffer::VertexBuffer(std::vector<vertex> data, std::vector<uint16_t> ind, Vulkan_Backend& backend, VkCommandPool commandPool)
+VertexBuffer::VertexBuffer(std::vector<vertex> data, std::vector<uint32_t> ind, Vulkan_Backend& backend, VkCommandPool commandPool)
 {
 	createVertexBuffer(data, backend,commandPool);
 	createIndexBuffer(  ind   ,backend, commandPool);
@@ -15,51 +16,38 @@ VertexBuffer::VertexBuffer(std::vector<vertex> data, std::vector<uint16_t> ind,
 
 void VertexBuffer::destroyVertexBuffer(Vulkan_Backend& backend)
 {
-	vkDestroyBuffer(backend.m_device, m_vertexBuffer, nullptr);
-	vkFreeMemory(backend.m_device, m_vertexBufferMemory, nullptr);
+	destroyBuffer(backend, m_vertexBuffer, m_vertexBufferMemory);
 }
 
 void VertexBuffer::createVertexBuffer(std::vector<vertex> data, Vulkan_Backend& backend, VkCommandPool commandPool)
 {
 	VkDeviceSize bufferSize = sizeof(data[0]) * data.size();
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	createBuffer(backend, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void* memData;
-	vkMapMemory(backend.m_device, m_vertexBufferMemory, 0, bufferSize, 0, &memData);
-	memcpy(memData, data.data(), (size_t)bufferSize);
-	vkUnmapMemory(backend.m_device, m_vertexBufferMemory);
-
 	createBuffer(backend, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
 
-	copyBuffer(backend, stagingBuffer, m_vertexBuffer, bufferSize, commandPool);
-
-
-	vkDestroyBuffer(backend.m_device, stagingBuffer, nullptr);
-	vkFreeMemory(backend.m_device, stagingBufferMemory, nullptr);
+	backend.m_uploader.uploadBuffer(m_vertexBuffer, 0, data.data(), bufferSize);
+	uploadToken = backend.m_uploader.currentToken();
 }
 
-void VertexBuffer::createIndexBuffer(std::vector<uint16_t> data, Vulkan_Backend& backend, VkCommandPool commandPool) {
-	VkDeviceSize bufferSize = sizeof(data[0]) * data.size();
+void VertexBuffer::createIndexBuffer(std::vector<uint32_t> data, Vulkan_Backend& backend, VkCommandPool commandPool) {
+	m_indexCount = static_cast<uint32_t>(data.size());
+	uint32_t maxIndex = data.empty() ? 0 : *std::max_element(data.begin(), data.end());
+	m_indexType = maxIndex > UINT16_MAX ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(backend, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	std::vector<uint16_t> narrowData;
+	const void* uploadData = data.data();
+	if (m_indexType == VK_INDEX_TYPE_UINT16)
+	{
+		narrowData.resize(data.size());
+		for (size_t i = 0; i < data.size(); ++i)
+			narrowData[i] = static_cast<uint16_t>(data[i]);
+		uploadData = narrowData.data();
+	}
 
-	void* memData;
-	vkMapMemory(backend.m_device, stagingBufferMemory, 0, bufferSize, 0, &memData);
-	memcpy(memData, data.data(), (size_t)bufferSize);
-	vkUnmapMemory(backend.m_device, stagingBufferMemory);
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(indexSizeOf(m_indexType)) * data.size();
 
 	createBuffer(backend, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
 
-	copyBuffer(backend, stagingBuffer, m_indexBuffer, bufferSize, commandPool);
-
-	vkDestroyBuffer(backend.m_device, stagingBuffer, nullptr);
-	vkFreeMemory(backend.m_device, stagingBufferMemory, nullptr);
+	backend.m_uploader.uploadBuffer(m_indexBuffer, 0, uploadData, bufferSize);
+	uploadToken = backend.m_uploader.currentToken();
 }
-
-
@@ -12,16 +12,20 @@
 class VertexBuffer {
 public:
 	VertexBuffer();
-	VertexBuffer(std::vector<vertex> data, std::vector<uint16_t> ind, Vulkan_Backend& backend, VkCommandPool commandPool);
+	VertexBuffer(std::vector<vertex> data, std::vector<uint32_t> ind, Vulkan_Backend& backend, VkCommandPool commandPool);
 	
 	VkBuffer m_vertexBuffer;
-	VkDeviceMemory m_vertexBufferMemory;
+	MemoryAllocation m_vertexBufferMemory;
 	VkBuffer m_indexBuffer;
-	VkDeviceMemory m_indexBufferMemory;	
+	MemoryAllocation m_indexBufferMemory;
+	//16 bit unless an index doesn't fit
+	VkIndexType m_indexType = VK_INDEX_TYPE_UINT16;
+	uint32_t m_indexCount = 0;
+	UploadToken uploadToken = 0;
 
 	void destroyVertexBuffer(Vulkan_Backend& backend);
 	void createVertexBuffer(std::vector<vertex> data, Vulkan_Backend& backend, VkCommandPool commandPool);
-	void createIndexBuffer(std::vector<uint16_t> data, Vulkan_Backend& backend, VkCommandPool commandPool);
+	void createIndexBuffer(std::vector<uint32_t> data, Vulkan_Backend& backend, VkCommandPool commandPool);
 
 		
 };
@@ -0,0 +1,231 @@
+#include "VertexPacking.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xffu) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffffu;
+
+	if (((bits >> 23) & 0xffu) == 0xffu)
+	{
+		//inf / nan
+		return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+	}
+	if (exponent >= 31)
+	{
+		return static_cast<uint16_t>(sign | 0x7c00u);
+	}
+	if (exponent <= 0)
+	{
+		//denormal or zero
+		if (exponent < -10)
+			return static_cast<uint16_t>(sign);
+
+		mantissa |= 0x800000u;
+		uint32_t shift = static_cast<uint32_t>(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1u)))
+			half++;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fffu;
+	//carry into the exponent is the correct result for round up
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+		half++;
+	return static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t value)
+{
+	uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+	uint32_t exponent = (value >> 10) & 0x1fu;
+	uint32_t mantissa = value & 0x3ffu;
+
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		if (mantissa == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			//renormalize
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400u) == 0)
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+		}
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+static uint16_t toUnorm16(float v)
+{
+	return static_cast<uint16_t>(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f));
+}
+
+static int16_t toSnorm16(float v)
+{
+	return static_cast<int16_t>(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f));
+}
+
+void computeBounds(const vertex* vertices, uint32_t count, glm::vec3& outMin, glm::vec3& outExtent)
+{
+	if (count == 0)
+	{
+		outMin = glm::vec3(0.0f);
+		outExtent = glm::vec3(0.0f);
+		return;
+	}
+
+	glm::vec3 lo = vertices[0].pos;
+	glm::vec3 hi = vertices[0].pos;
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		lo = glm::min(lo, vertices[i].pos);
+		hi = glm::max(hi, vertices[i].pos);
+	}
+	outMin = lo;
+	outExtent = hi - lo;
+}
+
+//orthonormal tangent frame as a unit quaternion (x, y, z, w)
+static glm::vec4 frameToQuaternion(const glm::vec3& t, const glm::vec3& b, const glm::vec3& n)
+{
+	//columns t, b, n form a rotation matrix, m[col][row] like glm
+	float m00 = t.x, m01 = b.x, m02 = n.x;
+	float m10 = t.y, m11 = b.y, m12 = n.y;
+	float m20 = t.z, m21 = b.z, m22 = n.z;
+
+	glm::vec4 q;
+	float trace = m00 + m11 + m22;
+	if (trace > 0.0f)
+	{
+		float s = std::sqrt(trace + 1.0f) * 2.0f;
+		q = glm::vec4((m21 - m12) / s, (m02 - m20) / s, (m10 - m01) / s, 0.25f * s);
+	}
+	else if (m00 > m11 && m00 > m22)
+	{
+		float s = std::sqrt(1.0f + m00 - m11 - m22) * 2.0f;
+		q = glm::vec4(0.25f * s, (m01 + m10) / s, (m02 + m20) / s, (m21 - m12) / s);
+	}
+	else if (m11 > m22)
+	{
+		float s = std::sqrt(1.0f + m11 - m00 - m22) * 2.0f;
+		q = glm::vec4((m01 + m10) / s, 0.25f * s, (m12 + m21) / s, (m02 - m20) / s);
+	}
+	else
+	{
+		float s = std::sqrt(1.0f + m22 - m00 - m11) * 2.0f;
+		q = glm::vec4((m02 + m20) / s, (m12 + m21) / s, 0.25f * s, (m10 - m01) / s);
+	}
+	return glm::normalize(q);
+}
+
+static glm::vec3 anyPerpendicular(const glm::vec3& n)
+{
+	glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	return glm::normalize(glm::cross(axis, n));
+}
+
+void encodePackedVertices(const vertex* vertices, uint32_t count, const glm::vec3& boundsMin, const glm::vec3& boundsExtent,
+	std::vector<packedVertex>& out)
+{
+	//flat axes would divide by zero, any value decodes to boundsMin there
+	glm::vec3 invExtent(
+		boundsExtent.x > 0.0f ? 1.0f / boundsExtent.x : 0.0f,
+		boundsExtent.y > 0.0f ? 1.0f / boundsExtent.y : 0.0f,
+		boundsExtent.z > 0.0f ? 1.0f / boundsExtent.z : 0.0f);
+
+	//smallest |w| a snorm16 can hold without collapsing to zero, a zero w would lose the handedness sign
+	const float minW = 1.0f / 32767.0f;
+
+	out.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const vertex& v = vertices[i];
+		packedVertex& p = out[i];
+
+		glm::vec3 rel = (v.pos - boundsMin) * invExtent;
+		p.pos[0] = toUnorm16(rel.x);
+		p.pos[1] = toUnorm16(rel.y);
+		p.pos[2] = toUnorm16(rel.z);
+		p.pos[3] = 0;
+
+		p.uv[0] = floatToHalf(v.uv.x);
+		p.uv[1] = floatToHalf(v.uv.y);
+
+		//gram-schmidt, the importer's tangents are not guaranteed orthogonal to the normal
+		glm::vec3 n = glm::length(v.normal) > 0.0f ? glm::normalize(v.normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+		glm::vec3 t = v.tangent - n * glm::dot(n, v.tangent);
+		t = glm::length(t) > 1e-6f ? glm::normalize(t) : anyPerpendicular(n);
+		float handedness = glm::dot(glm::cross(n, t), v.bitangent) < 0.0f ? -1.0f : 1.0f;
+		glm::vec3 b = glm::cross(n, t);
+
+		glm::vec4 q = frameToQuaternion(t, b, n);
+		//q and -q are the same rotation, canonicalize to w > 0 so the sign of w is free for the handedness
+		if (q.w < 0.0f)
+			q = -q;
+		if (q.w < minW)
+		{
+			float scale = std::sqrt(1.0f - minW * minW);
+			q = glm::vec4(q.x * scale, q.y * scale, q.z * scale, minW);
+		}
+		//rotation math is quadratic in q, negating the whole quaternion keeps the frame and flips w
+		if (handedness < 0.0f)
+			q = -q;
+
+		p.qtangent[0] = toSnorm16(q.x);
+		p.qtangent[1] = toSnorm16(q.y);
+		p.qtangent[2] = toSnorm16(q.z);
+		p.qtangent[3] = toSnorm16(q.w);
+	}
+}
+
+vertex decodePackedVertex(const packedVertex& p, const glm::vec3& boundsMin, const glm::vec3& boundsExtent)
+{
+	vertex v;
+	v.pos = boundsMin + glm::vec3(p.pos[0], p.pos[1], p.pos[2]) / 65535.0f * boundsExtent;
+	v.uv = glm::vec2(halfToFloat(p.uv[0]), halfToFloat(p.uv[1]));
+
+	glm::vec4 q = glm::vec4(p.qtangent[0], p.qtangent[1], p.qtangent[2], p.qtangent[3]) / 32767.0f;
+	float handedness = q.w < 0.0f ? -1.0f : 1.0f;
+	q = glm::normalize(q);
+
+	//first and third column of the rotation matrix
+	v.tangent = glm::vec3(
+		1.0f - 2.0f * (q.y * q.y + q.z * q.z),
+		2.0f * (q.x * q.y + q.w * q.z),
+		2.0f * (q.x * q.z - q.w * q.y));
+	v.normal = glm::vec3(
+		2.0f * (q.x * q.z + q.w * q.y),
+		2.0f * (q.y * q.z - q.w * q.x),
+		1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+	v.bitangent = glm::cross(v.normal, v.tangent) * handedness;
+	return v;
+}
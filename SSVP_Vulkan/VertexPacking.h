@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Primitives.h"
+
+//float -> IEEE half, round to nearest even, overflow goes to inf
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+//axis aligned bounds of the positions, packed positions are stored relative to them
+void computeBounds(const vertex* vertices, uint32_t count, glm::vec3& outMin, glm::vec3& outExtent);
+
+//quantizes positions to the given bounds, uvs to half and the tangent frame to a qtangent
+void encodePackedVertices(const vertex* vertices, uint32_t count, const glm::vec3& boundsMin, const glm::vec3& boundsExtent,
+	std::vector<packedVertex>& out);
+
+//inverse of the encoder, same math as shaders/packedVertex.glsl. used to check the reconstruction error
+vertex decodePackedVertex(const packedVertex& packed, const glm::vec3& boundsMin, const glm::vec3& boundsExtent);
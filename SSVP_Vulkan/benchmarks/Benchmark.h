@@ -0,0 +1,46 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <string>
+#include <chrono>
+
+//named entry points, SSVP_Benchmarks <name> [args] runs one, no name lists them. the engine is linked in,
+//benchmarks that need a device create their own Vulkan_Backend
+namespace bench {
+	//the scene the renderer loads, relative to the engine directory
+	const char* const DEFAULT_MODEL = "models/cornell_closed/cornell_closed.obj";
+
+	typedef std::function<int(const std::vector<std::string>& args)> Run;
+
+	struct Benchmark {
+		const char* name;
+		const char* usage;
+		Run run;
+	};
+
+	std::vector<Benchmark>& registry();
+
+	struct Registrar {
+		Registrar(const char* name, const char* usage, Run run) { registry().push_back({ name, usage, std::move(run) }); }
+	};
+
+	inline double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//args[index] or fallback
+	inline std::string argOr(const std::vector<std::string>& args, size_t index, const std::string& fallback)
+	{
+		return index < args.size() ? args[index] : fallback;
+	}
+}
+
+#define BENCHMARK_CONCAT_(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+
+#define BENCHMARK(name, usage) \
+	static int BENCHMARK_CONCAT(benchmark_, name)(const std::vector<std::string>& args); \
+	static bench::Registrar BENCHMARK_CONCAT(s_register_, name)(#name, usage, BENCHMARK_CONCAT(benchmark_, name)); \
+	static int BENCHMARK_CONCAT(benchmark_, name)(const std::vector<std::string>& args)
@@ -0,0 +1,39 @@
+#include "Benchmark.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <exception>
+
+std::vector<bench::Benchmark>& bench::registry()
+{
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		for (const bench::Benchmark& benchmark : bench::registry())
+		{
+			if (std::strcmp(benchmark.name, argv[1]) != 0)
+				continue;
+
+			try
+			{
+				return benchmark.run(std::vector<std::string>(argv + 2, argv + argc));
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "[BENCH]: " << benchmark.name << " failed: " << e.what() << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		std::cerr << "[BENCH]: no benchmark named " << argv[1] << std::endl;
+	}
+
+	std::cout << "usage: SSVP_Benchmarks <benchmark> [args]" << std::endl;
+	for (const bench::Benchmark& benchmark : bench::registry())
+		std::cout << "\t" << benchmark.name << " " << benchmark.usage << std::endl;
+	return argc > 1 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,16 @@
+#include "BenchmarkModel.h"
+#include "AssetUtilities.h"
+
+bench::BenchmarkModel::BenchmarkModel(const std::string& path)
+	: path{ path }
+{
+	meshes = utils::loadOBJ(path, backend, transforms);
+	backend.m_uploader.submit();
+	backend.m_uploader.waitAll();
+}
+
+bench::BenchmarkModel::~BenchmarkModel()
+{
+	for (auto& mesh : meshes)
+		mesh.destroyMesh(backend);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Renderer.h"
+#include "Primitives.h"
+#include "TransformHierarchy.h"
+
+namespace bench {
+	//a model loaded through loadOBJ on its own backend, with its uploads completed. the meshes are freed with it
+	struct BenchmarkModel {
+		explicit BenchmarkModel(const std::string& path);
+		~BenchmarkModel();
+
+		std::string path;
+		Vulkan_Backend backend;
+		TransformHierarchy transforms;
+		std::vector<Mesh> meshes;
+	};
+}
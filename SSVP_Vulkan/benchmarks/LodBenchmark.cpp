@@ -0,0 +1,77 @@
+#include "Benchmark.h"
+#include "BenchmarkModel.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+
+//lod levels of every mesh, then a dolly out to 64 model radii and back at 1080p with a 60 degree fov.
+//the triangle count drawn at each step shows the reduction, the switch count shows the hysteresis at work
+BENCHMARK(lod, "[model.obj] [steps]")
+{
+	bench::BenchmarkModel model(bench::argOr(args, 0, bench::DEFAULT_MODEL));
+	const uint32_t steps = static_cast<uint32_t>(std::max(1, std::atoi(bench::argOr(args, 1, "32").c_str())));
+	const std::vector<Mesh>& meshes = model.meshes;
+
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	size_t lodMeshes = 0;
+	for (size_t m = 0; m < meshes.size(); ++m)
+	{
+		const Mesh& mesh = meshes[m];
+		if (mesh.lods.size() < 2)
+			continue;
+		lodMeshes++;
+
+		std::cout << "[LOD]: mesh " << m;
+		for (auto& lod : mesh.lods)
+			std::cout << ", " << lod.indexCount / 3 << " (" << lod.error << ")";
+		std::cout << std::endl;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			boundsMin[k] = std::min(boundsMin[k], mesh.boundsMin[k]);
+			boundsMax[k] = std::max(boundsMax[k], mesh.boundsMin[k] + mesh.boundsExtent[k]);
+		}
+	}
+	if (lodMeshes == 0)
+	{
+		std::cout << "[LOD]: " << model.path << " has no meshes with lods" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	float radius = 0.0f;
+	for (int k = 0; k < 3; ++k)
+		radius += (boundsMax[k] - boundsMin[k]) * (boundsMax[k] - boundsMin[k]) * 0.25f;
+	radius = std::max(std::sqrt(radius), FLT_MIN);
+
+	const float projectionScale = 1080.0f / (2.0f * std::tan(glm::radians(60.0f) * 0.5f));
+	std::vector<uint32_t> current(meshes.size(), 0);
+	size_t switches = 0;
+	size_t nearTriangles = 0, farTriangles = 0;
+
+	//out and back, the same distances in reverse
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t step = 0; step <= steps * 2; ++step)
+	{
+		uint32_t along = step <= steps ? step : steps * 2 - step;
+		float distance = radius * std::pow(64.0f, static_cast<float>(along) / steps);
+		size_t triangles = 0;
+		for (size_t m = 0; m < meshes.size(); ++m)
+		{
+			uint32_t lod = meshes[m].selectLod(distance, projectionScale, current[m]);
+			switches += lod != current[m];
+			current[m] = lod;
+			triangles += (meshes[m].lods.empty() ? meshes[m].indexCount : meshes[m].lods[lod].indexCount) / 3;
+		}
+		if (step == 0) nearTriangles = triangles;
+		if (step == steps) farTriangles = triangles;
+	}
+	double selectMs = bench::millisecondsSince(start);
+
+	std::cout << "[LOD]: " << model.path << ", " << lodMeshes << " meshes with lods, " << nearTriangles << " triangles at 1 radius, "
+		<< farTriangles << " at 64 radii, " << switches << " switches over the dolly, "
+		<< selectMs * 1000.0 / (steps * 2 + 1) << " us per step to select" << std::endl;
+	return EXIT_SUCCESS;
+}
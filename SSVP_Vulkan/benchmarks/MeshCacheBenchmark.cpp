@@ -0,0 +1,56 @@
+#include "Benchmark.h"
+#include "Renderer.h"
+#include "AssetUtilities.h"
+#include "GeometryArena.h"
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cstdlib>
+
+//one loadOBJ until its uploads completed, the meshes are freed again afterwards
+static double timeLoad(Vulkan_Backend& backend, const std::string& path)
+{
+	TransformHierarchy transforms;
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Mesh> meshes = utils::loadOBJ(path, backend, transforms);
+	backend.m_uploader.submit();
+	backend.m_uploader.waitAll();
+	double ms = bench::millisecondsSince(start);
+
+	for (auto& mesh : meshes)
+		mesh.destroyMesh(backend);
+	//no frames run here, every free is already safe to reuse
+	backend.m_geometryArena->endFrame();
+	return ms;
+}
+
+static void report(const char* name, const std::vector<double>& ms)
+{
+	double sum = std::accumulate(ms.begin(), ms.end(), 0.0);
+	std::cout << "[MESHCACHE]: " << name << " " << *std::min_element(ms.begin(), ms.end()) << " ms min, "
+		<< sum / ms.size() << " ms average over " << ms.size() << " runs" << std::endl;
+}
+
+//cold is assimp import, mesh processing and writing the cache, warm maps the cache written by the cold load.
+//both include the geometry uploads
+BENCHMARK(meshcache, "[model.obj] [runs]")
+{
+	std::string path = bench::argOr(args, 0, bench::DEFAULT_MODEL);
+	int runs = std::max(1, std::atoi(bench::argOr(args, 1, "5").c_str()));
+	std::string cachePath = path + ".meshcache";
+
+	Vulkan_Backend backend;
+	std::vector<double> cold, warm;
+	for (int run = 0; run < runs; ++run)
+	{
+		std::remove(cachePath.c_str());
+		cold.push_back(timeLoad(backend, path));
+		warm.push_back(timeLoad(backend, path));
+	}
+
+	std::cout << "[MESHCACHE]: " << path << std::endl;
+	report("cold", cold);
+	report("warm", warm);
+	return EXIT_SUCCESS;
+}
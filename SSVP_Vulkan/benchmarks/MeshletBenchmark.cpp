@@ -0,0 +1,97 @@
+#include "Benchmark.h"
+#include "BenchmarkModel.h"
+#include "Meshlets.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+
+//fraction of triangles the meshlet culling rejects along two fixed camera paths: an orbit around the
+//model looking at its centre and a turn on the spot at the centre, plus the cpu time culling took.
+//node transforms are left out, the frustums are built in mesh space
+BENCHMARK(meshlets, "[model.obj] [views]")
+{
+	bench::BenchmarkModel model(bench::argOr(args, 0, bench::DEFAULT_MODEL));
+	const uint32_t viewCount = static_cast<uint32_t>(std::max(1, std::atoi(bench::argOr(args, 1, "16").c_str())));
+
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	size_t meshletCount = 0;
+	for (auto& mesh : model.meshes)
+	{
+		for (auto& meshlet : mesh.meshlets)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				boundsMin[k] = std::min(boundsMin[k], meshlet.boundsMin[k]);
+				boundsMax[k] = std::max(boundsMax[k], meshlet.boundsMax[k]);
+			}
+		}
+		meshletCount += mesh.meshlets.size();
+	}
+	if (meshletCount == 0)
+	{
+		std::cout << "[MESHLET]: " << model.path << " has no meshlets" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	float center[3];
+	float radius = 0.0f;
+	for (int k = 0; k < 3; ++k)
+	{
+		center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+		radius += (boundsMax[k] - boundsMin[k]) * (boundsMax[k] - boundsMin[k]) * 0.25f;
+	}
+	radius = std::sqrt(radius);
+
+	const float fovY = glm::radians(60.0f);
+	const float aspect = 16.0f / 9.0f;
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+
+	auto runPath = [&](const char* name, auto&& viewAt) {
+		MeshletCullStats stats;
+		std::vector<IndexRange> ranges;
+		double cullMs = 0.0;
+		for (uint32_t view = 0; view < viewCount; ++view)
+		{
+			float position[3], forward[3];
+			viewAt(view, position, forward);
+			CullingFrustum frustum = utils::makeFrustum(position, forward, up, fovY, aspect, radius * 0.01f, radius * 4.0f);
+
+			auto start = std::chrono::steady_clock::now();
+			for (auto& mesh : model.meshes)
+			{
+				ranges.clear();
+				utils::cullMeshlets(mesh.meshlets.data(), mesh.meshlets.size(), frustum, ranges, &stats);
+			}
+			cullMs += bench::millisecondsSince(start);
+		}
+		std::cout << "[MESHLET]: " << name << ", " << 100.0 * (stats.frustumCulledTriangles + stats.coneCulledTriangles) / stats.triangles
+			<< "% of triangles culled (frustum " << 100.0 * stats.frustumCulledTriangles / stats.triangles
+			<< "%, cone " << 100.0 * stats.coneCulledTriangles / stats.triangles << "%), "
+			<< cullMs / viewCount << " ms per view" << std::endl;
+	};
+
+	std::cout << "[MESHLET]: " << model.path << ", " << meshletCount << " meshlets, " << viewCount << " views per path" << std::endl;
+
+	runPath("orbit", [&](uint32_t view, float* position, float* forward) {
+		float angle = 6.2831853f * view / viewCount;
+		float offset[3] = { std::cos(angle) * 2.0f * radius, 0.5f * radius, std::sin(angle) * 2.0f * radius };
+		for (int k = 0; k < 3; ++k)
+		{
+			position[k] = center[k] + offset[k];
+			forward[k] = -offset[k];
+		}
+	});
+
+	runPath("interior turn", [&](uint32_t view, float* position, float* forward) {
+		float angle = 6.2831853f * view / viewCount;
+		for (int k = 0; k < 3; ++k)
+			position[k] = center[k];
+		forward[0] = std::cos(angle);
+		forward[1] = 0.0f;
+		forward[2] = std::sin(angle);
+	});
+	return EXIT_SUCCESS;
+}
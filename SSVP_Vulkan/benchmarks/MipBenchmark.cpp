@@ -0,0 +1,65 @@
+#include "Benchmark.h"
+#include "MipGenerator.h"
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <cstdlib>
+
+//full chains of a noise texture, best of several runs per kernel, in source megapixels filtered per second.
+//the largest difference to the scalar chain is printed as well. the kernels only round ties differently, a level
+//built from an already different level can drift a little further
+BENCHMARK(mips, "[size] [runs]")
+{
+	uint32_t size = static_cast<uint32_t>(std::max(2, std::atoi(bench::argOr(args, 0, "2048").c_str())));
+	int runs = std::max(1, std::atoi(bench::argOr(args, 1, "10").c_str()));
+
+	std::vector<unsigned char> rgba(size_t(size) * size * 4);
+	std::mt19937 rng(42);
+	for (auto& texel : rgba)
+		texel = static_cast<unsigned char>(rng());
+
+	const struct { MipKernel kernel; const char* name; } kernels[] = { { MipKernel::Scalar, "scalar" }, { MipKernel::SSE2, "sse2" } };
+
+	for (bool srgb : { false, true })
+	{
+		MipChain reference;
+		double scalarRate = 0.0;
+		for (auto& k : kernels)
+		{
+			if (!mipKernelSupported(k.kernel))
+			{
+				std::cout << "[MIPS]: " << k.name << " not supported by this build" << std::endl;
+				continue;
+			}
+
+			MipChain chain;
+			double bestMs = 1e30;
+			uint64_t filtered = 0;
+			for (int run = 0; run < runs; ++run)
+			{
+				auto start = std::chrono::steady_clock::now();
+				filtered = generateMipChain(rgba.data(), size, size, srgb, chain, k.kernel);
+				bestMs = std::min(bestMs, bench::millisecondsSince(start));
+			}
+			double rate = filtered / (bestMs * 1000.0);
+
+			int maxDifference = 0;
+			if (k.kernel == MipKernel::Scalar)
+			{
+				reference = chain;
+				scalarRate = rate;
+			}
+			else
+			{
+				for (size_t i = 0; i < chain.data.size(); ++i)
+					maxDifference = std::max(maxDifference, std::abs(int(chain.data[i]) - int(reference.data[i])));
+			}
+
+			std::cout << "[MIPS]: " << k.name << (srgb ? " srgb " : " unorm ") << size << "x" << size << ", " << rate << " MPix/s";
+			if (k.kernel != MipKernel::Scalar)
+				std::cout << " (" << rate / scalarRate << "x scalar, max difference " << maxDifference << ")";
+			std::cout << std::endl;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "Renderer.h"
 #include "ScreenQuadRenderPass.h" 
 
@@ -6,8 +8,16 @@
 //#include "stb_image.h" 
 
 
-int main() {
-    Vulkan_Renderer app;
+int main(int argc, char** argv) {
+    //--frames-in-flight N trades input latency (fewer) against cpu/gpu overlap (more)
+    uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--frames-in-flight") == 0)
+            framesInFlight = static_cast<uint32_t>(std::atoi(argv[i + 1]));
+    }
+
+    Vulkan_Renderer app(framesInFlight);
     ScreenQuadRenderPass pass(app);
             
     app.mainLoop(&pass);
@@ -0,0 +1,37 @@
+// material access through the MaterialTable's set (MaterialTable.h)
+// include with #extension GL_GOOGLE_include_directive : require
+// define BINDLESS_FALLBACK for devices without VK_EXT_descriptor_indexing
+//
+// set 1 binding 0: every material texture, slot 0 is a white placeholder
+// set 1 binding 1: MaterialRecords indexed by material id
+// push constant: material id of the draw
+
+#ifndef BINDLESS_FALLBACK
+#extension GL_EXT_nonuniform_qualifier : require
+layout(set = 1, binding = 0) uniform sampler2D materialTextures[];
+#define MATERIAL_TEXTURE(index) materialTextures[nonuniformEXT(index)]
+#else
+// BINDLESS_FALLBACK_TEXTURE_CAPACITY in Renderer.h, indices have to be dynamically uniform
+layout(set = 1, binding = 0) uniform sampler2D materialTextures[64];
+#define MATERIAL_TEXTURE(index) materialTextures[index]
+#endif
+
+struct MaterialRecord {
+    uint diffuseTexture;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer MaterialRecords {
+    MaterialRecord materials[];
+};
+
+layout(push_constant) uniform DrawConstants {
+    uint materialId;
+} draw;
+
+vec4 sampleDiffuse(uint materialId, vec2 uv)
+{
+    return texture(MATERIAL_TEXTURE(materials[materialId].diffuseTexture), uv);
+}
@@ -1,2 +1,5 @@
 C:\VulkanSDK\1.2.170.0\Bin32\glslc.exe fsQuadvs.vert -o fsQuadvs.spv
-C:\VulkanSDK\1.2.170.0\Bin32\glslc.exe fsQuadfs.frag -o fsQuadfs.spv
\ No newline at end of file
+C:\VulkanSDK\1.2.170.0\Bin32\glslc.exe fsQuadfs.frag -o fsQuadfs.spv
+C:\VulkanSDK\1.2.170.0\Bin32\glslc.exe mesh.vert -o meshvs.spv
+C:\VulkanSDK\1.2.170.0\Bin32\glslc.exe mesh.frag -o meshfs.spv
+C:\VulkanSDK\1.2.170.0\Bin32\glslc.exe -DBINDLESS_FALLBACK mesh.frag -o meshfs_fallback.spv
\ No newline at end of file
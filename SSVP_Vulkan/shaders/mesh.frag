@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// compiled twice, with BINDLESS_FALLBACK for devices without descriptor indexing (compile_shaders.bat)
+#include "bindless.glsl"
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) in vec3 fragNormal;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 lightDir = normalize(vec3(0.3, 1.0, 0.5));
+    float diffuse = max(dot(normalize(fragNormal), lightDir), 0.0);
+    vec4 albedo = sampleDiffuse(draw.materialId, fragUV);
+    outColor = vec4(albedo.rgb * (0.25 + 0.75 * diffuse), albedo.a);
+}
\ No newline at end of file
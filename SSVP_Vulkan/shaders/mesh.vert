@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// full vertex layout (getAttributeDescriptions in Primitives.cpp)
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec3 inNormal;
+
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec3 fragNormal;
+
+layout(set = 0, binding = 0) uniform globalShaderVars {
+    float totalElapsedTime;
+    float frameTime;
+    mat4 viewProjection;
+} vars;
+
+// object to world of the draw, UniformRing allocation selected with a dynamic offset
+layout(set = 0, binding = 1) uniform objectShaderVars {
+    mat4 world;
+} object;
+
+void main() {
+    gl_Position = vars.viewProjection * object.world * vec4(inPosition, 1.0);
+    fragUV = inUV;
+    // no non uniform scale in the imported scenes so far
+    fragNormal = mat3(object.world) * inNormal;
+}
\ No newline at end of file
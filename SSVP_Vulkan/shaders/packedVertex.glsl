@@ -0,0 +1,27 @@
+// decode helpers for the packed vertex layout (packedVertex in Primitives.h)
+// include with #extension GL_GOOGLE_include_directive : require
+//
+// location 0: vec4 unorm16 position relative to the mesh bounds
+// location 1: vec2 half float uv
+// location 2: vec4 snorm16 qtangent, sign of w is the bitangent handedness
+
+vec3 decodePosition(vec4 packedPos, vec3 boundsMin, vec3 boundsExtent)
+{
+    return boundsMin + packedPos.xyz * boundsExtent;
+}
+
+void decodeTangentFrame(vec4 qtangent, out vec3 normal, out vec3 tangent, out vec3 bitangent)
+{
+    float handedness = qtangent.w < 0.0 ? -1.0 : 1.0;
+    vec4 q = normalize(qtangent);
+
+    tangent = vec3(
+        1.0 - 2.0 * (q.y * q.y + q.z * q.z),
+        2.0 * (q.x * q.y + q.w * q.z),
+        2.0 * (q.x * q.z - q.w * q.y));
+    normal = vec3(
+        2.0 * (q.x * q.z + q.w * q.y),
+        2.0 * (q.y * q.z - q.w * q.x),
+        1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+    bitangent = cross(normal, tangent) * handedness;
+}
@@ -0,0 +1,312 @@
+#include "TestFramework.h"
+#include "JobSystem.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <chrono>
+
+namespace {
+	//one worker leaves every job to a single thread plus the waiter, seven oversubscribe small machines
+	const uint32_t WORKER_COUNTS[] = { 1, 3, 7 };
+
+	uint64_t totalSteals(const JobSystem& jobs)
+	{
+		uint64_t steals = 0;
+		for (auto& worker : jobs.getStats())
+			steals += worker.steals;
+		return steals;
+	}
+}
+
+TEST(jobSystemSurvivesStealContention)
+{
+	for (uint32_t workers : WORKER_COUNTS)
+	{
+		JobSystem jobs(workers);
+		std::atomic<uint64_t> sum{ 0 };
+
+		//started from a worker, so every producer sits in that worker's deque. the root job holds on to its deque until
+		//another thread took a producer, the producers then fill more deques while everyone steals from everyone
+		const size_t producers = workers * 4;
+		const uint64_t perProducer = 5000;
+		std::atomic<bool> taken{ false };
+		JobCounter root;
+		jobs.submit([&]() {
+			std::thread::id owner = std::this_thread::get_id();
+			JobCounter started;
+			for (size_t producer = 0; producer < producers; ++producer)
+			{
+				jobs.submit([&, owner, producer]() {
+					if (std::this_thread::get_id() != owner)
+						taken = true;
+					JobCounter counter;
+					for (uint64_t i = 0; i < perProducer; ++i)
+					{
+						uint64_t value = producer * perProducer + i;
+						jobs.submit([&sum, value]() { sum.fetch_add(value, std::memory_order_relaxed); }, &counter);
+					}
+					jobs.wait(counter);
+				}, &started);
+			}
+			while (workers > 1 && !taken)
+				std::this_thread::yield();
+			jobs.wait(started);
+		}, &root);
+		//polling keeps the root job off this thread, a waiting thread would run it itself
+		while (!root.done())
+			std::this_thread::yield();
+		jobs.wait(root);
+
+		uint64_t count = producers * perProducer;
+		CHECK_EQ(sum.load(), count * (count - 1) / 2);
+		//a single worker has nobody to steal from
+		CHECK(workers == 1 || totalSteals(jobs) > 0);
+	}
+}
+
+TEST(jobSystemRunsNestedParallelFor)
+{
+	for (uint32_t workers : WORKER_COUNTS)
+	{
+		JobSystem jobs(workers);
+		std::vector<std::atomic<uint32_t>> hits(16 * 32 * 64);
+
+		//three levels, every level waits inside a job of the level above
+		jobs.parallelFor(16, [&](size_t a) {
+			jobs.parallelFor(32, [&](size_t b) {
+				jobs.parallelFor(64, [&](size_t c) {
+					hits[(a * 32 + b) * 64 + c].fetch_add(1, std::memory_order_relaxed);
+				});
+			});
+		});
+
+		bool once = true;
+		for (auto& hit : hits)
+			once = once && hit.load() == 1;
+		CHECK(once);
+	}
+}
+
+TEST(jobSystemRethrowsThroughTheCounter)
+{
+	for (uint32_t workers : WORKER_COUNTS)
+	{
+		JobSystem jobs(workers);
+
+		std::atomic<uint32_t> ran{ 0 };
+		JobCounter counter;
+		for (uint32_t i = 0; i < 1000; ++i)
+		{
+			jobs.submit([&ran, i]() {
+				ran.fetch_add(1, std::memory_order_relaxed);
+				if (i % 100 == 7)
+					throw std::runtime_error("job " + std::to_string(i));
+			}, &counter);
+		}
+		CHECK_THROWS(jobs.wait(counter));
+		//a throwing job doesn't cancel its siblings
+		CHECK_EQ(ran.load(), 1000u);
+
+		//the error is handed out once, the counter can be reused afterwards
+		jobs.submit([]() {}, &counter);
+		jobs.wait(counter);
+
+		//from a continuation and from a nested parallelFor
+		JobCounter first, second;
+		jobs.submit([]() {}, &first);
+		jobs.submit([]() { throw std::runtime_error("continuation"); }, &second, &first);
+		CHECK_THROWS(jobs.wait(second));
+		CHECK_THROWS(jobs.parallelFor(64, [&](size_t i) {
+			jobs.parallelFor(64, [i](size_t j) {
+				if (i == 40 && j == 3)
+					throw std::runtime_error("nested");
+			});
+		}));
+
+		//nobody waits on a job without a counter, its exception is logged and the worker lives on
+		JobCounter afterwards;
+		jobs.submit([]() { throw std::runtime_error("unobserved"); });
+		jobs.submit([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &afterwards);
+		jobs.wait(afterwards);
+		CHECK_EQ(ran.load(), 1001u);
+	}
+}
+
+TEST(jobSystemStartsContinuationsAfterTheirCounter)
+{
+	for (uint32_t workers : WORKER_COUNTS)
+	{
+		JobSystem jobs(workers);
+
+		//ten stages of fifty jobs, each stage starts once the previous one reached zero
+		const int stageCount = 10, perStage = 50;
+		std::mutex mutex;
+		std::vector<int> order;
+		JobCounter stages[stageCount];
+		for (int s = 0; s < stageCount; ++s)
+		{
+			for (int k = 0; k < perStage; ++k)
+			{
+				jobs.submit([&mutex, &order, s]() {
+					std::lock_guard<std::mutex> lock(mutex);
+					order.push_back(s);
+				}, &stages[s], s > 0 ? &stages[s - 1] : nullptr);
+			}
+		}
+		jobs.wait(stages[stageCount - 1]);
+
+		CHECK_EQ(order.size(), size_t(stageCount * perStage));
+		bool ordered = true;
+		for (size_t i = 1; i < order.size(); ++i)
+			ordered = ordered && order[i - 1] <= order[i];
+		CHECK(ordered);
+
+		//fan in: the continuation sees every result of the jobs it waited for
+		std::vector<uint32_t> values(500, 0);
+		uint64_t total = 0;
+		JobCounter produced, reduced;
+		for (uint32_t i = 0; i < values.size(); ++i)
+			jobs.submit([&values, i]() { values[i] = i + 1; }, &produced);
+		jobs.submit([&values, &total]() {
+			for (uint32_t value : values) total += value;
+		}, &reduced, &produced);
+		jobs.wait(reduced);
+		CHECK_EQ(total, uint64_t(500) * 501 / 2);
+
+		//after a counter that already reached zero the job starts right away
+		bool ran = false;
+		JobCounter finished, late;
+		jobs.submit([&ran]() { ran = true; }, &late, &finished);
+		jobs.wait(late);
+		CHECK(ran);
+	}
+}
+
+TEST(jobSystemShutdownDrainsQueuedJobs)
+{
+	for (uint32_t workers : WORKER_COUNTS)
+	{
+		for (int round = 0; round < 10; ++round)
+		{
+			std::atomic<uint32_t> ran{ 0 };
+			//counters have to outlive the jobs, the job system is destroyed first
+			JobCounter gate, released;
+			{
+				JobSystem jobs(workers);
+				for (int i = 0; i < 1000; ++i)
+					jobs.submit([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &gate);
+				//continuations released by the last gate job, each submits one more job while the system shuts down
+				for (int i = 0; i < 100; ++i)
+				{
+					jobs.submit([&ran, &jobs]() {
+						ran.fetch_add(1, std::memory_order_relaxed);
+						jobs.submit([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); });
+					}, &released, &gate);
+				}
+			}
+			CHECK_EQ(ran.load(), 1200u);
+			CHECK(gate.done() && released.done());
+		}
+	}
+}
+
+TEST(jobSystemShutdownRunsContinuationsOnTheDestroyingThread)
+{
+	std::atomic<bool> parked{ false }, release{ false };
+	std::atomic<uint32_t> ran{ 0 };
+	std::thread::id destroying = std::this_thread::get_id();
+	bool continuationHere = false;
+	JobCounter parking, gate, released, submitted;
+	{
+		JobSystem jobs(1);
+		//the only worker stays parked until the continuation runs, so the destructor has to run the rest itself
+		jobs.submit([&parked, &release]() {
+			parked = true;
+			while (!release)
+				std::this_thread::yield();
+		}, &parking);
+		while (!parked)
+			std::this_thread::yield();
+
+		jobs.submit([&ran]() { ran.fetch_add(1); }, &gate);
+		jobs.submit([&]() {
+			continuationHere = std::this_thread::get_id() == destroying;
+			//submitting while shutting down, this one has to run before the destructor returns
+			jobs.submit([&ran]() { ran.fetch_add(1); }, &submitted);
+			ran.fetch_add(1);
+			release = true;
+		}, &released, &gate);
+	}
+	CHECK_EQ(ran.load(), 3u);
+	CHECK(continuationHere);
+	CHECK(parking.done() && gate.done() && released.done() && submitted.done());
+}
+
+TEST(jobSystemWaitOffTheWorkersOnlyRunsItsOwnJobs)
+{
+	JobSystem jobs(1);
+
+	//park the only worker so everything below stays queued until this thread runs it
+	std::atomic<bool> parked{ false }, release{ false };
+	JobCounter parking;
+	jobs.submit([&parked, &release]() {
+		parked = true;
+		while (!release)
+			std::this_thread::yield();
+	}, &parking);
+	while (!parked)
+		std::this_thread::yield();
+
+	std::atomic<uint32_t> unrelated{ 0 }, own{ 0 };
+	JobCounter other, mine;
+	for (int i = 0; i < 10; ++i)
+		jobs.submit([&unrelated]() { unrelated.fetch_add(1, std::memory_order_relaxed); }, &other);
+	for (int i = 0; i < 10; ++i)
+		jobs.submit([&own]() { own.fetch_add(1, std::memory_order_relaxed); }, &mine);
+	jobs.submit([&unrelated]() { unrelated.fetch_add(1, std::memory_order_relaxed); });
+
+	jobs.wait(mine);
+	CHECK_EQ(own.load(), 10u);
+	CHECK_EQ(unrelated.load(), 0u);
+
+	release = true;
+	jobs.wait(parking);
+	jobs.wait(other);
+	CHECK(unrelated.load() >= 10u);
+}
+
+TEST(jobSystemWaitSleepsUntilTheCounterIsDone)
+{
+	for (uint32_t workers : WORKER_COUNTS)
+	{
+		JobSystem jobs(workers);
+
+		//long enough to run out of spins, the waiter has to be woken by the last job
+		std::atomic<bool> finished{ false };
+		JobCounter slow;
+		jobs.submit([&finished]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			finished = true;
+		}, &slow);
+		jobs.wait(slow);
+		CHECK(finished.load());
+
+		//a worker waiting on a continuation sleeps too and is woken once the job it waits for finished
+		std::atomic<uint32_t> ran{ 0 };
+		JobCounter outer;
+		jobs.submit([&jobs, &ran]() {
+			JobCounter gate, gated;
+			jobs.submit([&ran]() {
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				ran.fetch_add(1);
+			}, &gate);
+			jobs.submit([&ran]() { ran.fetch_add(1); }, &gated, &gate);
+			jobs.wait(gated);
+		}, &outer);
+		jobs.wait(outer);
+		CHECK_EQ(ran.load(), 2u);
+	}
+}
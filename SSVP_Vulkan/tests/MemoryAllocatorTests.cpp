@@ -0,0 +1,309 @@
+#include "TestFramework.h"
+#include "VulkanMock.h"
+#include "MemoryAllocator.h"
+#include <random>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+namespace {
+	const VkDeviceSize KB = 1024;
+	const VkDeviceSize MB = 1024 * KB;
+
+	VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment = 256, uint32_t memoryTypeBits = ~0u)
+	{
+		VkMemoryRequirements memRequirements{};
+		memRequirements.size = size;
+		memRequirements.alignment = alignment;
+		memRequirements.memoryTypeBits = memoryTypeBits;
+		return memRequirements;
+	}
+
+	//a discrete gpu: 1 GB of device local memory (64 MB blocks) and 256 MB of host memory (32 MB blocks)
+	void discreteDevice(DeviceMemoryAllocator& allocator)
+	{
+		mock::reset();
+		uint32_t vram = mock::addHeap(1024 * MB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+		uint32_t host = mock::addHeap(256 * MB);
+		mock::addMemoryType(vram, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		mock::addMemoryType(host, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		mock::addMemoryType(host, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		allocator.init(mock::device(), mock::physicalDevice());
+	}
+
+	const VkMemoryPropertyFlags DEVICE_LOCAL = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	const VkMemoryPropertyFlags HOST_COHERENT = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+TEST(buddySplitsDownToTheRequestedNode)
+{
+	BuddyAllocator buddy(4096, 256);
+	VkDeviceSize offset, nodeSize;
+	CHECK(buddy.allocate(256, 1, offset, nodeSize));
+	CHECK_EQ(offset, 0u);
+	CHECK_EQ(nodeSize, 256u);
+	CHECK_EQ(buddy.usedSize(), 256u);
+	//4096 split into 2048 + 1024 + 512 + 256 + the allocated 256
+	CHECK_EQ(buddy.largestFreeNode(), 2048u);
+
+	CHECK(buddy.allocate(2048, 1, offset, nodeSize));
+	CHECK_EQ(offset, 2048u);
+	CHECK_EQ(buddy.largestFreeNode(), 1024u);
+}
+
+TEST(buddyMergesFreedBuddies)
+{
+	BuddyAllocator buddy(4096, 256);
+	std::vector<VkDeviceSize> offsets;
+	VkDeviceSize offset, nodeSize;
+	while (buddy.allocate(200, 1, offset, nodeSize))
+		offsets.push_back(offset);
+	CHECK_EQ(offsets.size(), 16u);
+	CHECK_EQ(buddy.largestFreeNode(), 0u);
+
+	//freeing out of order still merges all the way up once both halves of every node are back
+	std::mt19937 rng(7);
+	std::shuffle(offsets.begin(), offsets.end(), rng);
+	for (size_t i = 0; i < offsets.size(); ++i)
+	{
+		buddy.free(offsets[i], 256);
+		if (i + 1 < offsets.size())
+			CHECK(buddy.largestFreeNode() < 4096u);
+	}
+	CHECK(buddy.empty());
+	CHECK_EQ(buddy.largestFreeNode(), 4096u);
+}
+
+TEST(buddyAlignsToTheNodeSize)
+{
+	BuddyAllocator buddy(1 * MB, 256);
+	VkDeviceSize offset, nodeSize;
+	CHECK(buddy.allocate(300, 1, offset, nodeSize));
+	CHECK_EQ(nodeSize, 512u);
+
+	//small size with a big alignment takes a node as big as the alignment
+	CHECK(buddy.allocate(100, 4096, offset, nodeSize));
+	CHECK_EQ(nodeSize, 4096u);
+	CHECK_EQ(offset % 4096, 0u);
+
+	CHECK(!buddy.allocate(2 * MB, 1, offset, nodeSize));
+}
+
+TEST(buddyRandomAllocationsNeverOverlap)
+{
+	BuddyAllocator buddy(1 * MB, 256);
+	std::mt19937 rng(1);
+	std::vector<std::pair<VkDeviceSize, VkDeviceSize>> live;
+	VkDeviceSize liveBytes = 0;
+	for (int i = 0; i < 20000; ++i)
+	{
+		if (live.empty() || rng() % 2)
+		{
+			VkDeviceSize size = 1 + rng() % 20000;
+			VkDeviceSize alignment = VkDeviceSize(1) << (rng() % 10);
+			VkDeviceSize offset, nodeSize;
+			if (!buddy.allocate(size, alignment, offset, nodeSize))
+				continue;
+
+			CHECK(nodeSize >= size && offset % alignment == 0 && offset % nodeSize == 0);
+			for (auto& other : live)
+				CHECK(offset + nodeSize <= other.first || other.first + other.second <= offset);
+			live.push_back({ offset, nodeSize });
+			liveBytes += nodeSize;
+		}
+		else
+		{
+			size_t index = rng() % live.size();
+			buddy.free(live[index].first, live[index].second);
+			liveBytes -= live[index].second;
+			live.erase(live.begin() + index);
+		}
+		CHECK_EQ(buddy.usedSize(), liveBytes);
+	}
+
+	for (auto& node : live)
+		buddy.free(node.first, node.second);
+	CHECK(buddy.empty());
+	CHECK_EQ(buddy.largestFreeNode(), 1 * MB);
+}
+
+TEST(linearAndOptimalResourcesUseSeparateBlocks)
+{
+	DeviceMemoryAllocator allocator;
+	discreteDevice(allocator);
+
+	//a buffer next to an image in the same block could break bufferImageGranularity
+	MemoryAllocation buffer = allocator.allocate(requirements(1 * KB), DEVICE_LOCAL, true);
+	MemoryAllocation image = allocator.allocate(requirements(1 * KB), DEVICE_LOCAL, false);
+	CHECK(buffer.memory != image.memory);
+	CHECK_EQ(mock::state().allocateCalls, 2u);
+	CHECK_EQ(allocator.getStats().blockCount, 2u);
+
+	//more of the same kind goes into the existing blocks
+	MemoryAllocation buffer2 = allocator.allocate(requirements(1 * KB), DEVICE_LOCAL, true);
+	MemoryAllocation image2 = allocator.allocate(requirements(1 * KB), DEVICE_LOCAL, false);
+	CHECK(buffer2.memory == buffer.memory && buffer2.offset != buffer.offset);
+	CHECK(image2.memory == image.memory && image2.offset != image.offset);
+	CHECK_EQ(mock::state().allocateCalls, 2u);
+	CHECK_EQ(mock::state().lastAllocationSize, 64 * MB);
+
+	for (MemoryAllocation* allocation : { &buffer, &image, &buffer2, &image2 })
+		allocator.free(*allocation);
+	allocator.cleanUp();
+	CHECK_EQ(mock::state().liveAllocations, 0u);
+}
+
+TEST(bigResourcesGetDedicatedAllocations)
+{
+	DeviceMemoryAllocator allocator;
+	discreteDevice(allocator);
+
+	//half a block is still sub-allocated, anything above gets its own VkDeviceMemory
+	MemoryAllocation half = allocator.allocate(requirements(32 * MB), DEVICE_LOCAL, false);
+	CHECK(half.block != nullptr);
+	MemoryAllocation dedicated = allocator.allocate(requirements(32 * MB + 256), DEVICE_LOCAL, false);
+	CHECK(dedicated.block == nullptr);
+	CHECK_EQ(dedicated.offset, 0u);
+	CHECK_EQ(mock::state().lastAllocationSize, 32 * MB + 256);
+
+	//the threshold follows the block size, host memory blocks are heap / 8 = 32 MB
+	MemoryAllocation hostDedicated = allocator.allocate(requirements(16 * MB + 256), HOST_COHERENT, true);
+	CHECK(hostDedicated.block == nullptr);
+	CHECK(hostDedicated.mapped != nullptr);
+
+	MemoryStats stats = allocator.getStats();
+	CHECK_EQ(stats.dedicatedCount, 2u);
+	CHECK_EQ(stats.blockCount, 1u);
+	CHECK_EQ(stats.allocationCount, 3u);
+	CHECK_EQ(stats.reservedBytes, 64 * MB + 32 * MB + 256 + 16 * MB + 256);
+
+	allocator.free(dedicated);
+	allocator.free(hostDedicated);
+	CHECK_EQ(allocator.getStats().dedicatedCount, 0u);
+	//dedicated memory goes back to the driver right away
+	CHECK_EQ(mock::state().liveAllocations, 1u);
+
+	allocator.free(half);
+	allocator.cleanUp();
+	CHECK_EQ(mock::state().liveAllocations, 0u);
+}
+
+TEST(statsTrackRequestedAndWastedBytes)
+{
+	DeviceMemoryAllocator allocator;
+	discreteDevice(allocator);
+
+	MemoryAllocation a = allocator.allocate(requirements(300), DEVICE_LOCAL, true);
+	MemoryAllocation b = allocator.allocate(requirements(1000), DEVICE_LOCAL, true);
+	MemoryStats stats = allocator.getStats();
+	CHECK_EQ(stats.allocationCount, 2u);
+	CHECK_EQ(stats.reservedBytes, 64 * MB);
+	CHECK_EQ(stats.usedBytes, 512u + 1024u);
+	CHECK_EQ(stats.requestedBytes, 1300u);
+	CHECK_EQ(stats.wastedBytes, 512u + 1024u - 1300u);
+	CHECK(stats.fragmentation >= 0.0f && stats.fragmentation < 1.0f);
+
+	allocator.free(a);
+	stats = allocator.getStats();
+	CHECK_EQ(stats.allocationCount, 1u);
+	CHECK_EQ(stats.usedBytes, 1024u);
+	CHECK_EQ(stats.requestedBytes, 1000u);
+	CHECK(a.memory == VK_NULL_HANDLE);
+
+	allocator.free(b);
+	allocator.cleanUp();
+}
+
+TEST(freeKeepsOneEmptyBlockPerPool)
+{
+	DeviceMemoryAllocator allocator;
+	discreteDevice(allocator);
+
+	MemoryAllocation a = allocator.allocate(requirements(32 * MB), DEVICE_LOCAL, true);
+	MemoryAllocation b = allocator.allocate(requirements(32 * MB), DEVICE_LOCAL, true);
+	MemoryAllocation c = allocator.allocate(requirements(32 * MB), DEVICE_LOCAL, true);
+	CHECK(a.memory == b.memory && c.memory != a.memory);
+	CHECK_EQ(mock::state().liveAllocations, 2u);
+
+	//the first empty block stays around for the next load
+	allocator.free(c);
+	CHECK_EQ(mock::state().liveAllocations, 2u);
+	allocator.free(a);
+	allocator.free(b);
+	CHECK_EQ(mock::state().liveAllocations, 1u);
+	CHECK_EQ(allocator.getStats().blockCount, 1u);
+
+	//and gets reused
+	MemoryAllocation d = allocator.allocate(requirements(1 * KB), DEVICE_LOCAL, true);
+	CHECK_EQ(mock::state().allocateCalls, 2u);
+
+	allocator.free(d);
+	allocator.cleanUp();
+	CHECK_EQ(mock::state().liveAllocations, 0u);
+}
+
+TEST(mappedAllocationsPointIntoTheBlock)
+{
+	DeviceMemoryAllocator allocator;
+	discreteDevice(allocator);
+
+	MemoryAllocation a = allocator.allocate(requirements(1 * KB), HOST_COHERENT, true);
+	MemoryAllocation b = allocator.allocate(requirements(1 * KB), HOST_COHERENT, true);
+	CHECK(a.mapped != nullptr && b.mapped != nullptr);
+	CHECK_EQ(a.memoryType, 1u);
+	CHECK_EQ(static_cast<char*>(b.mapped) - static_cast<char*>(a.mapped), static_cast<std::ptrdiff_t>(b.offset - a.offset));
+	//the block is mapped once, not per sub-allocation
+	CHECK_EQ(mock::state().mapCalls, 1u);
+	std::memset(a.mapped, 0xab, 1 * KB);
+	std::memset(b.mapped, 0xcd, 1 * KB);
+	CHECK_EQ(static_cast<unsigned char*>(a.mapped)[1 * KB - 1], 0xab);
+
+	MemoryAllocation deviceLocal = allocator.allocate(requirements(1 * KB), DEVICE_LOCAL, true);
+	CHECK(deviceLocal.mapped == nullptr);
+
+	for (MemoryAllocation* allocation : { &a, &b, &deviceLocal })
+		allocator.free(*allocation);
+	allocator.cleanUp();
+}
+
+TEST(nonCoherentMemoryIsNeverMapped)
+{
+	DeviceMemoryAllocator allocator;
+	discreteDevice(allocator);
+
+	//nothing would flush the writes
+	CHECK_THROWS(allocator.allocate(requirements(1 * KB), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true));
+	CHECK_THROWS(allocator.allocate(requirements(1 * KB), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, true));
+	CHECK_EQ(mock::state().allocateCalls, 0u);
+	allocator.cleanUp();
+
+	//unified memory where the only device local type is host visible but not coherent
+	DeviceMemoryAllocator unified;
+	mock::reset();
+	uint32_t heap = mock::addHeap(512 * MB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+	mock::addMemoryType(heap, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	unified.init(mock::device(), mock::physicalDevice());
+
+	MemoryAllocation allocation = unified.allocate(requirements(1 * KB), DEVICE_LOCAL, false);
+	CHECK(allocation.memory != VK_NULL_HANDLE);
+	CHECK(allocation.mapped == nullptr);
+	CHECK_EQ(mock::state().mapCalls, 0u);
+
+	unified.free(allocation);
+	unified.cleanUp();
+}
+
+TEST(memoryTypeBitsAreRespected)
+{
+	DeviceMemoryAllocator allocator;
+	discreteDevice(allocator);
+
+	//host coherent memory satisfies a request without properties, if it is the only type allowed
+	MemoryAllocation allocation = allocator.allocate(requirements(1 * KB, 256, 1u << 1), 0, true);
+	CHECK_EQ(allocation.memoryType, 1u);
+	CHECK_THROWS(allocator.allocate(requirements(1 * KB, 256, 1u << 0), HOST_COHERENT, true));
+
+	allocator.free(allocation);
+	allocator.cleanUp();
+}
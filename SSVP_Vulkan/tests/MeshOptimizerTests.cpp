@@ -0,0 +1,197 @@
+#include "TestFramework.h"
+#include "MeshOptimizer.h"
+#include <array>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	//position plus the index the vertex had when the grid was built, survives any reordering
+	struct TaggedVertex {
+		float pos[3];
+		uint32_t id;
+	};
+
+	typedef std::array<uint32_t, 3> Triangle;
+
+	//n x n quads of a gently curved grid, row major
+	void makeGrid(uint32_t n, std::vector<TaggedVertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		vertices.clear();
+		indices.clear();
+		for (uint32_t y = 0; y <= n; ++y)
+		{
+			for (uint32_t x = 0; x <= n; ++x)
+				vertices.push_back({ { float(x), float(y), std::sin(x * 0.1f) }, y * (n + 1) + x });
+		}
+		for (uint32_t y = 0; y < n; ++y)
+		{
+			for (uint32_t x = 0; x < n; ++x)
+			{
+				uint32_t a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+				indices.insert(indices.end(), { a, c, b, b, c, d });
+			}
+		}
+	}
+
+	void shuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed)
+	{
+		std::vector<Triangle> triangles(indices.size() / 3);
+		for (size_t t = 0; t < triangles.size(); ++t)
+			triangles[t] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+		std::mt19937 rng(seed);
+		std::shuffle(triangles.begin(), triangles.end(), rng);
+		for (size_t t = 0; t < triangles.size(); ++t)
+			std::copy(triangles[t].begin(), triangles[t].end(), indices.begin() + t * 3);
+	}
+
+	//sorted triangles of original vertex ids, each rotated to start at its smallest id so winding is kept
+	std::vector<Triangle> canonicalTriangles(const std::vector<uint32_t>& indices, const std::vector<TaggedVertex>& vertices)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			Triangle t = { vertices[indices[i]].id, vertices[indices[i + 1]].id, vertices[indices[i + 2]].id };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	float acmr(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		return utils::analyzeVertexCache(indices.data(), indices.size(), vertexCount, VERTEX_CACHE_SIZE).acmr;
+	}
+}
+
+TEST(tipsifyOutputIsAPermutationOfTheTriangles)
+{
+	std::vector<TaggedVertex> vertices;
+	std::vector<uint32_t> indices;
+	makeGrid(64, vertices, indices);
+	shuffleTriangles(indices, 1);
+	std::vector<Triangle> before = canonicalTriangles(indices, vertices);
+
+	std::vector<uint32_t> clusters;
+	utils::optimizeVertexCache(indices.data(), indices.size(), vertices.size(), VERTEX_CACHE_SIZE, &clusters);
+	CHECK(canonicalTriangles(indices, vertices) == before);
+
+	//cluster starts are triangle aligned, ascending and begin at the first triangle
+	CHECK(!clusters.empty());
+	CHECK_EQ(clusters[0], 0u);
+	for (size_t i = 0; i < clusters.size(); ++i)
+	{
+		CHECK(clusters[i] % 3 == 0 && clusters[i] < indices.size());
+		if (i > 0)
+			CHECK(clusters[i] > clusters[i - 1]);
+	}
+}
+
+TEST(tipsifyDoesNotRegressAcmrOnAGrid)
+{
+	std::vector<TaggedVertex> vertices;
+	std::vector<uint32_t> rowMajor;
+	makeGrid(100, vertices, rowMajor);
+
+	//row major order already reuses one row of vertices, wider than the cache it still misses about once per triangle
+	std::vector<uint32_t> indices = rowMajor;
+	float rowMajorAcmr = acmr(indices, vertices.size());
+	utils::optimizeVertexCache(indices.data(), indices.size(), vertices.size(), VERTEX_CACHE_SIZE);
+	float optimizedAcmr = acmr(indices, vertices.size());
+	CHECK(optimizedAcmr <= rowMajorAcmr);
+	CHECK(optimizedAcmr >= 0.5f);
+
+	std::vector<uint32_t> shuffled = rowMajor;
+	shuffleTriangles(shuffled, 2);
+	float shuffledAcmr = acmr(shuffled, vertices.size());
+	utils::optimizeVertexCache(shuffled.data(), shuffled.size(), vertices.size(), VERTEX_CACHE_SIZE);
+	CHECK(acmr(shuffled, vertices.size()) < shuffledAcmr);
+	//the input order should barely matter to tipsify
+	CHECK(acmr(shuffled, vertices.size()) <= optimizedAcmr * 1.1f);
+}
+
+TEST(vertexFetchRemapIsABijection)
+{
+	std::vector<TaggedVertex> vertices;
+	std::vector<uint32_t> indices;
+	makeGrid(32, vertices, indices);
+	shuffleTriangles(indices, 3);
+	std::vector<Triangle> before = canonicalTriangles(indices, vertices);
+
+	//a vertex no triangle references, dropped by the remap
+	vertices.push_back({ { 0.0f, 0.0f, 0.0f }, uint32_t(vertices.size()) });
+	size_t referenced = vertices.size() - 1;
+
+	size_t vertexCount = utils::optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(TaggedVertex), indices.data(), indices.size());
+	CHECK_EQ(vertexCount, referenced);
+
+	//every referenced vertex comes out exactly once
+	std::vector<uint32_t> seen(referenced, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		CHECK(vertices[v].id < referenced);
+		seen[vertices[v].id]++;
+	}
+	CHECK(std::all_of(seen.begin(), seen.end(), [](uint32_t count) { return count == 1; }));
+
+	//same triangles, and vertices are numbered in first use order
+	vertices.resize(vertexCount);
+	CHECK(canonicalTriangles(indices, vertices) == before);
+	uint32_t next = 0;
+	for (uint32_t index : indices)
+	{
+		CHECK(index <= next);
+		if (index == next)
+			next++;
+	}
+	CHECK_EQ(next, vertexCount);
+}
+
+TEST(optimizeMeshKeepsTheRenderedTriangles)
+{
+	std::vector<TaggedVertex> vertices;
+	std::vector<uint32_t> indices;
+	makeGrid(48, vertices, indices);
+	shuffleTriangles(indices, 4);
+	std::vector<Triangle> before = canonicalTriangles(indices, vertices);
+
+	size_t vertexCount = vertices.size();
+	MeshOptimizationStats stats = utils::optimizeMesh(vertices.data(), vertexCount, sizeof(TaggedVertex), indices.data(), indices.size());
+	CHECK_EQ(vertexCount, vertices.size());
+	CHECK(stats.clusterCount >= 1);
+	CHECK(stats.after.acmr < stats.before.acmr);
+	CHECK(stats.after.atvr <= stats.before.atvr);
+	CHECK(canonicalTriangles(indices, vertices) == before);
+}
+
+TEST(splitMeshKeepsTrianglesUnderTheVertexLimit)
+{
+	std::vector<TaggedVertex> vertices;
+	std::vector<uint32_t> indices;
+	makeGrid(40, vertices, indices);
+	std::vector<Triangle> before = canonicalTriangles(indices, vertices);
+
+	const uint32_t maxVertices = 300;
+	std::vector<MeshSplit> splits;
+	size_t total = utils::splitMesh(indices.data(), indices.size(), vertices.size(), maxVertices, splits);
+	CHECK(splits.size() > 1);
+
+	size_t splitVertices = 0;
+	std::vector<Triangle> after;
+	for (auto& split : splits)
+	{
+		CHECK(split.vertexRemap.size() <= maxVertices);
+		splitVertices += split.vertexRemap.size();
+		for (size_t i = 0; i < split.indices.size(); i += 3)
+		{
+			Triangle t = { split.vertexRemap[split.indices[i]], split.vertexRemap[split.indices[i + 1]], split.vertexRemap[split.indices[i + 2]] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			after.push_back(t);
+		}
+	}
+	std::sort(after.begin(), after.end());
+	CHECK(after == before);
+	CHECK_EQ(total, splitVertices);
+}
@@ -0,0 +1,226 @@
+#include "TestFramework.h"
+#include "VulkanMock.h"
+#include "RenderGraph.h"
+#include "MemoryAllocator.h"
+#include <vector>
+#include <string>
+
+namespace {
+	const VkFormat COLOR = VK_FORMAT_R8G8B8A8_UNORM;
+
+	//a device with one device local memory type, a single image backbuffer and an empty command buffer
+	struct GraphFixture {
+		VkExtent2D extent{ 64, 32 };
+		DeviceMemoryAllocator allocator;
+		RenderGraph graph;
+		RenderGraphResource backbuffer;
+		VkCommandBuffer commandBuffer = mock::makeHandle<VkCommandBuffer>(0xc0ffee);
+		//names of the passes in the order execute ran them
+		std::vector<std::string> ran;
+
+		GraphFixture() : graph(mock::device(), setUpDevice(allocator), extent)
+		{
+			backbuffer = graph.importImages("backbuffer", COLOR, { mock::makeHandle<VkImage>(0xbac4) }, { mock::makeHandle<VkImageView>(0xbac5) },
+				extent, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		}
+
+		//runs before the graph is constructed
+		static DeviceMemoryAllocator& setUpDevice(DeviceMemoryAllocator& allocator)
+		{
+			mock::reset();
+			uint32_t heap = mock::addHeap(256 * 1024 * 1024, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+			mock::addMemoryType(heap, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			allocator.init(mock::device(), mock::physicalDevice());
+			return allocator;
+		}
+
+		RenderGraphResource transient(const std::string& name)
+		{
+			RenderGraphImageDesc desc;
+			desc.format = COLOR;
+			return graph.createImage(name, desc);
+		}
+
+		uint32_t pass(const std::string& name, const std::vector<RenderGraphAccess>& accesses)
+		{
+			return graph.addPass(name, accesses, [this, name](const RenderGraphPassContext&) { ran.push_back(name); });
+		}
+
+		void execute()
+		{
+			ran.clear();
+			mock::state().barriers.clear();
+			graph.execute(commandBuffer);
+		}
+
+		//barriers recorded for resource during the last execute
+		std::vector<MockBarrier> barriersOf(RenderGraphResource resource) const
+		{
+			std::vector<MockBarrier> barriers;
+			for (const MockBarrier& barrier : mock::state().barriers)
+				if (barrier.image == graph.image(resource))
+					barriers.push_back(barrier);
+			return barriers;
+		}
+	};
+
+	RenderGraphAccess access(RenderGraphResource resource, RenderGraphUsage usage, bool clear = false)
+	{
+		RenderGraphAccess a{};
+		a.resource = resource;
+		a.usage = usage;
+		a.clear = clear;
+		return a;
+	}
+
+	typedef std::vector<std::string> Names;
+}
+
+TEST(renderGraphKeepsReadersBeforeTheNextWriter)
+{
+	GraphFixture f;
+	RenderGraphResource scratch = f.transient("scratch");
+
+	//scratch is written twice, each version is read once. the second writer may only start once the first
+	//reader is done with it, otherwise lighting would sample the overlay
+	f.pass("gbuffer", { access(scratch, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("lighting", { access(scratch, RenderGraphUsage::Sampled), access(f.backbuffer, RenderGraphUsage::ColorAttachment, true) });
+	uint32_t overlay = f.pass("overlay", { access(scratch, RenderGraphUsage::ColorAttachment, true) });
+	uint32_t compose = f.pass("compose", { access(scratch, RenderGraphUsage::Sampled), access(f.backbuffer, RenderGraphUsage::ColorAttachment) });
+	f.execute();
+	CHECK(f.ran == Names({ "gbuffer", "lighting", "overlay", "compose" }));
+
+	//write after read: an execution dependency on the sampling stages, nothing to make available
+	std::vector<MockBarrier> barriers = f.barriersOf(scratch);
+	CHECK_EQ(barriers.size(), size_t(4));
+	const MockBarrier& war = barriers[2];
+	CHECK_EQ(war.oldLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	CHECK_EQ(war.newLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK_EQ(war.srcAccess, VkAccessFlags(0));
+	CHECK((war.srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) != 0);
+
+	//overlay stores for compose, compose loads what lighting rendered into the backbuffer
+	std::vector<VkAttachmentDescription> overlayAttachments = mock::renderPassAttachments(f.graph.renderPass(overlay));
+	CHECK_EQ(overlayAttachments.size(), size_t(1));
+	CHECK_EQ(overlayAttachments[0].storeOp, VK_ATTACHMENT_STORE_OP_STORE);
+	std::vector<VkAttachmentDescription> composeAttachments = mock::renderPassAttachments(f.graph.renderPass(compose));
+	CHECK_EQ(composeAttachments.size(), size_t(1));
+	CHECK_EQ(composeAttachments[0].loadOp, VK_ATTACHMENT_LOAD_OP_LOAD);
+}
+
+TEST(renderGraphRejectsReadsOfUnwrittenTransients)
+{
+	GraphFixture f;
+	RenderGraphResource scratch = f.transient("scratch");
+
+	//declared before its writer, there is nothing to read yet
+	f.pass("early read", { access(scratch, RenderGraphUsage::Sampled), access(f.backbuffer, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("write", { access(scratch, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("late read", { access(scratch, RenderGraphUsage::Sampled), access(f.backbuffer, RenderGraphUsage::ColorAttachment) });
+	CHECK_THROWS(f.graph.compile());
+}
+
+TEST(renderGraphCullsPassesThatDontReachAnImport)
+{
+	GraphFixture f;
+	RenderGraphResource used = f.transient("used");
+	RenderGraphResource unused = f.transient("unused");
+	RenderGraphResource chainA = f.transient("chain a");
+	RenderGraphResource chainB = f.transient("chain b");
+
+	f.pass("producer", { access(used, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("dead end", { access(unused, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("chain start", { access(chainA, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("chain end", { access(chainA, RenderGraphUsage::Sampled), access(chainB, RenderGraphUsage::StorageWrite) });
+	f.pass("present", { access(used, RenderGraphUsage::Sampled), access(f.backbuffer, RenderGraphUsage::ColorAttachment, true) });
+	//no writes, side effects the graph can't see
+	f.pass("readback", { access(used, RenderGraphUsage::TransferSrc) });
+	f.execute();
+
+	CHECK(f.ran == Names({ "producer", "present", "readback" }));
+	//culled transients are never created
+	CHECK(f.graph.image(used) != VK_NULL_HANDLE);
+	CHECK(f.graph.image(unused) == VK_NULL_HANDLE);
+	CHECK(f.graph.image(chainA) == VK_NULL_HANDLE);
+	CHECK(f.graph.image(chainB) == VK_NULL_HANDLE);
+	CHECK_EQ(mock::state().liveImages, 1u);
+	CHECK_EQ(mock::state().liveRenderPasses, 2u);
+}
+
+TEST(renderGraphAliasesTransientsWithDisjointLifetimes)
+{
+	GraphFixture f;
+	RenderGraphResource a = f.transient("a");
+	RenderGraphResource b = f.transient("b");
+	RenderGraphResource c = f.transient("c");
+	RenderGraphResource half = f.graph.createImage("half", { COLOR, 0.5f });
+
+	//a lives in passes 0-1, b in 1-2, c in 2-3: a and c can share memory, b overlaps both
+	f.pass("a", { access(a, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("a to b", { access(a, RenderGraphUsage::Sampled), access(b, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("b to c", { access(b, RenderGraphUsage::Sampled), access(c, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("c to half", { access(c, RenderGraphUsage::Sampled), access(half, RenderGraphUsage::ColorAttachment, true) });
+	f.pass("present", { access(half, RenderGraphUsage::Sampled), access(f.backbuffer, RenderGraphUsage::ColorAttachment, true) });
+	f.execute();
+	CHECK_EQ(f.ran.size(), size_t(5));
+
+	const MockImage* imageA = mock::image(f.graph.image(a));
+	const MockImage* imageB = mock::image(f.graph.image(b));
+	const MockImage* imageC = mock::image(f.graph.image(c));
+	const MockImage* imageHalf = mock::image(f.graph.image(half));
+	CHECK(imageA && imageB && imageC && imageHalf);
+	CHECK_EQ(imageHalf->info.extent.width, 32u);
+	CHECK_EQ(imageHalf->info.extent.height, 16u);
+
+	auto sameMemory = [](const MockImage* x, const MockImage* y) {
+		return mock::handleId(x->memory) == mock::handleId(y->memory) && x->offset == y->offset;
+	};
+	CHECK(sameMemory(imageA, imageC));
+	CHECK(!sameMemory(imageA, imageB));
+	//half starts where b ends, it fits into b's slot
+	CHECK(sameMemory(imageB, imageHalf));
+
+	//c takes over a's memory: it waits for a's last sampling and starts from undefined contents
+	std::vector<MockBarrier> barriers = f.barriersOf(c);
+	CHECK(!barriers.empty());
+	CHECK_EQ(barriers[0].oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK((barriers[0].srcStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) != 0);
+}
+
+TEST(renderGraphRecompilesOnlyOnChange)
+{
+	GraphFixture f;
+	RenderGraphResource scratch = 0;
+	auto declare = [&]() {
+		f.graph.clear();
+		f.backbuffer = f.graph.importImages("backbuffer", COLOR, { mock::makeHandle<VkImage>(0xbac4) }, { mock::makeHandle<VkImageView>(0xbac5) },
+			f.extent, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		scratch = f.transient("scratch");
+		f.pass("draw", { access(scratch, RenderGraphUsage::ColorAttachment, true) });
+		f.pass("present", { access(scratch, RenderGraphUsage::Sampled), access(f.backbuffer, RenderGraphUsage::ColorAttachment, true) });
+	};
+
+	declare();
+	f.execute();
+	uint32_t creates = mock::state().renderPassCreates;
+
+	//declared the same way again, nothing is recreated
+	declare();
+	f.execute();
+	CHECK_EQ(mock::state().renderPassCreates, creates);
+
+	//a resize changes every transient, the graph follows the extent it was given
+	f.extent = { 128, 64 };
+	f.execute();
+	CHECK(mock::state().renderPassCreates > creates);
+	CHECK_EQ(mock::image(f.graph.image(scratch))->info.extent.width, 128u);
+
+	//without a deferDestroy the replaced objects went right away
+	CHECK_EQ(mock::state().liveImages, 1u);
+	CHECK_EQ(mock::state().liveRenderPasses, 2u);
+	f.graph.destroyCompiled();
+	CHECK_EQ(mock::state().liveImages, 0u);
+	CHECK_EQ(mock::state().liveImageViews, 0u);
+	CHECK_EQ(mock::state().liveRenderPasses, 0u);
+	CHECK_EQ(mock::state().liveFramebuffers, 0u);
+}
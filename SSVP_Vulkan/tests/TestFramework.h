@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <string>
+#include <sstream>
+
+//minimal self registering test cases, the runner in TestMain.cpp runs every TEST in the binary.
+//a failed CHECK throws out of the test case, the rest of the cases still run
+namespace test {
+	struct TestCase {
+		const char* name;
+		std::function<void()> run;
+	};
+
+	struct Failure {
+		std::string message;
+	};
+
+	std::vector<TestCase>& registry();
+	[[noreturn]] void fail(const char* file, int line, const std::string& message);
+
+	struct Registrar {
+		Registrar(const char* name, std::function<void()> run) { registry().push_back({ name, std::move(run) }); }
+	};
+}
+
+#define TEST_CONCAT_(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_(a, b)
+
+#define TEST(name) \
+	static void name(); \
+	static test::Registrar TEST_CONCAT(s_register_, name)(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) test::fail(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_EQ(a, b) \
+	do { \
+		auto&& checkA = (a); \
+		auto&& checkB = (b); \
+		if (!(checkA == checkB)) { \
+			std::ostringstream checkMessage; \
+			checkMessage << #a " == " #b " (" << checkA << " vs " << checkB << ")"; \
+			test::fail(__FILE__, __LINE__, checkMessage.str()); \
+		} \
+	} while (0)
+
+#define CHECK_THROWS(expression) \
+	do { \
+		bool checkThrew = false; \
+		try { expression; } catch (...) { checkThrew = true; } \
+		if (!checkThrew) test::fail(__FILE__, __LINE__, "expected " #expression " to throw"); \
+	} while (0)
@@ -0,0 +1,52 @@
+#include "TestFramework.h"
+#include <iostream>
+#include <cstring>
+#include <exception>
+#include <cstdint>
+#include <cstdlib>
+
+std::vector<test::TestCase>& test::registry()
+{
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+void test::fail(const char* file, int line, const std::string& message)
+{
+	std::ostringstream s;
+	s << file << ":" << line << ": " << message;
+	throw Failure{ s.str() };
+}
+
+//SSVP_Tests [filter], only runs the cases whose name contains filter
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	uint32_t passed = 0;
+	uint32_t failed = 0;
+	for (const test::TestCase& testCase : test::registry())
+	{
+		if (filter && std::strstr(testCase.name, filter) == nullptr)
+			continue;
+
+		try
+		{
+			testCase.run();
+			passed++;
+		}
+		catch (const test::Failure& failure)
+		{
+			std::cout << "[TESTS]: " << testCase.name << " failed\n\t" << failure.message << std::endl;
+			failed++;
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "[TESTS]: " << testCase.name << " threw\n\t" << e.what() << std::endl;
+			failed++;
+		}
+	}
+
+	std::cout << "[TESTS]: " << passed << " passed, " << failed << " failed" << std::endl;
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
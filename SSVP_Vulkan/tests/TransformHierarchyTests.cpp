@@ -0,0 +1,130 @@
+#include "TestFramework.h"
+#include "TransformHierarchy.h"
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+	//near identity rotation/scale part, so long parent chains stay in a sane range
+	glm::mat4 randomLocal(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> small(-0.3f, 0.3f);
+		std::uniform_real_distribution<float> translation(-10.0f, 10.0f);
+		glm::mat4 local(1.0f);
+		for (int c = 0; c < 3; ++c)
+		{
+			for (int r = 0; r < 3; ++r)
+				local[c][r] += small(rng);
+		}
+		local[3] = glm::vec4(translation(rng), translation(rng), translation(rng), 1.0f);
+		return local;
+	}
+
+	//the straightforward definition, walks up to the root for every node
+	glm::mat4 referenceWorld(const TransformHierarchy& transforms, uint32_t node)
+	{
+		int32_t parent = transforms.m_parents[node];
+		if (parent == TransformHierarchy::NO_PARENT)
+			return transforms.m_local[node];
+		return referenceWorld(transforms, static_cast<uint32_t>(parent)) * transforms.m_local[node];
+	}
+
+	bool matchesReference(const TransformHierarchy& transforms)
+	{
+		for (uint32_t node = 0; node < transforms.size(); ++node)
+		{
+			glm::mat4 expected = referenceWorld(transforms, node);
+			const glm::mat4& world = transforms.world(node);
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 4; ++r)
+				{
+					if (std::fabs(world[c][r] - expected[c][r]) > 1e-4f * std::max(1.0f, std::fabs(expected[c][r])))
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool isBelow(const TransformHierarchy& transforms, uint32_t node, uint32_t ancestor)
+	{
+		for (int32_t n = static_cast<int32_t>(node); n != TransformHierarchy::NO_PARENT; n = transforms.m_parents[n])
+		{
+			if (static_cast<uint32_t>(n) == ancestor)
+				return true;
+		}
+		return false;
+	}
+}
+
+TEST(transformHierarchyMatchesRecursiveWalk)
+{
+	std::mt19937 rng(15);
+	TransformHierarchy transforms;
+
+	//a forest, every node picks any earlier node as its parent
+	const uint32_t nodeCount = 2000;
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		int32_t parent = TransformHierarchy::NO_PARENT;
+		if (i > 0 && std::uniform_int_distribution<int>(0, 9)(rng) != 0)
+			parent = std::uniform_int_distribution<int32_t>(0, static_cast<int32_t>(i) - 1)(rng);
+		transforms.addNode(parent, randomLocal(rng));
+	}
+
+	CHECK_EQ(transforms.updateWorld(), nodeCount);
+	CHECK(matchesReference(transforms));
+	//nothing changed, nothing is recomputed
+	CHECK_EQ(transforms.updateWorld(), 0u);
+
+	//moving one subtree recomputes exactly the subtree
+	for (uint32_t root : { 3u, nodeCount / 2, nodeCount - 1 })
+	{
+		uint32_t subtree = 0;
+		for (uint32_t node = 0; node < nodeCount; ++node)
+			subtree += isBelow(transforms, node, root) ? 1 : 0;
+
+		transforms.setLocal(root, randomLocal(rng));
+		CHECK_EQ(transforms.updateWorld(), subtree);
+		CHECK(matchesReference(transforms));
+	}
+
+	//two overlapping edits in one update
+	uint32_t parent = static_cast<uint32_t>(transforms.m_parents[nodeCount - 1] == TransformHierarchy::NO_PARENT ? 0 : transforms.m_parents[nodeCount - 1]);
+	transforms.setLocal(nodeCount - 1, randomLocal(rng));
+	transforms.setLocal(parent, randomLocal(rng));
+	transforms.updateWorld();
+	CHECK(matchesReference(transforms));
+}
+
+TEST(transformHierarchyAttachesImportedRoots)
+{
+	std::mt19937 rng(16);
+	TransformHierarchy transforms;
+	uint32_t anchor = transforms.addNode(TransformHierarchy::NO_PARENT, randomLocal(rng));
+
+	//parents inside the imported list are relative to it, its roots hang below anchor
+	SceneNode nodes[4];
+	int32_t parents[4] = { TransformHierarchy::NO_PARENT, 0, 0, TransformHierarchy::NO_PARENT };
+	for (int i = 0; i < 4; ++i)
+	{
+		nodes[i].parent = parents[i];
+		nodes[i].local = randomLocal(rng);
+	}
+	uint32_t base = transforms.addNodes(nodes, 4, static_cast<int32_t>(anchor));
+	CHECK_EQ(base, 1u);
+	CHECK_EQ(transforms.m_parents[base], static_cast<int32_t>(anchor));
+	CHECK_EQ(transforms.m_parents[base + 1], static_cast<int32_t>(base));
+	CHECK_EQ(transforms.m_parents[base + 3], static_cast<int32_t>(anchor));
+
+	transforms.updateWorld();
+	CHECK(matchesReference(transforms));
+
+	//moving the anchor moves every imported node
+	transforms.setLocal(anchor, randomLocal(rng));
+	CHECK_EQ(transforms.updateWorld(), 5u);
+	CHECK(matchesReference(transforms));
+
+	CHECK_THROWS(transforms.addNode(42, glm::mat4(1.0f)));
+}
@@ -0,0 +1,175 @@
+#include "TestFramework.h"
+#include "VertexPacking.h"
+#include <random>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace {
+	//orthonormal frame with the given handedness, bitangent = cross(n, t) * handedness
+	vertex makeVertex(const glm::vec3& pos, const glm::vec2& uv, const glm::vec3& normal, const glm::vec3& tangent, float handedness)
+	{
+		vertex v;
+		v.pos = pos;
+		v.uv = uv;
+		v.normal = glm::normalize(normal);
+		v.tangent = glm::normalize(tangent - v.normal * glm::dot(v.normal, tangent));
+		v.bitangent = glm::cross(v.normal, v.tangent) * handedness;
+		return v;
+	}
+
+	std::vector<vertex> randomVertices(size_t count, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+		std::vector<vertex> vertices;
+		vertices.reserve(count);
+		while (vertices.size() < count)
+		{
+			glm::vec3 n(u(rng), u(rng), u(rng));
+			glm::vec3 t(u(rng), u(rng), u(rng));
+			if (glm::length(n) < 0.1f || glm::length(glm::cross(n, t)) < 0.1f)
+				continue;
+			vertices.push_back(makeVertex(glm::vec3(u(rng) * 50.0f, u(rng) * 3.0f, u(rng) * 20.0f),
+				glm::vec2(u(rng) * 4.0f, u(rng) * 4.0f), n, t, u(rng) < 0.0f ? -1.0f : 1.0f));
+		}
+		return vertices;
+	}
+
+	std::vector<vertex> roundTrip(const std::vector<vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsExtent)
+	{
+		computeBounds(vertices.data(), static_cast<uint32_t>(vertices.size()), boundsMin, boundsExtent);
+		std::vector<packedVertex> packed;
+		encodePackedVertices(vertices.data(), static_cast<uint32_t>(vertices.size()), boundsMin, boundsExtent, packed);
+
+		std::vector<vertex> decoded;
+		for (auto& p : packed)
+			decoded.push_back(decodePackedVertex(p, boundsMin, boundsExtent));
+		return decoded;
+	}
+
+	//largest error of a snorm16 qtangent frame, a few quantization steps of 1 / 32767
+	const float FRAME_ERROR = 2e-4f;
+}
+
+TEST(packedPositionsStayWithinHalfAUnorm16Step)
+{
+	std::vector<vertex> vertices = randomVertices(20000, 1);
+	glm::vec3 boundsMin, boundsExtent;
+	std::vector<vertex> decoded = roundTrip(vertices, boundsMin, boundsExtent);
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			//half a step plus float rounding of the decode
+			float bound = boundsExtent[axis] * (0.5f / 65535.0f + 1e-6f);
+			CHECK(std::fabs(decoded[i].pos[axis] - vertices[i].pos[axis]) <= bound);
+		}
+	}
+}
+
+TEST(packedPositionsOnFlatAxesDecodeToTheBounds)
+{
+	std::vector<vertex> vertices = randomVertices(100, 2);
+	for (auto& v : vertices)
+		v.pos.y = 7.0f;
+
+	glm::vec3 boundsMin, boundsExtent;
+	std::vector<vertex> decoded = roundTrip(vertices, boundsMin, boundsExtent);
+	CHECK_EQ(boundsExtent.y, 0.0f);
+	for (auto& v : decoded)
+		CHECK_EQ(v.pos.y, 7.0f);
+}
+
+TEST(packedUVsStayWithinHalfPrecision)
+{
+	std::vector<vertex> vertices = randomVertices(20000, 3);
+	glm::vec3 boundsMin, boundsExtent;
+	std::vector<vertex> decoded = roundTrip(vertices, boundsMin, boundsExtent);
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		for (int c = 0; c < 2; ++c)
+		{
+			//11 significant bits, round to nearest is half a unit in the last place. the floor covers subnormals
+			float bound = std::max(std::fabs(vertices[i].uv[c]) * std::ldexp(1.0f, -11), std::ldexp(1.0f, -25));
+			CHECK(std::fabs(decoded[i].uv[c] - vertices[i].uv[c]) <= bound);
+		}
+	}
+}
+
+TEST(halfConversionRoundsAndSaturates)
+{
+	for (float exact : { 0.0f, 1.0f, -2.5f, 0.5f, 65504.0f, -65504.0f, 6.103515625e-05f, 5.9604644775390625e-08f })
+		CHECK_EQ(halfToFloat(floatToHalf(exact)), exact);
+
+	//1 + 2^-11 is exactly between two halves, ties go to the even one
+	CHECK_EQ(halfToFloat(floatToHalf(1.0f + std::ldexp(1.0f, -11))), 1.0f);
+	CHECK_EQ(halfToFloat(floatToHalf(1.0f + 3.0f * std::ldexp(1.0f, -11))), 1.0f + std::ldexp(1.0f, -9));
+
+	CHECK(std::isinf(halfToFloat(floatToHalf(70000.0f))));
+	CHECK(halfToFloat(floatToHalf(-70000.0f)) < 0.0f);
+	CHECK(std::isinf(halfToFloat(floatToHalf(std::numeric_limits<float>::infinity()))));
+	CHECK(std::isnan(halfToFloat(floatToHalf(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+TEST(qtangentFrameErrorIsBounded)
+{
+	std::vector<vertex> vertices = randomVertices(20000, 4);
+	glm::vec3 boundsMin, boundsExtent;
+	std::vector<vertex> decoded = roundTrip(vertices, boundsMin, boundsExtent);
+
+	float normalError = 0.0f, tangentError = 0.0f, bitangentError = 0.0f;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		normalError = std::max(normalError, glm::length(decoded[i].normal - vertices[i].normal));
+		tangentError = std::max(tangentError, glm::length(decoded[i].tangent - vertices[i].tangent));
+		bitangentError = std::max(bitangentError, glm::length(decoded[i].bitangent - vertices[i].bitangent));
+	}
+	CHECK(normalError < FRAME_ERROR);
+	CHECK(tangentError < FRAME_ERROR);
+	CHECK(bitangentError < FRAME_ERROR);
+}
+
+TEST(qtangentKeepsFlippedHandedness)
+{
+	//identity, 180 degree turns about each axis (w == 0 before the encoder clamps it) and a random frame, both handednesses
+	const glm::vec3 frames[][2] = {
+		{ glm::vec3(0, 0, 1), glm::vec3(1, 0, 0) },
+		{ glm::vec3(0, 0, 1), glm::vec3(-1, 0, 0) },
+		{ glm::vec3(0, 0, -1), glm::vec3(1, 0, 0) },
+		{ glm::vec3(0, 0, -1), glm::vec3(-1, 0, 0) },
+		{ glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) },
+		{ glm::vec3(0.3f, -0.5f, 0.8f), glm::vec3(0.9f, 0.1f, -0.2f) },
+	};
+
+	std::vector<vertex> vertices;
+	for (auto& frame : frames)
+	{
+		for (float handedness : { 1.0f, -1.0f })
+			vertices.push_back(makeVertex(glm::vec3(0.0f), glm::vec2(0.0f), frame[0], frame[1], handedness));
+	}
+
+	glm::vec3 boundsMin, boundsExtent;
+	std::vector<vertex> decoded = roundTrip(vertices, boundsMin, boundsExtent);
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		CHECK(glm::length(decoded[i].normal - vertices[i].normal) < FRAME_ERROR);
+		CHECK(glm::length(decoded[i].tangent - vertices[i].tangent) < FRAME_ERROR);
+		CHECK(glm::length(decoded[i].bitangent - vertices[i].bitangent) < FRAME_ERROR);
+	}
+}
+
+TEST(qtangentOrthogonalizesTheImportedTangent)
+{
+	vertex v = makeVertex(glm::vec3(0.0f), glm::vec2(0.0f), glm::vec3(0, 0, 1), glm::vec3(1, 0, 0), -1.0f);
+	glm::vec3 expectedTangent = v.tangent;
+	//skewed towards the normal, the way importers average tangents over faces
+	v.tangent = glm::normalize(v.tangent + v.normal * 0.3f);
+
+	glm::vec3 boundsMin, boundsExtent;
+	std::vector<vertex> decoded = roundTrip({ v }, boundsMin, boundsExtent);
+	CHECK(glm::length(decoded[0].tangent - expectedTangent) < FRAME_ERROR);
+	CHECK(glm::dot(decoded[0].bitangent, v.bitangent) > 0.99f);
+}
@@ -0,0 +1,203 @@
+#include "VulkanMock.h"
+#include <map>
+#include <memory>
+
+namespace {
+	MockDevice s_state;
+	uint64_t s_nextHandle = 1;
+	//backing storage of every live VkDeviceMemory
+	std::map<uint64_t, std::pair<std::unique_ptr<char[]>, VkDeviceSize>> s_memory;
+	std::map<uint64_t, MockImage> s_images;
+	std::map<uint64_t, std::vector<VkAttachmentDescription>> s_renderPasses;
+}
+
+VkDevice mock::device()
+{
+	return makeHandle<VkDevice>(0xde71ce);
+}
+
+VkPhysicalDevice mock::physicalDevice()
+{
+	return makeHandle<VkPhysicalDevice>(0x9a75);
+}
+
+MockDevice& mock::state()
+{
+	return s_state;
+}
+
+void mock::reset()
+{
+	s_state = MockDevice{};
+	s_memory.clear();
+	s_images.clear();
+	s_renderPasses.clear();
+}
+
+uint32_t mock::addHeap(VkDeviceSize size, VkMemoryHeapFlags flags)
+{
+	uint32_t index = s_state.memoryProperties.memoryHeapCount++;
+	s_state.memoryProperties.memoryHeaps[index].size = size;
+	s_state.memoryProperties.memoryHeaps[index].flags = flags;
+	return index;
+}
+
+uint32_t mock::addMemoryType(uint32_t heapIndex, VkMemoryPropertyFlags flags)
+{
+	uint32_t index = s_state.memoryProperties.memoryTypeCount++;
+	s_state.memoryProperties.memoryTypes[index].heapIndex = heapIndex;
+	s_state.memoryProperties.memoryTypes[index].propertyFlags = flags;
+	return index;
+}
+
+const MockImage* mock::image(VkImage image)
+{
+	auto it = s_images.find(handleId(image));
+	return it != s_images.end() ? &it->second : nullptr;
+}
+
+std::vector<VkAttachmentDescription> mock::renderPassAttachments(VkRenderPass renderPass)
+{
+	auto it = s_renderPasses.find(handleId(renderPass));
+	return it != s_renderPasses.end() ? it->second : std::vector<VkAttachmentDescription>{};
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+	*pMemoryProperties = s_state.memoryProperties;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks*, VkDeviceMemory* pMemory)
+{
+	if (pAllocateInfo->memoryTypeIndex >= s_state.memoryProperties.memoryTypeCount)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	uint64_t id = s_nextHandle++;
+	//left uninitialized, blocks are big and mostly never touched
+	s_memory[id] = { std::unique_ptr<char[]>(new char[pAllocateInfo->allocationSize]), pAllocateInfo->allocationSize };
+	*pMemory = mock::makeHandle<VkDeviceMemory>(id);
+
+	s_state.allocateCalls++;
+	s_state.liveAllocations++;
+	s_state.liveBytes += pAllocateInfo->allocationSize;
+	s_state.lastAllocationSize = pAllocateInfo->allocationSize;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+	auto it = s_memory.find(mock::handleId(memory));
+	if (it == s_memory.end())
+		return;
+
+	s_state.freeCalls++;
+	s_state.liveAllocations--;
+	s_state.liveBytes -= it->second.second;
+	s_memory.erase(it);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void** ppData)
+{
+	auto it = s_memory.find(mock::handleId(memory));
+	if (it == s_memory.end())
+		return VK_ERROR_MEMORY_MAP_FAILED;
+
+	s_state.mapCalls++;
+	*ppData = it->second.first.get() + offset;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkImage* pImage)
+{
+	uint64_t id = s_nextHandle++;
+	s_images[id] = { *pCreateInfo, VK_NULL_HANDLE, 0 };
+	*pImage = mock::makeHandle<VkImage>(id);
+	s_state.liveImages++;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks*)
+{
+	if (s_images.erase(mock::handleId(image)) > 0)
+		s_state.liveImages--;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* pMemoryRequirements)
+{
+	const VkImageCreateInfo& info = s_images.at(mock::handleId(image)).info;
+	VkDeviceSize size = VkDeviceSize(info.extent.width) * info.extent.height * info.extent.depth * 4;
+	pMemoryRequirements->size = (size + 255) & ~VkDeviceSize(255);
+	pMemoryRequirements->alignment = 256;
+	pMemoryRequirements->memoryTypeBits = ~0u;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+	MockImage& bound = s_images.at(mock::handleId(image));
+	bound.memory = memory;
+	bound.offset = memoryOffset;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView* pView)
+{
+	*pView = mock::makeHandle<VkImageView>(s_nextHandle++);
+	s_state.liveImageViews++;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice, VkImageView imageView, const VkAllocationCallbacks*)
+{
+	if (imageView != VK_NULL_HANDLE)
+		s_state.liveImageViews--;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(VkDevice, const VkRenderPassCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkRenderPass* pRenderPass)
+{
+	uint64_t id = s_nextHandle++;
+	s_renderPasses[id].assign(pCreateInfo->pAttachments, pCreateInfo->pAttachments + pCreateInfo->attachmentCount);
+	*pRenderPass = mock::makeHandle<VkRenderPass>(id);
+	s_state.liveRenderPasses++;
+	s_state.renderPassCreates++;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass(VkDevice, VkRenderPass renderPass, const VkAllocationCallbacks*)
+{
+	if (s_renderPasses.erase(mock::handleId(renderPass)) > 0)
+		s_state.liveRenderPasses--;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(VkDevice, const VkFramebufferCreateInfo*, const VkAllocationCallbacks*, VkFramebuffer* pFramebuffer)
+{
+	*pFramebuffer = mock::makeHandle<VkFramebuffer>(s_nextHandle++);
+	s_state.liveFramebuffers++;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer(VkDevice, VkFramebuffer framebuffer, const VkAllocationCallbacks*)
+{
+	if (framebuffer != VK_NULL_HANDLE)
+		s_state.liveFramebuffers--;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+	VkDependencyFlags, uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*,
+	uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers)
+{
+	for (uint32_t i = 0; i < imageMemoryBarrierCount; ++i)
+	{
+		const VkImageMemoryBarrier& barrier = pImageMemoryBarriers[i];
+		s_state.barriers.push_back({ barrier.image, barrier.oldLayout, barrier.newLayout,
+			barrier.srcAccessMask, barrier.dstAccessMask, srcStageMask, dstStageMask });
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(VkCommandBuffer, const VkRenderPassBeginInfo*, VkSubpassContents)
+{
+	s_state.renderPassBegins++;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer)
+{
+}
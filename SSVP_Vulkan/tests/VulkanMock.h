@@ -0,0 +1,82 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//one image barrier of a recorded vkCmdPipelineBarrier, with the stages of the whole call
+struct MockBarrier {
+	VkImage image;
+	VkImageLayout oldLayout;
+	VkImageLayout newLayout;
+	VkAccessFlags srcAccess;
+	VkAccessFlags dstAccess;
+	VkPipelineStageFlags srcStages;
+	VkPipelineStageFlags dstStages;
+};
+
+struct MockImage {
+	VkImageCreateInfo info;
+	//null until vkBindImageMemory
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+};
+
+//the test binary doesn't link vulkan-1.lib, VulkanMock.cpp defines the entry points the tested modules call.
+//device memory is host memory, so mapped pointers can be written and read back
+struct MockDevice {
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+
+	uint32_t allocateCalls = 0;
+	uint32_t freeCalls = 0;
+	uint32_t mapCalls = 0;
+	uint32_t liveAllocations = 0;
+	VkDeviceSize liveBytes = 0;
+	//size of the last vkAllocateMemory
+	VkDeviceSize lastAllocationSize = 0;
+
+	uint32_t liveImages = 0;
+	uint32_t liveImageViews = 0;
+	uint32_t liveRenderPasses = 0;
+	uint32_t liveFramebuffers = 0;
+	uint32_t renderPassCreates = 0;
+	//every command buffer records into these
+	std::vector<MockBarrier> barriers;
+	uint32_t renderPassBegins = 0;
+};
+
+namespace mock {
+	//device and physical device handles to hand to the tested code
+	VkDevice device();
+	VkPhysicalDevice physicalDevice();
+
+	MockDevice& state();
+	//clears the counters and the memory types, frees whatever the last test leaked
+	void reset();
+	uint32_t addHeap(VkDeviceSize size, VkMemoryHeapFlags flags = 0);
+	uint32_t addMemoryType(uint32_t heapIndex, VkMemoryPropertyFlags flags);
+
+	//null for images that aren't alive. images take 4 bytes per texel, 256 byte aligned, in any memory type
+	const MockImage* image(VkImage image);
+	//attachments of a live render pass, empty otherwise
+	std::vector<VkAttachmentDescription> renderPassAttachments(VkRenderPass renderPass);
+
+	//handles are opaque ids, non dispatchable ones are 64 bit integers on 32 bit targets
+	template<typename Handle>
+	Handle makeHandle(uint64_t id)
+	{
+		Handle handle{};
+		std::memcpy(&handle, &id, sizeof(handle) < sizeof(id) ? sizeof(handle) : sizeof(id));
+		return handle;
+	}
+
+	template<typename Handle>
+	uint64_t handleId(Handle handle)
+	{
+		uint64_t id = 0;
+		std::memcpy(&id, &handle, sizeof(handle) < sizeof(id) ? sizeof(handle) : sizeof(id));
+		return id;
+	}
+}